@@ -0,0 +1,107 @@
+// ambisonic decode cost for a 60 speaker rig at 512 frames, orders 1-5:
+// the blocked simd GEMM in utility/ambisonicDecoder.hpp against a per
+// sample scalar decode and al::AmbiDecode's per speaker, per channel
+// multiply-add loop. run bin/ambisonicBench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../utility/ambisonicDecoder.hpp"
+
+struct BenchSpeaker {
+  float x, y, z;
+  int deviceChannel;
+  const float *vec() const { return &x; }
+};
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+}
+
+int main() {
+  constexpr int kFrames = 512;
+  constexpr int kSpeakers = 60;
+  std::printf("ambisonic decode bench: isa %s, %d frames x %d speakers\n",
+              simd::isaName(), kFrames, kSpeakers);
+  std::printf("%6s %9s %12s %12s %12s %9s %10s\n", "order", "channels",
+              "scalar us", "axpy us", "gemm us", "speedup", "max err");
+
+  // rings below, at and above the horizon plus a cap, like the sphere
+  std::vector<BenchSpeaker> layout;
+  const int rings[4] = {12, 30, 12, 6};
+  const float elevations[4] = {-0.55f, 0.0f, 0.55f, 1.2f};
+  for (int r = 0; r < 4; ++r)
+    for (int i = 0; i < rings[r]; ++i) {
+      const float az = 6.2831853f * i / rings[r];
+      const float el = elevations[r];
+      layout.push_back({-std::sin(az) * std::cos(el), std::sin(el),
+                        -std::cos(az) * std::cos(el),
+                        static_cast<int>(layout.size())});
+    }
+
+  std::mt19937 rng(3);
+  std::normal_distribution<float> noise(0.0f, 0.1f);
+  std::vector<std::vector<float>> out(kSpeakers, std::vector<float>(kFrames));
+  std::vector<std::vector<float>> ref(kSpeakers, std::vector<float>(kFrames));
+  float *outs[kSpeakers];
+  for (int s = 0; s < kSpeakers; ++s) outs[s] = out[s].data();
+
+  for (int order = 1; order <= 5; ++order) {
+    AmbisonicDecoder ambi;
+    ambi.setSpeakers(layout);
+    ambi.setOrder(order);
+    ambi.prepare(1, kFrames);
+    const int nsh = ambi.channels();
+    for (int c = 0; c < nsh; ++c)
+      for (int f = 0; f < kFrames; ++f) ambi.channel(c)[f] = noise(rng);
+    const float *d = ambi.matrix();
+    const int reps = 2000;
+
+    double scalar = timeIt(
+        [&] {
+          for (int f = 0; f < kFrames; ++f)
+            for (int s = 0; s < kSpeakers; ++s) {
+              float a = 0.0f;
+              for (int c = 0; c < nsh; ++c)
+                a += d[s * nsh + c] * ambi.channel(c)[f];
+              ref[s][f] = a;
+            }
+        },
+        reps / 4);
+    double axpy = timeIt(
+        [&] {
+          for (int s = 0; s < kSpeakers; ++s) {
+            float *o = out[s].data();
+            for (int f = 0; f < kFrames; ++f) o[f] = 0.0f;
+            for (int c = 0; c < nsh; ++c) {
+              const float w = d[s * nsh + c];
+              const float *b = ambi.channel(c);
+              for (int f = 0; f < kFrames; ++f) o[f] += w * b[f];
+            }
+          }
+        },
+        reps);
+    double gemm = timeIt(
+        [&] {
+          for (int s = 0; s < kSpeakers; ++s)
+            std::fill(out[s].begin(), out[s].end(), 0.0f);
+          ambi.decode(outs, kFrames);
+        },
+        reps);
+
+    float err = 0.0f;
+    for (int s = 0; s < kSpeakers; ++s)
+      for (int f = 0; f < kFrames; ++f)
+        err = std::fmax(err, std::fabs(out[s][f] - ref[s][f]));
+    std::printf("%6d %9d %12.1f %12.1f %12.1f %8.1fx %10.2g\n", order, nsh,
+                scalar, axpy, gemm, scalar / gemm, err);
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+// frame cost of utility/attractorBatch.hpp on big clouds vs a scalar AoS
+// thomas loop. run bin/attractorBench [pointCount]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../utility/attractorBatch.hpp"
+
+struct Vec3 {
+  float x, y, z;
+};
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  const int reps = 10;
+  std::printf("attractor bench: %zu points, isa %s, %u threads\n", n,
+              simd::isaName(), WorkerPool::shared().size());
+
+  std::vector<Vec3> cloud(n);
+  for (size_t i = 0; i < n; ++i) {
+    float a = i * 0.0137f;
+    cloud[i] = {std::cos(a), std::sin(a * 1.3f), std::sin(a)};
+  }
+
+  const float h = 0.01f, b = 0.208186f;
+  std::vector<Vec3> aos = cloud;
+  double scalar = timeIt(
+      [&] {
+        for (auto &p : aos) {
+          float dx = std::sin(p.y) - b * p.x;
+          float dy = std::sin(p.z) - b * p.y;
+          float dz = std::sin(p.x) - b * p.z;
+          p.x += dx * h;
+          p.y += dy * h;
+          p.z += dz * h;
+        }
+      },
+      reps);
+  std::printf("%-26s %8.3f ms/frame\n", "scalar AoS thomas euler", scalar);
+
+  const char *names[] = {"thomas", "lorenz", "aizawa", "halvorsen"};
+  const AttractorType types[] = {AttractorType::THOMAS, AttractorType::LORENZ,
+                                 AttractorType::AIZAWA,
+                                 AttractorType::HALVORSEN};
+  for (int t = 0; t < 4; ++t) {
+    for (int rk = 0; rk < 2; ++rk) {
+      AttractorCloud attractor(types[t], rk ? AttractorIntegrator::RK4
+                                            : AttractorIntegrator::EULER);
+      attractor.setPoints(cloud);
+      attractor.setMaxStep(h);
+      double ms = timeIt(
+          [&] {
+            attractor.queueStep(h);
+            attractor.queueTranslate(0.0f, 0.0001f, 0.0f);
+            attractor.applyFrame();
+          },
+          reps);
+      char label[64];
+      std::snprintf(label, sizeof(label), "batch %s %s", names[t],
+                    rk ? "rk4" : "euler");
+      std::printf("%-26s %8.3f ms/frame  (%.1f Mpts/s)\n", label, ms,
+                  n / ms / 1000.0);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+// the sphere's callback as an AudioGraph (utility/audioGraph.hpp): 32
+// moving sources spatialized onto 60 speakers, then 2048 tap correction on
+// every output, at 64-512 frame blocks. the same graph on the audio thread
+// alone and forked across pinned AudioWorkers, against the 48 kHz deadline,
+// plus a check that both give bit-identical output.
+// run bin/audioGraphBench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../utility/audioGraph.hpp"
+#include "../utility/batchSpatializer.hpp"
+#include "../utility/partitionedConvolver.hpp"
+
+struct BenchSpeaker {
+  float x, y, z;
+  int deviceChannel;
+  const float *vec() const { return &x; }
+};
+
+// the bits of al::AudioIOData the graph's nodes touch
+struct BenchIO {
+  int frames = 0;
+  std::vector<std::vector<float>> out;
+  int framesPerBuffer() const { return frames; }
+  unsigned channelsOut() const { return static_cast<unsigned>(out.size()); }
+  float *outBuffer(int c) { return out[c].data(); }
+};
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+}
+
+constexpr int kSpeakers = 60;
+constexpr int kSources = 32;
+constexpr int kTaps = 2048;
+
+// one app's worth of audio state and the graph over it
+struct Rig {
+  BatchSpatializer spat;
+  PartitionedConvolver correction;
+  AudioGraph<BenchIO> graph;
+  std::vector<std::vector<float>> sourceAudio;
+  long blockIndex = 0;
+
+  void build(const std::vector<BenchSpeaker> &layout, int frames,
+             const std::vector<float> &ir, AudioWorkers *workers) {
+    spat.setSpeakers(layout);
+    spat.setMode(PanMode::AMBISONIC, 3);
+    spat.prepare(kSources, frames);
+    correction.prepare(kSpeakers, frames);
+    for (int c = 0; c < kSpeakers; ++c)
+      correction.setFilter(c, ir.data(), kTaps);
+    std::mt19937 rng(11);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+    sourceAudio.assign(kSources, std::vector<float>(frames));
+    for (auto &s : sourceAudio)
+      for (auto &v : s) v = noise(rng);
+
+    graph.add("sources", [this](BenchIO &io, int) {
+      for (auto &o : io.out) std::fill(o.begin(), o.end(), 0.0f);
+      // slow orbits, so every block's gains are new
+      for (int i = 0; i < kSources; ++i) {
+        const float a = 0.001f * blockIndex * (1 + i % 5) + i;
+        spat.setSource(i, sourceAudio[i].data(), std::cos(a),
+                       0.3f * std::sin(0.7f * a), std::sin(a));
+      }
+      ++blockIndex;
+      spat.beginBlock(io);
+    });
+    graph.addParallel(
+        "gains", [this](BenchIO &) { return spat.sourceSlots(); },
+        [this](BenchIO &, int i, int) { spat.updateGains(i); });
+    graph.addParallel(
+        "mix", [this](BenchIO &) { return spat.mixSpeakers(); },
+        [this](BenchIO &, int k, int) { spat.mixSpeaker(k); });
+    graph.add("end", [this](BenchIO &, int) { spat.endBlock(); });
+    graph.addParallel("correction", kSpeakers,
+                      [this](BenchIO &io, int c, int frames) {
+                        correction.processChannel(c, io.outBuffer(c), frames);
+                      });
+    graph.setWorkers(workers);
+  }
+};
+
+int main() {
+  const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned extra = std::min(hw > 2 ? hw - 2 : hw - 1, 3u);
+  // the last cores, away from the audio thread and the device's interrupts
+  AudioWorkers workers;
+  workers.start(extra, static_cast<int>(hw - extra));
+  std::printf("audio graph bench: isa %s, %d sources -> %d speakers + %d tap "
+              "correction, %u workers (%u pinned)\n",
+              simd::isaName(), kSources, kSpeakers, kTaps, workers.size(),
+              workers.pinnedCount());
+
+  std::vector<BenchSpeaker> layout;
+  const int rings[4] = {12, 30, 12, 6};
+  const float elevations[4] = {-0.55f, 0.0f, 0.55f, 1.2f};
+  for (int r = 0; r < 4; ++r)
+    for (int i = 0; i < rings[r]; ++i) {
+      const float az = 6.2831853f * i / rings[r];
+      const float el = elevations[r];
+      layout.push_back({-std::sin(az) * std::cos(el), std::sin(el),
+                        -std::cos(az) * std::cos(el),
+                        static_cast<int>(layout.size())});
+    }
+  std::mt19937 rng(5);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  std::vector<float> ir(kTaps);
+  for (int i = 0; i < kTaps; ++i) ir[i] = noise(rng) * std::exp(-i / 400.0f);
+
+  std::printf("%7s %10s %10s %8s %10s %8s %8s %s\n", "frames", "deadline",
+              "serial us", "load", "graph us", "load", "speedup", "output");
+  for (int frames : {64, 128, 256, 512}) {
+    const double deadline = frames / 48000.0 * 1e6;
+    auto serial = std::make_unique<Rig>(), forked = std::make_unique<Rig>();
+    serial->build(layout, frames, ir, nullptr);
+    forked->build(layout, frames, ir, &workers);
+    BenchIO a, b;
+    a.frames = b.frames = frames;
+    a.out.assign(kSpeakers, std::vector<float>(frames));
+    b.out.assign(kSpeakers, std::vector<float>(frames));
+
+    // same blocks through both, compare every one
+    bool same = true;
+    for (int i = 0; i < 64; ++i) {
+      serial->graph.process(a, frames);
+      forked->graph.process(b, frames);
+      for (int c = 0; c < kSpeakers; ++c)
+        same = same && std::memcmp(a.out[c].data(), b.out[c].data(),
+                                   frames * sizeof(float)) == 0;
+    }
+    const int reps = 40000 / frames;
+    const double s = timeIt([&] { serial->graph.process(a, frames); }, reps);
+    const double p = timeIt([&] { forked->graph.process(b, frames); }, reps);
+    std::printf("%7d %10.0f %10.1f %7.1f%% %10.1f %7.1f%% %7.2fx %s\n", frames,
+                deadline, s, 100.0 * s / deadline, p, 100.0 * p / deadline,
+                s / p, same ? "identical" : "DIFFERENT");
+  }
+
+  // where the small-block fallback kept the parallel nodes at 64 frames
+  Rig small;
+  small.build(layout, 64, ir, &workers);
+  BenchIO io;
+  io.frames = 64;
+  io.out.assign(kSpeakers, std::vector<float>(64));
+  for (int i = 0; i < 100; ++i) small.graph.process(io, 64);
+  std::printf("\nat 64 frames\n");
+  for (int n = 0; n < small.graph.size(); ++n) {
+    if (!small.graph.forkedBlocks(n) && !small.graph.serialBlocks(n))
+      continue; // a serial node
+    std::printf("  %-12s %s\n", small.graph.name(n).c_str(),
+                small.graph.forkedBlocks(n) ? "forked" : "on the audio thread");
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+// what AudioProfiler (utility/audioProfiler.hpp) costs the audio thread per
+// mark and per block, how close its histogram percentiles come to the
+// exact ones from a sorted run, and a simulated callback on a real-time
+// timer with injected stalls, to check that late blocks, missed blocks and
+// overruns are counted.
+// run bin/audioProfilerBench [profile.csv]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../utility/audioProfiler.hpp"
+#include "../utility/simdUtility.hpp"
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / reps;
+}
+
+// spins for about ns, the way a stage of dsp would
+static void spin(double ns) {
+  const auto until = std::chrono::steady_clock::now() +
+                     std::chrono::nanoseconds(static_cast<int64_t>(ns));
+  while (std::chrono::steady_clock::now() < until) {
+  }
+}
+
+int main(int argc, char **argv) {
+  std::printf("audio profiler bench: isa %s\n", simd::isaName());
+
+  // overhead: an empty block with four marks
+  {
+    AudioProfiler prof;
+    int stages[4];
+    for (int s = 0; s < 4; ++s) stages[s] = prof.addStage("s");
+    prof.prepare(48000, 256);
+    const double tick = timeIt([] { (void)cycles::now(); }, 1000000);
+    const double block = timeIt(
+        [&] {
+          prof.beginBlock(256);
+          for (int s : stages) prof.mark(s);
+          prof.endBlock();
+        },
+        1000000);
+    std::printf("\n%-28s %8.1f ns\n", "tick read", tick);
+    std::printf("%-28s %8.1f ns  (%.4f%% of a 256 frame block)\n",
+                "block with 4 marks", block, 100.0 * block / (256 / 48e3 * 1e9));
+  }
+
+  // accuracy: known durations through one stage, against the exact order
+  // statistics. a percentile is its bin's upper edge, so up to 12.5% high
+  {
+    AudioProfiler prof;
+    const int stage = prof.addStage("lognormal");
+    prof.prepare(48000, 256);
+    std::mt19937 rng(3);
+    std::lognormal_distribution<double> dist(std::log(40.0), 0.6); // us
+    std::vector<double> us(20000);
+    for (double &v : us) {
+      v = std::min(dist(rng), 400.0);
+      prof.beginBlock(256);
+      spin(v * 1e3);
+      prof.mark(stage);
+      prof.endBlock();
+    }
+    // the profiler sees what the spin really took, preemption included, so
+    // the far tail and the max read high on a busy machine
+    std::sort(us.begin(), us.end());
+    auto exact = [&](double p) {
+      return us[std::min(us.size() - 1, static_cast<std::size_t>(p * us.size()))];
+    };
+    const AudioProfiler::Summary m = prof.summary(stage);
+    std::printf("\n%-8s %10s %10s %8s\n", "pctl", "requested", "profiler",
+                "error");
+    const double ps[4] = {0.5, 0.9, 0.99, 0.999};
+    const double got[4] = {m.p50Us, m.p90Us, m.p99Us, m.p999Us};
+    for (int i = 0; i < 4; ++i)
+      std::printf("p%-7g %10.1f %10.1f %7.1f%%\n", ps[i] * 100, exact(ps[i]),
+                  got[i], 100.0 * (got[i] - exact(ps[i])) / exact(ps[i]));
+    std::printf("%-8s %10.1f %10.1f\n", "max", us.back(), m.maxUs);
+  }
+
+  // a callback on a 128 frame timer at 48 kHz with stalls: every 50th block
+  // runs past its deadline, every 80th wakes up three periods late
+  {
+    AudioProfiler prof;
+    const int dsp = prof.addStage("dsp");
+    const int tail = prof.addStage("tail");
+    prof.prepare(48000, 128);
+    const auto period = std::chrono::nanoseconds(128 * 1000000000LL / 48000);
+    auto next = std::chrono::steady_clock::now();
+    const int blocks = 1000;
+    int injectedOverruns = 0, injectedLate = 0;
+    for (int b = 0; b < blocks; ++b) {
+      if (b % 80 == 79) {
+        next += 3 * period; // the device lost three periods
+        ++injectedLate;
+      }
+      std::this_thread::sleep_until(next);
+      next += period;
+      prof.beginBlock(128);
+      spin(b % 50 == 49 ? 3000e3 : 600e3);
+      if (b % 50 == 49) ++injectedOverruns;
+      prof.mark(dsp);
+      spin(50e3);
+      prof.mark(tail);
+      prof.endBlock();
+    }
+    int lateEvents = 0, overrunEvents = 0;
+    prof.pollEvents([&](const AudioProfiler::Event &e) {
+      (e.kind == AudioProfiler::EventKind::LATE ? lateEvents : overrunEvents)++;
+    });
+    std::printf("\n128 frame callback, %d blocks: injected %d overruns, %d "
+                "late (%d missed)\n",
+                blocks, injectedOverruns, injectedLate, 3 * injectedLate);
+    prof.print(std::cout);
+    std::printf("events: %d late, %d overrun\n", lateEvents, overrunEvents);
+    if (argc > 1)
+      std::printf("%s %s\n", argv[1],
+                  prof.writeCsv(argv[1]) ? "written" : "NOT written");
+  }
+  return 0;
+}
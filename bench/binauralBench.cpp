@@ -0,0 +1,103 @@
+// headphone downmix cost: the 54.1 program through BinauralRenderer
+// (utility/binauralRenderer.hpp), direct per-speaker HRIRs against virtual
+// ambisonics at orders 1-3, at 512 frames against the 48 kHz deadline.
+// also checks that a source on the right is louder in the right ear both
+// ways. run bin/binauralBench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../utility/binauralRenderer.hpp"
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+}
+
+// three rings like the sphere's, 12 / 30 / 12
+struct BenchSpeaker {
+  float x, y, z;
+  int deviceChannel;
+  const float *vec() const { return &x; }
+};
+
+int main() {
+  constexpr int kBlock = 512;
+  constexpr double kRate = 48000.0;
+  const double deadline = kBlock / kRate * 1e6;
+  std::printf("binaural bench: isa %s, block %d, deadline %.0f us\n",
+              simd::isaName(), kBlock, deadline);
+
+  std::vector<BenchSpeaker> speakers;
+  const int rings[3] = {12, 30, 12};
+  for (int r = 0; r < 3; ++r) {
+    const float el = (r - 1) * 0.6f;
+    for (int i = 0; i < rings[r]; ++i) {
+      const float az = 6.2831853f * i / rings[r];
+      speakers.push_back(BenchSpeaker{std::cos(el) * std::sin(az),
+                                      std::sin(el),
+                                      -std::cos(el) * std::cos(az),
+                                      static_cast<int>(speakers.size())});
+    }
+  }
+  const int lfe = static_cast<int>(speakers.size());
+  const int channels = lfe + 1;
+  int right = 0;
+  for (int s = 0; s < lfe; ++s)
+    if (speakers[s].x > speakers[right].x) right = s;
+
+  std::mt19937 rng(3);
+  std::normal_distribution<float> noise(0.0f, 0.1f);
+  std::vector<std::vector<float>> in(channels, std::vector<float>(kBlock));
+  std::vector<const float *> ptrs(channels);
+  for (int c = 0; c < channels; ++c) ptrs[c] = in[c].data();
+  std::vector<float> left(kBlock), rightEar(kBlock);
+
+  std::printf("%-22s %10s %9s %12s\n", "renderer", "us/block", "% rt",
+              "R/L right src");
+  for (int order = 0; order <= 3; ++order) {
+    BinauralRenderer b;
+    b.setSpeakers(speakers);
+    b.addLfe(lfe);
+    b.prepare(kBlock, kRate, std::max(1, order));
+    b.setMode(order == 0 ? BinauralRenderer::Mode::DIRECT
+                         : BinauralRenderer::Mode::VIRTUAL_AMBISONIC);
+
+    // localization: noise on the rightmost speaker only
+    double el = 0.0, er = 0.0;
+    for (int blk = 0; blk < 40; ++blk) {
+      for (auto &ch : in) std::fill(ch.begin(), ch.end(), 0.0f);
+      for (auto &v : in[right]) v = noise(rng);
+      b.process(ptrs.data(), channels, left.data(), rightEar.data(), kBlock);
+      for (int f = 0; blk >= 4 && f < kBlock; ++f) {
+        el += left[f] * left[f];
+        er += rightEar[f] * rightEar[f];
+      }
+    }
+
+    // cost: every feed busy
+    for (auto &ch : in)
+      for (auto &v : ch) v = noise(rng);
+    const double us = timeIt(
+        [&] {
+          b.process(ptrs.data(), channels, left.data(), rightEar.data(),
+                    kBlock);
+        },
+        200);
+    char name[32];
+    if (order == 0)
+      std::snprintf(name, sizeof name, "direct, %d hrirs", lfe);
+    else
+      std::snprintf(name, sizeof name, "virtual ambi order %d", order);
+    std::printf("%-22s %10.1f %8.1f%% %+11.1f dB\n", name, us,
+                100.0 * us / deadline, 10.0 * std::log10(er / el));
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+// per-speaker FIR correction cost: channels x taps through the uniformly
+// partitioned convolver (utility/partitionedConvolver.hpp) at 512 frames,
+// against the 48 kHz callback deadline, on one core and on AudioWorkers.
+// run bin/convolverBench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../utility/partitionedConvolver.hpp"
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+}
+
+int main() {
+  constexpr int kBlock = 512;
+  constexpr double kRate = 48000.0;
+  const double deadline = kBlock / kRate * 1e6;
+  const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned extra = std::min(hw - 1, 7u);
+  std::printf("convolver bench: isa %s, block %d, deadline %.0f us, %u "
+              "workers\n",
+              simd::isaName(), kBlock, deadline, extra + 1);
+
+  std::mt19937 rng(5);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+
+  // correctness first: one channel against direct convolution
+  {
+    const int taps = 3000, len = 4 * kBlock;
+    std::vector<float> ir(taps), x(len), y(len), ref(len, 0.0f);
+    for (int i = 0; i < taps; ++i)
+      ir[i] = noise(rng) * std::exp(-i / 600.0f);
+    for (auto &v : x) v = noise(rng);
+    for (int n = 0; n < len; ++n)
+      for (int k = 0; k <= n && k < taps; ++k) ref[n] += ir[k] * x[n - k];
+    PartitionedConvolver conv;
+    conv.prepare(1, kBlock);
+    conv.setFilter(0, ir.data(), taps);
+    y = x;
+    for (int f = 0; f < len; f += kBlock) {
+      float *p = y.data() + f;
+      conv.process(&p, 1, kBlock);
+    }
+    float err = 0.0f, peak = 0.0f;
+    for (int n = 0; n < len; ++n) {
+      err = std::max(err, std::fabs(y[n] - ref[n]));
+      peak = std::max(peak, std::fabs(ref[n]));
+    }
+    std::printf("vs direct convolution: max error %.2g of %.2g peak, no added "
+                "latency\n\n",
+                err, peak);
+  }
+
+  std::printf("%8s %8s %12s %8s %12s %8s\n", "channels", "taps", "1 core us",
+              "load", "pool us", "load");
+  AudioWorkers workers{extra};
+  const int channelCounts[] = {1, 16, 60};
+  const int tapCounts[] = {4096, 8192, 16384};
+  for (int taps : tapCounts) {
+    std::vector<float> ir(taps);
+    for (int i = 0; i < taps; ++i) ir[i] = noise(rng) * std::exp(-i / 3000.0f);
+    for (int channels : channelCounts) {
+      PartitionedConvolver conv;
+      conv.prepare(channels, kBlock);
+      for (int c = 0; c < channels; ++c) conv.setFilter(c, ir.data(), taps);
+      std::vector<std::vector<float>> io(channels, std::vector<float>(kBlock));
+      std::vector<float *> bufs(channels);
+      for (int c = 0; c < channels; ++c) {
+        for (auto &v : io[c]) v = noise(rng);
+        bufs[c] = io[c].data();
+      }
+      const int reps = channels > 16 ? 200 : 1000;
+      conv.setWorkers(nullptr);
+      const double single =
+          timeIt([&] { conv.process(bufs.data(), channels, kBlock); }, reps);
+      conv.setWorkers(&workers);
+      const double pooled =
+          timeIt([&] { conv.process(bufs.data(), channels, kBlock); }, reps);
+      std::printf("%8d %8d %12.1f %7.1f%% %12.1f %7.1f%%\n", channels, taps,
+                  single, 100.0 * single / deadline, pooled,
+                  100.0 * pooled / deadline);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+// what FrameProfiler (utility/frameProfiler.hpp) costs the graphics thread:
+// a cpu scope, a frame's retire with a CSV row, and the rolling stats the
+// overlay rebuilds every frame, for shaderDistroRef's 11 phases. built
+// without GL, so cpuGpu() times the cpu side only.
+// run bin/frameProfilerBench
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "../utility/frameProfiler.hpp"
+#include "../utility/simdUtility.hpp"
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / reps;
+}
+
+// counts what buildOverlay emits, in place of al::Mesh
+struct CountingMesh {
+  int vertices = 0;
+  void reset() { vertices = 0; }
+  void vertex(float, float) { ++vertices; }
+  void color(float, float, float, float) {}
+};
+
+int main() {
+  std::printf("frame profiler bench: isa %s\n", simd::isaName());
+  FrameProfiler prof;
+  const char *phases[] = {"animate", "state sync", "draw",       "scene 1",
+                          "scene 2", "scene 3",    "scene 4",    "scene 5",
+                          "scene 6", "point pass", "sphere pass"};
+  for (const char *p : phases) prof.addPhase(p);
+  const std::string csv = "/tmp/frameProfilerBench.csv";
+  prof.openCsv(csv);
+
+  const double scope = timeIt([&] { auto t = prof.cpu(0); }, 1000000);
+  // a frame as shaderDistroRef times it in scene 3
+  auto frame = [&] {
+    prof.beginFrame();
+    {
+      auto a = prof.cpu(0);
+      auto s = prof.cpu(1);
+    }
+    auto d = prof.cpuGpu(2);
+    auto sc = prof.cpuGpu(5);
+    auto pass = prof.cpuGpu(10);
+  };
+  const double perFrame = timeIt(frame, 100000);
+  CountingMesh mesh;
+  const double overlay = timeIt([&] { prof.buildOverlay(mesh); }, 2000);
+
+  std::printf("\n%-28s %10.1f ns\n", "cpu scope", scope);
+  std::printf("%-28s %10.1f ns  (csv row included)\n", "frame, 5 scopes",
+              perFrame);
+  std::printf("%-28s %10.1f us  (%d vertices, %.2f%% of 60 fps)\n",
+              "overlay rebuild", overlay * 1e-3, mesh.vertices,
+              100.0 * overlay / (1e9 / 60));
+  prof.closeCsv();
+  std::printf("%s written\n", csv.c_str());
+  return 0;
+}
@@ -0,0 +1,158 @@
+// .alc lossless stems (utility/losslessAudio.hpp): size against 24 bit wav
+// for a few kinds of content, a bit-exact round trip, and decode speed on
+// one core and on the worker pool, as multiples of real time.
+// run bin/losslessBench. bin/alcEncode (tools/alcEncode.cpp) converts
+// files.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../utility/losslessAudio.hpp"
+#include "../utility/simdUtility.hpp"
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / reps;
+}
+
+static long fileBytes(const std::string &path) {
+  std::FILE *f = std::fopen(path.c_str(), "rb");
+  if (!f) return 0;
+  std::fseek(f, 0, SEEK_END);
+  const long n = std::ftell(f);
+  std::fclose(f);
+  return n;
+}
+
+static bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+int main() {
+  constexpr int kRate = 48000;
+  const char *path = "losslessBench.alc";
+  std::printf("lossless bench: isa %s, %u threads\n", simd::isaName(),
+              WorkerPool::shared().size());
+
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  auto quantize = [](float v, int bits) {
+    const float s = static_cast<float>(1 << (bits - 1));
+    // + 0.0f: WavReader never hands out -0
+    return std::round(std::clamp(v, -1.0f, 1.0f - 1.0f / s) * s) / s + 0.0f;
+  };
+  // one channel of a given kind, 24 bit unless said otherwise
+  auto make = [&](int kind, int ch, std::vector<float> &x, int channels,
+                  int frames) {
+    float lp = 0.0f, env = 0.0f;
+    const double f0 = 110.0 * (1 + ch % 7);
+    for (int i = 0; i < frames; ++i) {
+      const double t = double(i) / kRate;
+      float v = 0.0f;
+      switch (kind) {
+      case 0: v = 0.0f; break; // an unused speaker
+      case 1: // tones with a slow swell
+        v = 0.2f * static_cast<float>(std::sin(6.2831853 * f0 * t) +
+                                      0.3 * std::sin(6.2831853 * 2.01 * f0 * t)) *
+            static_cast<float>(0.5 + 0.5 * std::sin(0.7 * t + ch));
+        break;
+      case 2: // lowpassed noise bursts, like a diffuse bed
+        lp += 0.05f * (noise(rng) - lp);
+        env = (i % 24000) < 6000 ? 1.0f : env * 0.9995f;
+        v = 0.5f * lp * env;
+        break;
+      case 3: v = 0.1f * noise(rng); break; // white noise, the worst case
+      case 4: // 16 bit material padded to 24
+        v = quantize(0.2f * static_cast<float>(std::sin(6.2831853 * f0 * t)) +
+                         0.01f * noise(rng), 16);
+        break;
+      }
+      if (kind != 4) v = quantize(v, 24);
+      x[static_cast<std::size_t>(i) * channels + ch] = v;
+    }
+  };
+
+  // size per kind of content
+  std::printf("\n%-22s %10s %10s %8s %s\n", "content (8 ch, 10 s)", "wav24 MB",
+              "alc MB", "ratio", "round trip");
+  const char *kinds[] = {"silence", "tones", "noise bursts", "white noise",
+                         "16 bit in 24", "float32 (verbatim)"};
+  for (int kind = 0; kind < 6; ++kind) {
+    const int ch = 8, frames = 10 * kRate;
+    std::vector<float> x(static_cast<std::size_t>(ch) * frames);
+    for (int c = 0; c < ch; ++c) make(kind == 5 ? 2 : kind, c, x, ch, frames);
+    if (kind == 5)
+      for (auto &v : x) v *= 0.7071f; // off the 24 bit grid
+    LosslessWriter w;
+    w.open(path, ch, kRate);
+    w.write(x.data(), frames);
+    w.close();
+    LosslessReader r;
+    r.open(path);
+    std::vector<float> y(x.size());
+    r.read(y.data(), frames);
+    const double wav = 44.0 + 3.0 * x.size();
+    const double alc = static_cast<double>(fileBytes(path));
+    std::printf("%-22s %10.2f %10.2f %7.1f%% %s\n", kinds[kind], wav / 1e6,
+                alc / 1e6, 100.0 * alc / wav, sameBits(x, y) ? "exact" : "FAILED");
+  }
+
+  // a 54.1-like mix: decode speed and seeking
+  const int ch = 60, frames = 20 * kRate;
+  std::vector<float> x(static_cast<std::size_t>(ch) * frames);
+  const int mix[] = {1, 2, 2, 1, 0, 2, 1, 4, 2, 1};
+  for (int c = 0; c < ch; ++c) make(mix[c % 10], c, x, ch, frames);
+  double encodeUs = timeIt(
+      [&] {
+        LosslessWriter w;
+        w.open(path, ch, kRate);
+        w.write(x.data(), frames);
+        w.close();
+      },
+      1);
+  const double wav = 44.0 + 3.0 * x.size();
+  const double alc = static_cast<double>(fileBytes(path));
+  std::printf("\n60 ch, 20 s mix: wav24 %.1f MB, alc %.1f MB (%.1f%%), "
+              "encode %.1fx real time\n",
+              wav / 1e6, alc / 1e6, 100.0 * alc / wav, 20e6 / encodeUs);
+
+  std::vector<float> y(x.size());
+  std::printf("%-18s %12s %14s\n", "decode", "ms / 20 s", "x real time");
+  for (int pooled = 0; pooled < 2; ++pooled) {
+    LosslessReader r;
+    r.open(path);
+    r.setWorkers(pooled ? &WorkerPool::shared() : nullptr);
+    const double us = timeIt(
+        [&] {
+          r.seek(0);
+          r.read(y.data(), frames);
+        },
+        2);
+    std::printf("%-18s %12.1f %14.0f %s\n", pooled ? "worker pool" : "one core",
+                us / 1e3, 20e6 / us, sameBits(x, y) ? "" : "MISMATCH");
+  }
+
+  // seek into the middle, compare one block
+  LosslessReader r;
+  r.open(path);
+  const uint64_t at = 12345 * 7;
+  r.seek(at);
+  std::vector<float> part(512 * ch);
+  r.read(part.data(), 512);
+  const bool seekOk = std::memcmp(part.data(), x.data() + at * ch,
+                                  part.size() * sizeof(float)) == 0;
+  std::printf("seek to %llu: %s\n", static_cast<unsigned long long>(at),
+              seekOk ? "exact" : "MISMATCH");
+  std::remove(path);
+  return 0;
+}
@@ -0,0 +1,97 @@
+// frame cost of a flocking swarm as the agent count grows: grid neighbor
+// forces (utility/spatialGrid.hpp) + AgentSwarm step, against the all-pairs
+// separation check we avoided. run bin/swarmBench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../utility/agentSwarm.hpp"
+#include "../utility/spatialGrid.hpp"
+
+constexpr std::size_t kMaxAgents = 100000;
+using BenchState = SwarmState<kMaxAgents>;
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+int main() {
+  std::printf("swarm bench: isa %s, %u threads\n", simd::isaName(),
+              WorkerPool::shared().size());
+  std::printf("%8s %12s %12s %12s %14s\n", "agents", "grid ms", "step ms",
+              "frame ms", "all-pairs ms");
+
+  auto state = std::make_unique<BenchState>();
+  const std::size_t counts[] = {30, 300, 3000, 10000, 30000, 100000};
+  for (std::size_t n : counts) {
+    AgentSwarm swarm;
+    swarm.bind(*state, n);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    // keep density roughly constant so neighbor counts stay comparable
+    const float extent = 5.0f * std::cbrt(static_cast<float>(n));
+    for (std::size_t i = 0; i < n; ++i)
+      swarm.setAgent(i, u(rng) * extent, u(rng) * extent, u(rng) * extent,
+                     u(rng), u(rng), u(rng), u(rng));
+
+    FlockForces flock;
+    FlockParams fp;
+    fp.separationRadius = 2.0f;
+    fp.neighborRadius = 4.0f;
+    fp.alignment = 0.2f;
+    fp.cohesion = 0.05f;
+    SwarmParams sp;
+    sp.speed = 3.0f;
+    sp.boundary = extent;
+    sp.homeRate = 0.01f;
+    sp.steerRate = 0.05f;
+
+    const int reps = n > 10000 ? 5 : 50;
+    double grid = timeIt(
+        [&] {
+          flock.compute(swarm.positionX(), swarm.positionY(),
+                        swarm.positionZ(), swarm.velocityX(),
+                        swarm.velocityY(), swarm.velocityZ(), n, fp);
+        },
+        reps);
+    sp.steerX = flock.x();
+    sp.steerY = flock.y();
+    sp.steerZ = flock.z();
+    double step = timeIt([&] { swarm.step(1.0f / 60.0f, sp); }, reps);
+
+    double pairs = -1.0;
+    if (n <= 10000) {
+      std::vector<float> fx(n);
+      const float *x = swarm.positionX(), *y = swarm.positionY(),
+                  *z = swarm.positionZ();
+      pairs = timeIt(
+          [&] {
+            for (std::size_t i = 0; i < n; ++i) {
+              float s = 0.0f;
+              for (std::size_t j = 0; j < n; ++j) {
+                float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 < 4.0f && d2 > 0.0f) s -= dx / d2;
+              }
+              fx[i] = s;
+            }
+          },
+          n > 3000 ? 2 : reps);
+    }
+    if (pairs >= 0.0)
+      std::printf("%8zu %12.4f %12.4f %12.4f %14.4f\n", n, grid, step,
+                  grid + step, pairs);
+    else
+      std::printf("%8zu %12.4f %12.4f %12.4f %14s\n", n, grid, step,
+                  grid + step, "-");
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+// micro benchmark for utility/vfxBatch.hpp against the one-vertex-at-a-time
+// AoS loops the eoys-mesh-fx effects use. build with
+// -DALLO_I_PLAYERS_BENCHMARKS=ON and run bin/vfxBatchBench [vertexCount]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../utility/vfxBatch.hpp"
+
+struct Vec3 {
+  float x, y, z;
+};
+struct BenchMesh {
+  std::vector<Vec3> verts;
+  std::vector<Vec3> &vertices() { return verts; }
+  const std::vector<Vec3> &vertices() const { return verts; }
+};
+
+static const float kTwoPi = 6.28318530718f;
+
+// scalar AoS reference versions, same math as the batch effects
+static void rippleAoS(std::vector<Vec3> &out, const std::vector<Vec3> &base,
+                      float amp, float freq, float speed, char axis, float t) {
+  for (size_t i = 0; i < out.size(); ++i) {
+    const Vec3 &b = base[i];
+    float u = axis == 'x' ? b.y : b.x;
+    float v = axis == 'z' ? b.y : b.z;
+    float d = amp * std::sin(kTwoPi * (freq * (u + v) + speed * t));
+    (axis == 'x' ? out[i].x : axis == 'y' ? out[i].y : out[i].z) += d;
+  }
+}
+
+static void pulseAoS(std::vector<Vec3> &out, const std::vector<Vec3> &base,
+                     float speed, float amount, float t) {
+  for (size_t i = 0; i < out.size(); ++i) {
+    float k = amount * std::sin(kTwoPi * (base[i].y * 0.25f + speed * t));
+    out[i].x += base[i].x * k;
+    out[i].y += base[i].y * k;
+    out[i].z += base[i].z * k;
+  }
+}
+
+static void scatterAoS(std::vector<Vec3> &out, const std::vector<Vec3> &dir,
+                       float k) {
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i].x += dir[i].x * k;
+    out[i].y += dir[i].y * k;
+    out[i].z += dir[i].z * k;
+  }
+}
+
+template <class F> static double timeIt(F &&f, int reps) {
+  f(); // warm
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+static void report(const char *name, double aos, double batch) {
+  std::printf("%-22s aos %8.3f ms   batch %8.3f ms   speedup %5.2fx\n", name,
+              aos, batch, aos / batch);
+}
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  const int reps = 20;
+  std::printf("vfxBatch bench: %zu vertices, isa %s (width %d)\n", n,
+              simd::isaName(), simd::width);
+
+  BenchMesh mesh;
+  mesh.verts.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    float a = i * 0.001f;
+    mesh.verts[i] = {10.0f * std::cos(a), 10.0f * std::sin(a * 0.7f),
+                     10.0f * std::sin(a)};
+  }
+  const std::vector<Vec3> base = mesh.verts;
+  std::vector<Vec3> aos = base;
+  float t = 12.5f;
+
+  // single ripple
+  BatchRippleEffect rx, ry, rz;
+  rx.setParams(4, 0.2, 6.0, 'x');
+  ry.setParams(4, 0.2, 4.0, 'y');
+  rz.setParams(4, 0.2, 5.0, 'z');
+  BatchEffectChain one;
+  one.pushBack(&ry);
+  double a = timeIt([&] { aos = base; rippleAoS(aos, base, 4, 0.2f, 4.0f, 'y', t); }, reps);
+  double b = timeIt([&] { one.process(mesh, t); }, reps);
+  report("ripple", a, b);
+
+  float maxErr = 0.0f;
+  for (size_t i = 0; i < n; ++i)
+    maxErr = std::fmax(maxErr, std::fabs(aos[i].y - mesh.verts[i].y));
+  std::printf("  max abs diff vs std::sin: %g\n", maxErr);
+
+  // three chained ripples, mainEffectChain style
+  mesh.verts = base;
+  BatchEffectChain three;
+  three.pushBack(&rx);
+  three.pushBack(&ry);
+  three.pushBack(&rz);
+  a = timeIt(
+      [&] {
+        aos = base;
+        rippleAoS(aos, base, 4, 0.2f, 6.0f, 'x', t);
+        rippleAoS(aos, base, 4, 0.2f, 4.0f, 'y', t);
+        rippleAoS(aos, base, 4, 0.2f, 5.0f, 'z', t);
+      },
+      reps);
+  b = timeIt([&] { three.process(mesh, t); }, reps);
+  report("3 ripples (fused)", a, b);
+
+  // pulse
+  mesh.verts = base;
+  BatchAutoPulseEffect pulse;
+  pulse.setParams(0.2f, 0.5f, 1);
+  BatchEffectChain pulseChain;
+  pulseChain.pushBack(&pulse);
+  a = timeIt([&] { aos = base; pulseAoS(aos, base, 0.2f, 0.5f, t); }, reps);
+  b = timeIt([&] { pulseChain.process(mesh, t); }, reps);
+  report("auto pulse", a, b);
+
+  // scatter
+  mesh.verts = base;
+  BatchScatterEffect scatter;
+  scatter.setParams(0.5f, 20.0f);
+  scatter.setScatterVector(mesh);
+  BatchEffectChain scatterChain;
+  scatterChain.pushBack(&scatter);
+  std::vector<Vec3> dir(n);
+  for (auto &d : dir) d = {0.57f, 0.57f, 0.57f};
+  a = timeIt([&] { aos = base; scatterAoS(aos, dir, 10.0f); }, reps);
+  b = timeIt([&] { scatterChain.process(mesh, t); }, reps);
+  report("scatter", a, b);
+
+  // kernels alone, without the AoS gather / scatter at the edges
+  BatchEffectChain kernelOnly;
+  kernelOnly.pushBack(&rx);
+  kernelOnly.pushBack(&ry);
+  kernelOnly.pushBack(&rz);
+  kernelOnly.setBaseMesh(base);
+  a = timeIt(
+      [&] {
+        aos = base;
+        rippleAoS(aos, base, 4, 0.2f, 6.0f, 'x', t);
+        rippleAoS(aos, base, 4, 0.2f, 4.0f, 'y', t);
+        rippleAoS(aos, base, 4, 0.2f, 5.0f, 'z', t);
+      },
+      reps);
+  b = timeIt([&] { kernelOnly.processBlock(t); }, reps);
+  report("3 ripples (SoA only)", a, b);
+  return 0;
+}
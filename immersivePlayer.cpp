@@ -9,20 +9,37 @@
 #include "al/io/al_File.hpp"
 #include "al/math/al_Random.hpp"
 #include "al/math/al_Vec.hpp"
+#include "al/protocol/al_OSC.hpp"
 #include "al/scene/al_DynamicScene.hpp"
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_FileSelector.hpp"
 #include "al/ui/al_Parameter.hpp"
 #include "al/ui/al_PresetSequencer.hpp"
 #include "al_ext/assets3d/al_Asset.hpp"
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include "al/sound/al_SoundFile.hpp"
+#include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
+#include "al/sphere/al_SphereUtils.hpp"
 
 #include "miniShader/shaderUtility/shaderToSphere.hpp"
 #include "adm-allo-player/mainplayer.hpp"
+#include "utility/admPlaylist.hpp"
+#include "utility/admStreamer.hpp"
+#include "utility/audioClock.hpp"
+#include "utility/audioFeatures.hpp"
+#include "utility/audioProfiler.hpp"
+#include "utility/audioWorkers.hpp"
+#include "utility/binauralRenderer.hpp"
+#include "utility/levelMeter.hpp"
+#include "utility/outputRouter.hpp"
+#include "utility/partitionedConvolver.hpp"
 
 
 //IMMERSIVE SHADER PLAYER WITH DISTRIBUTED SHADERS FOR THE SPHERE + PLAYBACK FOR 54.1-CHANNEL ADM AUDIO
@@ -30,7 +47,10 @@
 
 
 
-struct Common {};
+struct Common {
+  double clockTime; // primary's audio clock, drives u_time everywhere
+  AudioFeatures::Frame features; // u_bands[], u_onset ... everywhere
+};
 class MyApp : public al::DistributedAppWithState<Common> {
 public:
 //USER CONFIGURATION HERE - EDIT PATHS / SETTINGS//
@@ -49,8 +69,29 @@ public:
 
   //USER CONTROLS HERE //
   float STARTING_TIME = 0.0f;
-  float PLAYBACK_SPEED = 1.0f; // doesnt work for audio yet
-   float audioGain = 0.0f;
+  float PLAYBACK_SPEED = 1.0f; // applies to audio on the streaming path
+  float audioGain = 0.0f; // dB on every output, also "masterGain" over OSC
+  // output meters: 'm' toggles the overlay on the primary, and rms / peak
+  // (dB, one float per output) and clip counts go out as /meters/rms,
+  // /meters/peak and /meters/clips ten times a second
+  int METER_OSC_PORT = 9011;
+  std::string METER_OSC_HOST = "127.0.0.1";
+  // stream the stems from disk instead of loading them all up front.
+  // plays sourceAudio/<sourceAudioFolderSelection>/ (all wavs, in name order).
+  // a folder with .alc stems (bin/alcEncode) always streams, adm_player
+  // only reads wavs
+  bool USE_STREAMING_PLAYBACK = false;
+  // pieces to play back to back, {folder under sourceAudio/, shader index}.
+  // when it isn't empty it replaces the single piece: the next piece is
+  // read ahead while this one plays, the hand-off is gapless, and the
+  // shader switches on the new piece's first audible sample
+  std::vector<AdmPlaylist::Entry> PLAYLIST = {};
+  float PLAYLIST_CROSSFADE = 0.0f; // seconds, 0 is a straight splice
+  bool PLAYLIST_LOOP = true;
+  // off the sphere, fold the 54.1 program down to headphones on a stereo
+  // device. false opens the sphere's 60 outputs everywhere. hrirs.wav next
+  // to the binary: 2 channels per speaker
+  bool BINAURAL_MONITOR = true;
 
 // END USER CONFIGURATION //
 //ADM PLAYER RELATED DONT TOUCH //
@@ -69,10 +110,47 @@ public:
   //
   // Audio related DONT TOUCH //
   //  al::SoundFilePlayer player;
+  SrcCache srcCache{"srcCache"};
+  AdmStreamer streamer;
+  bool streaming = false;
+  AdmPlaylist playlist;
+  bool usingPlaylist = false;
+  AudioClock playClock; // frames the device has played while running
+  // optional outputRouting.txt next to the binary: sub crossover, trims
+  OutputRouter outputRouter;
+  bool routing = false;
+  // optional speakerCorrection.wav: a measured FIR per output
+  PartitionedConvolver speakerCorrection;
+  bool correcting = false;
+  AudioWorkers audioWorkers;
+  // onSound's stages against the block deadline, late callbacks and
+  // overruns. 'p' prints it, onExit writes audioProfile.csv
+  AudioProfiler audioProfiler;
+  int programStage = 0, routeStage = 0, correctionStage = 0,
+      featuresStage = 0, meterStage = 0;
+  // last stage before the device: master gain and metering in one pass
+  LevelMeter meter;
+  std::atomic<float> outputGain{1.0f};
+  std::unique_ptr<al::osc::Send> meterOsc;
+  double meterSendTime = 0.0;
+  bool showMeters = false;
+  al::Mesh meterMesh{al::Mesh::TRIANGLES};
+  // the program's band energies / onsets, analyzed off the audio thread
+  AudioFeatures audioFeatures;
+  // desktop headphone monitoring: the streamer, the playlist or adm_player
+  // renders the sphere's channels into monitorIO, the renderer folds them
+  // to outputs 0 / 1
+  BinauralRenderer binaural;
+  bool monitoring = false;
+  static constexpr int kSphereChannels = 60;
+  al::AudioIOData monitorIO;
+  float *feedPtrs[kSphereChannels];
   // Parameters DONT TOUCH //
   al::Parameter globalTime{"globalTime", "", STARTING_TIME, 0.0, 300.0};
   al::ParameterBool running{"running", "0", false};
+  al::Parameter playbackSpeed{"playbackSpeed", "", 1.0, 0.25, 4.0};
   al::ParameterInt currentFragIndex{"currentFragIndex", "0", 0, 0, 10}; // for shader selection
+  al::Parameter masterGain{"masterGain", "", 0.0, -60.0, 12.0}; // dB
   int currentFlag;
 
   bool printTime = false;
@@ -82,7 +160,56 @@ public:
     adm_player_instance.onInit();
 
 
-    parameterServer() << globalTime << running << currentFragIndex; // << currentFragPathParam; //
+    playbackSpeed = PLAYBACK_SPEED;
+    playClock.setSampleRate(audioIO().framesPerSecond());
+    playClock.setOutputLatency(audioIO().framesPerBuffer() /
+                               audioIO().framesPerSecond());
+    playClock.seek(STARTING_TIME);
+    masterGain = audioGain;
+    parameterServer() << globalTime << running << currentFragIndex << playbackSpeed << masterGain; // << currentFragPathParam; //
+    meter.prepare(audioIO().channelsOut(), audioIO().framesPerSecond());
+    meterOsc = std::make_unique<al::osc::Send>(METER_OSC_PORT,
+                                               METER_OSC_HOST.c_str());
+    monitoring = BINAURAL_MONITOR && !al::sphere::isSphereMachine() &&
+                 audioIO().channelsOut() >= 2;
+    if (monitoring) {
+      const int fpb = audioIO().framesPerBuffer();
+      monitorIO.framesPerSecond(audioIO().framesPerSecond());
+      monitorIO.framesPerBuffer(fpb);
+      monitorIO.channelsOut(kSphereChannels);
+      for (int c = 0; c < kSphereChannels; ++c)
+        feedPtrs[c] = monitorIO.outBuffer(c);
+      binaural.setSpeakers(al::AlloSphereSpeakerLayoutCompensated());
+      binaural.addLfe(47);
+      if (al::File::exists("hrirs.wav")) binaural.loadHrirs("hrirs.wav");
+      binaural.prepare(fpb, audioIO().framesPerSecond());
+      binaural.setAutomatic(true);
+    }
+    if (!monitoring && al::File::exists("outputRouting.txt")) {
+      outputRouter.load("outputRouting.txt"); // bad lines are skipped
+      std::vector<int> mainChannels;
+      for (const auto &s : al::AlloSphereSpeakerLayoutCompensated())
+        mainChannels.push_back(static_cast<int>(s.deviceChannel));
+      outputRouter.setMains(mainChannels);
+      routing = true;
+      outputRouter.prepare(audioIO().channelsOut(), audioIO().framesPerBuffer(),
+                           audioIO().framesPerSecond());
+    }
+    if (!monitoring && al::File::exists("speakerCorrection.wav")) {
+      speakerCorrection.prepare(audioIO().channelsOut(),
+                                audioIO().framesPerBuffer());
+      correcting = speakerCorrection.loadWav("speakerCorrection.wav");
+      const unsigned cores = std::thread::hardware_concurrency();
+      audioWorkers.start(cores > 2 ? std::min(cores - 2, 3u) : 0);
+      speakerCorrection.setWorkers(&audioWorkers);
+    }
+    programStage = audioProfiler.addStage("program");
+    routeStage = audioProfiler.addStage("route");
+    correctionStage = audioProfiler.addStage("correction");
+    featuresStage = audioProfiler.addStage("features");
+    meterStage = audioProfiler.addStage("meter");
+    audioProfiler.prepare(audioIO().framesPerSecond(),
+                          audioIO().framesPerBuffer());
     // Graphics initialization
     searchPaths.addSearchPath(al::File::currentPath() + shaderFolder);
 
@@ -114,6 +241,35 @@ public:
 
   void onCreate() override {
         adm_player_instance.onCreate();
+    if (isPrimary())
+      audioFeatures.start(audioIO().framesPerSecond(),
+                          audioIO().framesPerBuffer());
+    if (!PLAYLIST.empty() && isPrimary()) {
+      for (const auto &e : PLAYLIST)
+        playlist.add("../adm-allo-player/sourceAudio/" + e.folder, e.fragIndex);
+      playlist.setLoop(PLAYLIST_LOOP);
+      playlist.useSrcCache(&srcCache,
+                           static_cast<int>(audioIO().framesPerSecond()));
+      playlist.prepare(monitoring ? kSphereChannels : audioIO().channelsOut(),
+                       audioIO().framesPerBuffer(), PLAYLIST_CROSSFADE,
+                       audioIO().framesPerSecond());
+      usingPlaylist = playlist.start();
+    } else if ((USE_STREAMING_PLAYBACK ||
+                (!sourceAudioFolderSelection.empty() &&
+                 (monitoring ||
+                  AdmStreamer::hasCompressed("../adm-allo-player/sourceAudio/" +
+                                             sourceAudioFolderSelection)))) &&
+               isPrimary()) {
+      streamer.enableVarispeed(true);
+      streamer.useSrcCache(&srcCache,
+                           static_cast<int>(audioIO().framesPerSecond()));
+      streaming = streamer.openFolder("../adm-allo-player/sourceAudio/" +
+                                      sourceAudioFolderSelection);
+      if (streaming) {
+        streamer.seekSeconds(STARTING_TIME);
+        streamer.start();
+      }
+    }
 
     // Graphics setup
     shadedSphere.setSphere(15.0, 20);
@@ -127,13 +283,57 @@ public:
     shadedSphere.update();
   }
   void onAnimate(double dt) override {
+    outputGain.store(std::pow(10.0f, masterGain.get() / 20.0f),
+                     std::memory_order_relaxed);
+    if (isPrimary()) {
+      meter.poll();
+      meterSendTime += dt;
+      if (meterSendTime >= 0.1) {
+        meterSendTime = 0.0;
+        if (meterOsc) meter.sendOsc(*meterOsc);
+      }
+      if (showMeters) buildMeterMesh();
+      audioProfiler.pollEvents([](const AudioProfiler::Event &e) {
+        if (e.kind == AudioProfiler::EventKind::LATE)
+          std::cout << "audio: block " << e.block << " late by "
+                    << e.intervalUs << " us, " << e.missed << " missed"
+                    << std::endl;
+        else
+          std::cout << "audio: block " << e.block << " overran, "
+                    << e.durationUs << " us" << std::endl;
+      });
+    }
 
-    if (running == true) {
-      globalTime = globalTime + (dt * PLAYBACK_SPEED);
+    if (streaming) streamer.setSpeed(playbackSpeed);
+    playClock.setRunning(running);
+    if (!isPrimary()) {
+      globalTime.setNoCalls(state().clockTime);
+    } else if (running == true) {
+      if (usingPlaylist) {
+        // what leaves the speakers now: rendered minus one device buffer
+        const int64_t audible =
+            playlist.programFrames() - audioIO().framesPerBuffer();
+        int frag;
+        if (playlist.pollSwitch(audible, frag) &&
+            frag < static_cast<int>(fragPathOptions.size()))
+          currentFragIndex = frag;
+        globalTime =
+            playlist.positionSeconds(audible, audioIO().framesPerSecond());
+      } else if (streaming) {
+        // follow the audio so picture and sound stay locked at any speed
+        globalTime = streamer.positionSeconds();
+      } else {
+        // adm_player plays at 1x, count its frames instead of graphics dt
+        globalTime = playClock.seconds();
+      }
       if (printTime) {
         std::cout << globalTime << std::endl;
       }
     }
+    if (isPrimary()) {
+      state().clockTime = globalTime;
+      state().features = audioFeatures.latest();
+    }
 
    
       // need to find a way to update these not every frame, but only when the shader changes. maybe a listener on the parameter?
@@ -156,14 +356,38 @@ public:
     g.clear(0.0);
     g.shader(shadedSphere.shader());
     shadedSphere.setUniformFloat("u_time", globalTime);
+    AudioFeatures::uniforms(state().features, [&](const char *name, float v) {
+      shadedSphere.setUniformFloat(name, v);
+    });
 
     shadedSphere.update();
     shadedSphere.draw(g);
+
+    if (isPrimary() && showMeters) {
+      g.pushCamera(al::Viewpoint::IDENTITY);
+      g.depthTesting(false);
+      g.blending(true);
+      g.blendTrans();
+      g.meshColor();
+      g.draw(meterMesh);
+      g.blending(false);
+      g.popCamera();
+    }
   }
 
   bool onKeyDown(const al::Keyboard &k) override {
     // Primary controls (graphics + shader selection)
     if (isPrimary()) {
+      if (k.key() == 'm') {
+        showMeters = !showMeters;
+        return true;
+      }
+      if (k.key() == 'p') {
+        audioProfiler.print(std::cout);
+        audioProfiler.writeCsv("audioProfile.csv");
+        audioProfiler.reset();
+        return true;
+      }
       if (k.key() == ' ') {
         // Toggle both graphics and audio playback
         running = !running;
@@ -176,6 +400,8 @@ public:
       if (k.key() >= '1' && k.key() <= '9') {
         running = false; // pause playback when switching shaders
         globalTime = 0.0f; // reset time on shader switch
+        playClock.seek(0.0);
+        if (streaming) streamer.seek(0);
         int idx = static_cast<int>(k.key() - '1'); // '1'->0, '2'->1, ...
         if (idx < static_cast<int>(fragPathOptions.size())) {
           if (currentFragIndex == idx) {
@@ -211,12 +437,101 @@ public:
   }  
 
   void onSound(al::AudioIOData& io) override {
-    adm_player_instance.onSound(io);
+    audioProfiler.beginBlock(io.framesPerBuffer());
+    if (monitoring) {
+      const int frames = io.framesPerBuffer();
+      if (usingPlaylist && running) {
+        playlist.read(feedPtrs, kSphereChannels, frames);
+        binaural.process(feedPtrs, kSphereChannels, io.outBuffer(0),
+                         io.outBuffer(1), frames);
+      } else if (streaming && running) {
+        streamer.read(feedPtrs, kSphereChannels, frames);
+        binaural.process(feedPtrs, kSphereChannels, io.outBuffer(0),
+                         io.outBuffer(1), frames);
+      } else if (!usingPlaylist && !streaming) {
+        // nothing to stream: adm_player plays as it would on the sphere,
+        // just into monitorIO's 60 channels
+        monitorIO.zeroOut();
+        monitorIO.frame(0);
+        adm_player_instance.onSound(monitorIO);
+        playClock.advance(frames);
+        binaural.process(feedPtrs, kSphereChannels, io.outBuffer(0),
+                         io.outBuffer(1), frames);
+      }
+    } else if (usingPlaylist) {
+      if (running) playlist.onSound(io);
+    } else if (streaming) {
+      // outputs are already zeroed, so pausing is just not reading
+      if (running) streamer.onSound(io);
+    } else {
+      adm_player_instance.onSound(io);
+      playClock.advance(io.framesPerBuffer());
+    }
+    audioProfiler.mark(programStage);
+    if (routing) {
+      outputRouter.process(io);
+      audioProfiler.mark(routeStage);
+    }
+    if (correcting) {
+      speakerCorrection.process(io);
+      audioProfiler.mark(correctionStage);
+    }
+    if (isPrimary()) {
+      audioFeatures.pushOutputs(io);
+      audioProfiler.mark(featuresStage);
+    }
+    meter.process(io, outputGain.load(std::memory_order_relaxed));
+    audioProfiler.mark(meterStage);
+    audioProfiler.endBlock();
+  }
 
+  void onExit() override {
+    if (streaming) {
+      streamer.stop();
+      AdmStreamer::Stats st = streamer.stats();
+      std::cout << "stream: " << st.underruns << " underruns ("
+                << st.underrunFrames << " frames) in " << st.callbacks
+                << " callbacks, lowest buffer " << st.minFillFrames
+                << " frames" << std::endl;
+    }
+    if (audioProfiler.blockCount()) {
+      audioProfiler.print(std::cout);
+      audioProfiler.writeCsv("audioProfile.csv");
+    }
   }
 
 private:
- 
+  // one bar per output along the bottom of the window, -60..0 dB: rms
+  // green (red once it has clipped), a white tick at the held peak
+  void buildMeterMesh() {
+    meterMesh.reset();
+    const int n = meter.channelCount();
+    if (n == 0) return;
+    const float w = 1.9f / n, bottom = -0.95f, height = 0.4f;
+    auto level = [&](float linear) {
+      const float db = std::max(-60.0f, LevelMeter::toDb(linear));
+      return bottom + height * (db + 60.0f) / 60.0f;
+    };
+    auto quad = [&](float x0, float y0, float x1, float y1, al::Color c) {
+      meterMesh.vertex(x0, y0);
+      meterMesh.vertex(x1, y0);
+      meterMesh.vertex(x1, y1);
+      meterMesh.vertex(x0, y0);
+      meterMesh.vertex(x1, y1);
+      meterMesh.vertex(x0, y1);
+      for (int i = 0; i < 6; ++i) meterMesh.color(c);
+    };
+    for (int c = 0; c < n; ++c) {
+      const float x0 = -0.95f + c * w, x1 = x0 + 0.8f * w;
+      quad(x0, bottom, x1, bottom + height, al::Color(0.1f, 0.1f, 0.1f, 0.6f));
+      quad(x0, bottom, x1, level(meter.rms(c)),
+           meter.clips(c) ? al::Color(1.0f, 0.2f, 0.1f)
+                          : al::Color(0.2f, 0.9f, 0.3f));
+      const float p = level(meter.peak(c));
+      quad(x0, p - 0.004f, x1, p + 0.004f, al::Color(1.0f));
+    }
+  }
+
 
 
 };
@@ -224,9 +539,12 @@ private:
 int main() {
   MyApp app;
  
-  // Configure audio for 54 output channels, 0 input channels
+  // Configure audio for 54 output channels, 0 input channels (stereo off the
+  // sphere when BINAURAL_MONITOR is on)
   // Adjust sample rate and buffer size as needed. (samplerate, buffer size, output channels, input channels)
-  app.configureAudio(48000, 512, 60, 0); // try 44.1k if there are sampling issuess
+  const bool stereo = app.BINAURAL_MONITOR && !al::sphere::isSphereMachine();
+  app.configureAudio(48000, 512, stereo ? 2 : 60,
+                     0); // try 44.1k if there are sampling issuess
   
   
   app.start();
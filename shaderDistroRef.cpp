@@ -10,8 +10,10 @@
 #include "al/graphics/al_VAO.hpp"
 #include "al/graphics/al_VAOMesh.hpp"
 #include "al/io/al_File.hpp"
+#include "al/io/al_Socket.hpp"
 #include "al/math/al_Random.hpp"
 #include "al/math/al_Vec.hpp"
+#include "al/protocol/al_OSC.hpp"
 #include "al/scene/al_SynthSequencer.hpp"
 #include "al/sound/al_SoundFile.hpp"
 #include "al/sound/al_Spatializer.hpp"
@@ -22,8 +24,12 @@
 #include "al/ui/al_PresetSequencer.hpp"
 #include "al_ext/assets3d/al_Asset.hpp"
 #include "al_ext/statedistribution/al_CuttleboneDomain.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 
 // spatial includes
 #include "al/sound/al_Ambisonics.hpp"
@@ -51,6 +57,26 @@
 #include "../utility/attractors.hpp"
 #include "../utility/creatures.hpp"
 #include "../utility/imageColorToMesh.hpp"
+#include "utility/agentSwarm.hpp"
+#include "utility/attractorBatch.hpp"
+#include "utility/audioClock.hpp"
+#include "utility/audioFeatures.hpp"
+#include "utility/audioGraph.hpp"
+#include "utility/audioProfiler.hpp"
+#include "utility/audioWorkers.hpp"
+#include "utility/batchSpatializer.hpp"
+#include "utility/binauralRenderer.hpp"
+#include "utility/controlSnapshot.hpp"
+#include "utility/frameProfiler.hpp"
+#include "utility/levelMeter.hpp"
+#include "utility/meshNormals.hpp"
+#include "utility/outputRouter.hpp"
+#include "utility/partitionedConvolver.hpp"
+#include "utility/showSequencer.hpp"
+#include "utility/spatialGrid.hpp"
+#include "utility/srcCache.hpp"
+#include "utility/trajectoryTable.hpp"
+#include "utility/vfxBatch.hpp"
 
 #define nAgentsScene2 30
 
@@ -66,32 +92,23 @@ al::Vec3f randomVec3f(float scale) {
 
 struct Common {
 
-  // double sceneTime;
-  //  int sceneIndex;
+  // show timeline from the primary's audio clock, replicas render from these
+  double clockTime;
+  double sceneTime;
+  int sceneIndex;
   //  bool running;
+  AudioFeatures::Frame features; // the show mix, analyzed on the primary
 
   // scene 1
   al::Vec3f scene1Mesh[10000];
   al::Vec3f scene1BodyMesh[10000];
 
-  // scene 2
-  float blobPosX[nAgentsScene2];
-  float blobPosY[nAgentsScene2];
-  float blobPosZ[nAgentsScene2];
-  float blobQuatW[nAgentsScene2];
-  float blobQuatX[nAgentsScene2];
-  float blobQuatY[nAgentsScene2];
-  float blobQuatZ[nAgentsScene2];
+  // scene 2, stepped in place by blobSwarm
+  SwarmState<nAgentsScene2> blobs;
 
   // scene 6
   float flicker;
-  float jellyX[MAX_JELLIES];
-  float jellyY[MAX_JELLIES];
-  float jellyZ[MAX_JELLIES];
-  float jellyQuatW[MAX_JELLIES];
-  float jellyQuatX[MAX_JELLIES];
-  float jellyQuatY[MAX_JELLIES];
-  float jellyQuatZ[MAX_JELLIES];
+  SwarmState<MAX_JELLIES> jellies;
 };
 
 class MyApp : public al::DistributedAppWithState<Common> {
@@ -103,8 +120,43 @@ class MyApp : public al::DistributedAppWithState<Common> {
 
   ////spatial
   //
-  al::Spatializer *spatializer{nullptr};
   al::Speakers speakerLayout;
+  // every source in one pass, gains ramped per sample across the block
+  BatchSpatializer spatializer;
+  std::vector<float> showMix; // the show's voices, before spatializing
+  // scene 1's attractor path and its speaker gains, baked in onCreate
+  TrajectoryTable scene1Path;
+  std::vector<float> pathGains;
+  int pathScene = -1;     // audio thread: scene the path clock belongs to
+  uint32_t pathSeeks = 0; // audio thread: seekShow count it started at
+  int64_t pathFrame = 0;  // audio thread: frames since that scene started
+  // after spatializing: routing, sub crossover, trims (outputRouting.txt)
+  OutputRouter outputRouter;
+  // measured FIR per speaker (speakerCorrection.wav), if there is one
+  PartitionedConvolver speakerCorrection;
+  bool correcting = false;
+  // onSound as a graph: the show serially, then the speaker mixes and the
+  // correction filters split across audioWorkers (on the sphere only)
+  AudioGraph<al::AudioIOData> audioGraph;
+  AudioWorkers audioWorkers;
+  // each graph node's time against the block deadline, late callbacks and
+  // overruns. 'p' prints it, onExit writes audioProfile.csv
+  AudioProfiler audioProfiler;
+  // off the sphere: spatialize to the sphere's layout anyway and listen to
+  // it on headphones. feeds are indexed by device channel
+  BinauralRenderer binaural;
+  bool monitoring = false;
+  std::vector<float> feedScratch;
+  std::vector<float *> feedPtrs;    // device channel -> scratch
+  std::vector<float *> speakerFeeds; // spatializer speaker -> scratch
+  // what actually leaves for the device, as /meters/* OSC from the primary
+  int METER_OSC_PORT = 9011;
+  std::string METER_OSC_HOST = "127.0.0.1";
+  LevelMeter meter;
+  std::unique_ptr<al::osc::Send> meterOsc; // primary only
+  double meterSendTime = 0.0;
+  // band energies / onsets of the show mix for the shaders (u_bands[] ...)
+  AudioFeatures audioFeatures;
 
   // al::ParameterBool pRunning{"running"};
   // al::Parameter pTime{"time", "", 0.0, 0.0, 10000}; 0ld stuff
@@ -114,6 +166,15 @@ class MyApp : public al::DistributedAppWithState<Common> {
   al::Parameter sceneTime{"sceneTime", "0", 0.0, 0.0, 10000};
   // al::Parameter sceneIndexParam{"sceneIndexParam", "0", 1, 0, 6};
   al::ParameterInt sceneIndex{"sceneIndex", "0", 0, 0, 10};
+  // every node times its own frame: animate, state sync, each scene's draw
+  // and shader passes, cpu and gpu. 't' on the primary shows the overlay
+  // everywhere, FRAME_TIMING_CSV makes each node write its own CSV
+  al::ParameterBool showTiming{"showTiming", "0", false};
+  FrameProfiler frameProfiler;
+  int animatePhase = 0, syncPhase = 0, drawPhase = 0, pointPassPhase = 0,
+      spherePassPhase = 0;
+  int scenePhase[6] = {};
+  al::Mesh timingMesh{al::Mesh::TRIANGLES};
 
   //
 public:
@@ -123,6 +184,23 @@ public:
   // int sceneIndex = 0;
   // int previousIndex = 0;
   double globalTime = 0;
+  // counted in rendered audio frames, the source of truth for globalTime
+  AudioClock showClock;
+  double sceneStart = 0.0; // globalTime the current scene started at
+  double cueTime = -1.0;   // globalTime cues were last checked at, below 0
+                           // so scene 1 fires when the show starts
+  static constexpr double sceneStarts[6] = {0.0,   119.0, 335.0,
+                                            444.0, 936.0, 1105.0};
+
+  // everything onSound needs from the control side, published by onAnimate
+  // and picked up once per block. the audio thread never reads a Parameter
+  struct AudioControls {
+    int sceneIndex = 0;
+    uint32_t seeks = 0; // seekShow calls, so a re-seek restarts the path
+  };
+  uint32_t seeks = 0;
+  ControlSnapshot<AudioControls> audioControls;
+  SceneCrossfade sceneFade; // 20 ms between scenes' voices
   // double sceneTime;
   // bool running = false;
   float localTime;
@@ -136,10 +214,12 @@ public:
   std::string Song4Path;
   std::string Song5Path;
   std::string Song6Path;
+  SrcCache srcCache{"srcCache"};
   std::string pointFragPath;
   std::string pointVertPath;
   std::string pointGeomPath;
   al::ShaderProgram pointShader;
+  al::ShaderProgram blobShader; // line blobs, lit from derivatives
   std::string vertPathScene3;
   std::string fragPathScene3;
   std::string vertPathScene4;
@@ -194,12 +274,14 @@ public:
   al::VAOMesh attractorMesh;
   al::VAOMesh bodyMesh;
   objParser newObjParser;
-  Attractor mainAttractor;
-  VertexEffectChain mainEffectChain;
-  RippleEffect mainRippleY;
-  RippleEffect mainRippleX;
-  RippleEffect mainRippleZ;
-
+  AttractorCloud mainAttractor{AttractorType::THOMAS};
+  BatchEffectChain mainEffectChain;
+  BatchRippleEffect mainRippleY;
+  BatchRippleEffect mainRippleX;
+  BatchRippleEffect mainRippleZ;
+
+  // scatter is one fma per coordinate, memory bound: the batch version only
+  // adds the SoA copies (vfxBatchBench), so it stays on the AoS effect
   VertexEffectChain bodyEffectChain;
   ;
   ScatterEffect bodyScatter;
@@ -210,9 +292,8 @@ public:
   //  MESHES//
   al::VAOMesh blobMesh;
   al::VAOMesh starCreatureMesh;
-  std::vector<al::Nav> blobs;
-  std::vector<al::Vec3f> velocity;
-  std::vector<al::Vec3f> force;
+  AgentSwarm blobSwarm;
+  FlockForces blobFlock; // grid neighbors for separation / alignment
   Creature creature;
   // PARAMS
 
@@ -235,13 +316,17 @@ public:
   ;
 
   // MESH EFFECTS//
-  VertexEffectChain blobsEffectChain;
-  RippleEffect blobsRippleX;
-  RippleEffect blobsRippleY;
-  RippleEffect blobsRippleZ;
+  BatchEffectChain blobsEffectChain;
+  BatchRippleEffect blobsRippleX;
+  BatchRippleEffect blobsRippleY;
+  BatchRippleEffect blobsRippleZ;
 
-  VertexEffectChain starEffectChain;
-  RippleEffect starRipple;
+  BatchEffectChain starEffectChain;
+  BatchRippleEffect starRipple;
+
+  // topology is fixed, only the ripples move vertices
+  MeshNormals blobNormals;
+  MeshNormals starNormals;
 
   // WIND PIECE SEQUENCING EVENTS (SCENE 2)
   float windSpeedFastStart = 0.0f;
@@ -282,7 +367,8 @@ public:
   // SCENE 6 DECLARE START
 
   al::VAOMesh jellyCreatureMesh;
-  std::vector<al::Nav> jellies;
+  AgentSwarm jellySwarm;
+  FlockForces jellyFlock;
 
   // === Scene 6 PARAMETERS ===
   al::Parameter scene6Boundary{"scene6Boundary", "", 50.0f, 0.0f, 100.0f};
@@ -296,33 +382,97 @@ public:
   al::Parameter scene6pulseAmount{"scene6pulseAmount", "", 0.2f, 0.0f, 5.0f};
 
   // Scene 6 Effects
-  AutoPulseEffect jellyPulse;
-  RippleEffect jellyRippleY;
-  RippleEffect jellyRippleX;
-  VertexEffectChain jellyEffectChain;
+  BatchAutoPulseEffect jellyPulse;
+  BatchRippleEffect jellyRippleY;
+  BatchRippleEffect jellyRippleX;
+  BatchEffectChain jellyEffectChain;
 
   /// SCENE 6 DECLARE END
 
   void onInit() override {
     gam::sampleRate(audioIO().framesPerSecond());
+    showClock.setSampleRate(audioIO().framesPerSecond());
+    showClock.setOutputLatency(audioIO().framesPerBuffer() /
+                               audioIO().framesPerSecond());
+    sceneFade.prepare(audioIO().channelsOut(), audioIO().framesPerBuffer(),
+                      audioIO().framesPerSecond());
+    show.setSampleRate(audioIO().framesPerSecond());
 
-    parameterServer() << running << sceneTime << sceneIndex;
+    parameterServer() << running << sceneTime << sceneIndex << showTiming;
 
     // SPATIAL STUFF
     audioIO().channelsBus(1);
-    if (al::sphere::isSphereMachine())
-      speakerLayout = al::AlloSphereSpeakerLayoutCompensated();
-    else
-      speakerLayout = al::StereoSpeakerLayout();
-
-    spatializer = new al::AmbisonicsSpatializer(speakerLayout); //, 3, 1, 1);
-    spatializer->compile();
+    speakerLayout = al::AlloSphereSpeakerLayoutCompensated();
+    monitoring = !al::sphere::isSphereMachine();
+
+    spatializer.setSpeakers(speakerLayout);
+    spatializer.setMode(PanMode::AMBISONIC, 3);
+    spatializer.prepare(static_cast<int>(show.capacity()),
+                        audioIO().framesPerBuffer());
+    showMix.assign(audioIO().framesPerBuffer(), 0.0f);
+    pathGains.assign(spatializer.speakers(), 0.0f);
+    if (monitoring) {
+      const int fpb = audioIO().framesPerBuffer();
+      int feeds = 0;
+      for (const auto &s : speakerLayout)
+        feeds = std::max(feeds, static_cast<int>(s.deviceChannel) + 1);
+      feedScratch.assign(static_cast<std::size_t>(feeds) * fpb, 0.0f);
+      feedPtrs.resize(feeds);
+      for (int c = 0; c < feeds; ++c) feedPtrs[c] = &feedScratch[c * fpb];
+      speakerFeeds.clear();
+      for (const auto &s : speakerLayout)
+        speakerFeeds.push_back(feedPtrs[s.deviceChannel]);
+      binaural.setSpeakers(speakerLayout);
+      binaural.prepare(fpb, audioIO().framesPerSecond());
+      binaural.setAutomatic(true);
+    }
 
     // FILE PATH STUFF
     searchPaths.addAppPaths();
     searchPaths.addRelativePath("../..");
     // searchPaths.addSearchPath(al::File::currentPath() + "/../../../..");
 
+    // OUTPUT ROUTING: the sphere's sub is on 47 unless a config says otherwise
+    al::FilePath routingFp = searchPaths.find("outputRouting.txt");
+    if (routingFp.valid()) {
+      outputRouter.load(routingFp.filepath());
+      std::cout << "Found file at: " << routingFp.filepath() << std::endl;
+    } else if (al::sphere::isSphereMachine()) {
+      outputRouter.addSub(47);
+    }
+    std::vector<int> mainChannels;
+    for (const auto &s : speakerLayout)
+      mainChannels.push_back(static_cast<int>(s.deviceChannel));
+    outputRouter.setMains(mainChannels);
+    outputRouter.prepare(audioIO().channelsOut(), audioIO().framesPerBuffer(),
+                         audioIO().framesPerSecond());
+    meter.prepare(audioIO().channelsOut(), audioIO().framesPerSecond());
+    // replicas get the features through state(), and only the primary
+    // reports meters
+    if (isPrimary()) {
+      audioFeatures.start(audioIO().framesPerSecond(),
+                          audioIO().framesPerBuffer());
+      meterOsc = std::make_unique<al::osc::Send>(METER_OSC_PORT,
+                                                 METER_OSC_HOST.c_str());
+    }
+    al::FilePath correctionFp = searchPaths.find("speakerCorrection.wav");
+    if (correctionFp.valid()) {
+      speakerCorrection.prepare(audioIO().channelsOut(),
+                                audioIO().framesPerBuffer());
+      correcting = speakerCorrection.loadWav(correctionFp.filepath());
+    }
+    if (!monitoring) {
+      // the last cores, away from the audio thread and core 0's interrupts
+      const unsigned cores = std::thread::hardware_concurrency();
+      const unsigned extra = cores > 2 ? std::min(cores - 2, 3u) : 0;
+      audioWorkers.start(extra, static_cast<int>(cores - extra));
+      audioGraph.setWorkers(&audioWorkers);
+    }
+    buildAudioGraph();
+    audioGraph.setProfiler(&audioProfiler);
+    audioProfiler.prepare(audioIO().framesPerSecond(),
+                          audioIO().framesPerBuffer());
+
     // POINT SHADER PATHS
 
     // probaboy can be in if primary
@@ -402,6 +552,11 @@ public:
       } else {
         std::cout << "couldnt find song6 in path" << std::endl;
       }
+      // start converting the scheduled songs that arent at the device rate,
+      // onCreate picks up the results. only song 1 is in the show, request
+      // the others alongside their show.add lines
+      const int deviceRate = static_cast<int>(audioIO().framesPerSecond());
+      srcCache.request(Song1Path, deviceRate);
     }
 
     // scene 3 paths
@@ -459,6 +614,7 @@ public:
 
     pointShader.compile(slurp(pointVertPath), slurp(pointFragPath),
                         slurp(pointGeomPath));
+    blobShader.compile(normalsDerivativeVert(), normalsDerivativeFrag());
 
     cuttleboneDomain = al::CuttleboneDomain<Common>::enableCuttlebone(this);
     if (!cuttleboneDomain) {
@@ -494,6 +650,23 @@ public:
     // scene 6
     createScene6();
 
+    animatePhase = frameProfiler.addPhase("animate");
+    syncPhase = frameProfiler.addPhase("state sync");
+    drawPhase = frameProfiler.addPhase("draw");
+    for (int i = 0; i < 6; ++i)
+      scenePhase[i] = frameProfiler.addPhase("scene " + std::to_string(i + 1));
+    pointPassPhase = frameProfiler.addPhase("point pass");
+    spherePassPhase = frameProfiler.addPhase("sphere pass");
+    // per-frame CSV only on request: FRAME_TIMING_CSV=<dir> (local disk,
+    // not the shared mount) writes <dir>/frameTiming_<host>.csv, one file
+    // per node. a row per frame adds up over a whole show
+    if (const char *csvDir = std::getenv("FRAME_TIMING_CSV")) {
+      std::string dir = csvDir;
+      if (!dir.empty() && dir.back() != '/') dir += '/';
+      frameProfiler.openCsv(dir + "frameTiming_" + al::Socket::hostName() +
+                            ".csv");
+    }
+
     double g = 0.7;
     float a = 1.4;
     float b = 1.6;
@@ -501,29 +674,38 @@ public:
     float d = 0.7;
 
     if (isPrimary()) {
-      sequencer1().add<SoundObject>(0, 44000).set(
-
-          1, 1, 1, 0.1, true, Song1Path.c_str(),
-          [&](double t, const al::Vec3f &p) -> al::Vec3f {
-            return al::Vec3f(
-                // body of lambda logic. will replace this will header calls
-                (sin(a * p.y) + c * cos(a * p.x)),
-                (sin(b * p.x) + d * cos(b * p.y)), p.z);
-          });
-
-      // sequencer2().add<SoundObject>(0, 44000).set(
+      const int deviceRate = static_cast<int>(audioIO().framesPerSecond());
+      Song1Path = srcCache.resolve(Song1Path, deviceRate);
+      // copies of a-d: this map outlives onCreate
+      auto scene1Map = [a, b, c, d](double t,
+                                    const al::Vec3f &p) -> al::Vec3f {
+        return al::Vec3f(
+            // body of lambda logic. will replace this will header calls
+            (sin(a * p.y) + c * cos(a * p.x)),
+            (sin(b * p.x) + d * cos(b * p.y)), p.z);
+      };
+      show.add(1, 0, 44000).set(1, 1, 1, 0.1, true, Song1Path.c_str(),
+                                scene1Map);
+      // the same path stepped every 0.1 s, a minute of it played forward
+      // and back (the map never returns to its start, so a plain loop would
+      // jump), with its gains precomputed so the audio thread only
+      // interpolates
+      scene1Path.build(spatializer, 60.0, 1.0 / 0.1, al::Vec3f(1, 1, 1),
+                       scene1Map, true);
+
+      // show.add(2, 0, 44000).set(
 
       //     Song2Path.c_str());
-      // sequencer3().add<SoundObject>(0, 44000).set(
+      // show.add(3, 0, 44000).set(
 
       //     Song3Path.c_str());
-      // sequencer4().add<SoundObject>(0, 44000).set(
+      // show.add(4, 0, 44000).set(
 
       //     Song4Path.c_str());
-      // sequencer5().add<SoundObject>(0, 44000).set(
+      // show.add(5, 0, 44000).set(
 
       //     Song5Path.c_str());
-      // sequencer6().add<SoundObject>(0, 44000).set(
+      // show.add(6, 0, 44000).set(
 
       //     Song6Path.c_str());
     }
@@ -545,70 +727,75 @@ public:
       }
       if (k.key() == '1') {
         sceneIndex = 1;
-        globalTime = 0.0;
-        sceneTime = 0.0;
+        seekShow(0.0);
         running = true;
         std::cout << "scene index: " << 1 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer1().playSequence();
+        show.playScene(1);
 
         return true;
       }
       if (k.key() == '2') {
         sceneIndex = 2;
-        globalTime = 119.0;
-        sceneTime = 0.0;
+        seekShow(119.0);
         running = true;
         std::cout << "scene index: " << 2 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer2().playSequence();
+        show.playScene(2);
 
         return true;
       }
       if (k.key() == '3') {
         sceneIndex = 3;
-        globalTime = 335.0;
-        sceneTime = 0.0;
+        seekShow(335.0);
         running = true;
         std::cout << "scene index: " << 3 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer3().playSequence();
+        show.playScene(3);
         return true;
       }
       if (k.key() == '4') {
         sceneIndex = 4;
-        globalTime = 444.0;
-        sceneTime = 0.0;
+        seekShow(444.0);
         running = true;
         std::cout << "scene index: " << 4 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer4().playSequence();
+        show.playScene(4);
         return true;
       }
       if (k.key() == '5') {
         sceneIndex = 5;
-        globalTime = 936.0;
-        sceneTime = 0.0;
+        seekShow(936.0);
         running = true;
         std::cout << "scene index: " << 5 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer5().playSequence();
+        show.playScene(5);
         return true;
       }
       if (k.key() == '6') {
         sceneIndex = 6;
-        globalTime = 1105.0;
-        sceneTime = 0.0;
+        seekShow(1105.0);
         running = true;
         std::cout << "scene index: " << 6 << "global time: " << globalTime
                   << std::endl;
 
-        sequencer6().playSequence();
+        show.playScene(6);
+        return true;
+      }
+      if (k.key() == 't') {
+        showTiming = !showTiming;
+        return true;
+      }
+      if (k.key() == 'p') {
+        frameProfiler.print(std::cout);
+        audioProfiler.print(std::cout);
+        audioProfiler.writeCsv("audioProfile.csv");
+        audioProfiler.reset();
         return true;
       }
       // sceneIndexParam.set(sceneIndex);
@@ -618,6 +805,26 @@ public:
   }
 
   void onAnimate(double dt) override {
+    frameProfiler.beginFrame();
+    auto animateTime = frameProfiler.cpu(animatePhase);
+    if (showTiming) frameProfiler.buildOverlay(timingMesh);
+    if (isPrimary()) {
+      meter.poll();
+      meterSendTime += dt;
+      if (meterSendTime >= 0.1 && meterOsc) {
+        meterSendTime = 0.0;
+        meter.sendOsc(*meterOsc);
+      }
+      audioProfiler.pollEvents([](const AudioProfiler::Event &e) {
+        if (e.kind == AudioProfiler::EventKind::LATE)
+          std::cout << "audio: block " << e.block << " late by "
+                    << e.intervalUs << " us, " << e.missed << " missed"
+                    << std::endl;
+        else
+          std::cout << "audio: block " << e.block << " overran, "
+                    << e.durationUs << " us" << std::endl;
+      });
+    }
 
     // boiler plate for every scene / main template
     // if (!isPrimary()) {
@@ -632,45 +839,40 @@ public:
     // std::cout << "index : " << state().sceneIndex << std::endl;
     // std::cout << "time : " << state().sceneTime << std::endl;
 
+    if (isPrimary()) {
+      showClock.setRunning(running);
+      AudioControls controls;
+      controls.sceneIndex = sceneIndex;
+      controls.seeks = seeks;
+      audioControls.publish(controls);
+    }
     if (running == true) {
 
       if (isPrimary()) {
-        globalTime += dt;
-        // // time : " << globalTime << std::endl;
-        sceneTime = sceneTime + dt;
-        if (globalTime >= 0.0 && globalTime < 0.0 + dt) {
-          sceneIndex = 1;
-          sceneTime = 0.0;
-          sequencer1().playSequence();
-          std::cout << "started scene 1" << std::endl;
-        } else if (globalTime >= 119.0 && globalTime < 119.0 + dt) {
-          sceneIndex = 2;
-          sceneTime = 0.0;
-          sequencer2().playSequence();
-          std::cout << "started scene 2" << std::endl;
-        } else if (globalTime >= 335.0 && globalTime < 335.0 + dt) {
-          sceneIndex = 3;
-          sceneTime = 0.0;
-          sequencer3().playSequence();
-          std::cout << "started scene 3" << std::endl;
-        } else if (globalTime >= 444.0 && globalTime < 444.0 + dt) {
-          sceneIndex = 4;
-          sceneTime = 0.0;
-          sequencer4().playSequence();
-          std::cout << "started scene 4" << std::endl;
-        } else if (globalTime >= 936.0 && globalTime < 936.0 + dt) {
-          sceneIndex = 5;
-          sceneTime = 0.0;
-          sequencer5().playSequence();
-          std::cout << "started scene 5" << std::endl;
-        } else if (globalTime >= 1105.0 && globalTime < 1105.0 + dt) {
-          sceneIndex = 6;
-          sceneTime = 0.0;
-          sequencer6().playSequence();
-          std::cout << "started scene 6" << std::endl;
+        globalTime = showClock.seconds();
+        sceneTime = globalTime - sceneStart;
+        // fire every cue crossed since last frame, whatever the frame rate
+        for (int i = 0; i < 6; ++i) {
+          if (cueTime < sceneStarts[i] && globalTime >= sceneStarts[i]) {
+            sceneIndex = i + 1;
+            sceneStart = sceneStarts[i];
+            sceneTime = globalTime - sceneStart;
+            show.playScene(i + 1);
+            std::cout << "started scene " << i + 1 << std::endl;
+          }
         }
+        cueTime = globalTime;
+        auto syncTime = frameProfiler.cpu(syncPhase);
+        state().clockTime = globalTime;
+        state().sceneTime = sceneTime;
+        state().sceneIndex = sceneIndex;
+        state().features = audioFeatures.latest();
       } else {
-        // sceneTime = localTime;
+        // replicas take the primary's clock for this frame
+        auto syncTime = frameProfiler.cpu(syncPhase);
+        globalTime = state().clockTime;
+        sceneTime.setNoCalls(state().sceneTime);
+        sceneIndex.setNoCalls(state().sceneIndex);
       }
       shadedSphereScene3.update();
       shadedSphereScene4.update();
@@ -693,8 +895,11 @@ public:
 
   void onDraw(al::Graphics &g) override {
     // end of boilerplate
+    auto drawTime = frameProfiler.cpuGpu(drawPhase);
 
-    if (running == true) {
+    const int scene = sceneIndex.get();
+    if (running == true && scene >= 1 && scene <= 6) {
+      auto sceneDrawTime = frameProfiler.cpuGpu(scenePhase[scene - 1]);
 
       // SCENE 1 DRAW /////
       if (sceneIndex == 1) {
@@ -709,7 +914,9 @@ public:
 
         g.shader(shadedSphereScene3.shader());
         shadedSphereScene3.setUniformFloat("u_time", sceneTime);
+        setFeatureUniforms(shadedSphereScene3);
 
+        auto pass = frameProfiler.cpuGpu(spherePassPhase);
         shadedSphereScene3.draw(g);
         shadedSphereScene3.update();
       }
@@ -718,7 +925,9 @@ public:
 
         g.shader(shadedSphereScene4.shader());
         shadedSphereScene4.setUniformFloat("u_time", sceneTime);
+        setFeatureUniforms(shadedSphereScene4);
 
+        auto pass = frameProfiler.cpuGpu(spherePassPhase);
         shadedSphereScene4.draw(g);
       }
 
@@ -727,7 +936,9 @@ public:
 
         g.shader(shadedSphereScene5.shader());
         shadedSphereScene5.setUniformFloat("u_time", sceneTime);
+        setFeatureUniforms(shadedSphereScene5);
 
+        auto pass = frameProfiler.cpuGpu(spherePassPhase);
         shadedSphereScene5.draw(g);
       }
 
@@ -735,6 +946,17 @@ public:
         drawScene6(g);
       }
     }
+
+    if (showTiming) {
+      g.pushCamera(al::Viewpoint::IDENTITY);
+      g.depthTesting(false);
+      g.blending(true);
+      g.blendTrans();
+      g.meshColor();
+      g.draw(timingMesh);
+      g.blending(false);
+      g.popCamera();
+    }
   }
 
   void createScene1() {
@@ -758,14 +980,15 @@ public:
     }
     std::cout << "made attractor sphere with vertices # : "
               << attractorMesh.vertices().size() << std::endl;
+    mainAttractor.setPoints(attractorMesh.vertices());
 
     // SET EFFEFCTS
     bodyScatter.setBaseMesh(bodyMesh.vertices());
     bodyScatter.setParams(0.5, 20.0);
     bodyScatter.setScatterVector(bodyMesh);
-    mainRippleX.setParams(4, 0.2, 4.0, 'y');
+    mainRippleY.setParams(4, 0.2, 4.0, 'y');
     mainRippleX.setParams(4, 0.2, 6.0, 'x');
-    mainRippleX.setParams(4, 0.2, 5.0, 'z');
+    mainRippleZ.setParams(4, 0.2, 5.0, 'z');
 
     mainEffectChain.pushBack(&mainRippleX);
     mainEffectChain.pushBack(&mainRippleY);
@@ -784,41 +1007,35 @@ public:
 
     // animate vertices
     if (isPrimary()) {
-      if (sceneTime < particlesSlowRippleEvent) {
-        mainAttractor.processThomas(attractorMesh, sceneTime, 0);
-      }
-
+      // steps and drifts from the overlapping windows are queued and applied
+      // to the cloud in one pass below
       if (sceneTime >= particlesSlowRippleEvent &&
           sceneTime <= rippleSpeedUpEvent) {
         attractorSpeedScene1 = 0.00005;
-        mainAttractor.processThomas(attractorMesh, sceneTime,
-                                    attractorSpeedScene1);
-        attractorMesh.translate(
+        mainAttractor.queueStep(attractorSpeedScene1);
+        mainAttractor.queueTranslate(
 
             0, 20 * 0.00001, -5 * 0.00002);
       }
 
       if (sceneTime >= rippleSpeedUpEvent && sceneTime <= stopSpeedUpEvent) {
         attractorSpeedScene1 = 0.00015;
-        mainAttractor.processThomas(attractorMesh, sceneTime,
-                                    attractorSpeedScene1);
-        attractorMesh.translate(
+        mainAttractor.queueStep(attractorSpeedScene1);
+        mainAttractor.queueTranslate(
 
             0, 40 * 0.0001, -5 * 0.00003);
       }
       if (sceneTime >= stopSpeedUpEvent && sceneTime <= moveInEvent) {
         attractorSpeedScene1 = 0.00005;
-        mainAttractor.processThomas(attractorMesh, sceneTime,
-                                    attractorSpeedScene1);
-        attractorMesh.translate(
+        mainAttractor.queueStep(attractorSpeedScene1);
+        mainAttractor.queueTranslate(
 
             0, 300 * 0.00005, -15 * 0.00005);
       }
 
       if (sceneTime >= stopSpeedUpEvent) {
         attractorSpeedScene1 = 0.00001;
-        mainAttractor.processThomas(attractorMesh, sceneTime,
-                                    attractorSpeedScene1);
+        mainAttractor.queueStep(attractorSpeedScene1);
         // attractorMesh.translate(
 
         //     0, 0, -10 * 0.0002);
@@ -834,29 +1051,32 @@ public:
       }
       if (sceneTime >= moveInEvent) {
         attractorSpeedScene1 = 0.00001;
-        mainAttractor.processThomas(attractorMesh, sceneTime,
-                                    attractorSpeedScene1);
+        mainAttractor.queueStep(attractorSpeedScene1);
         bodyScatter.setParams(6, 20.0);
         bodyScatter.triggerIn(true);
 
-        attractorMesh.translate(
+        mainAttractor.queueTranslate(
 
             0, 4500.5 * 0.00001, -4000.0 * 0.00001);
         // attractorMesh.scale(0.996);
       }
+      mainAttractor.applyFrame(attractorMesh);
       bodyEffectChain.process(bodyMesh, sceneTime);
     }
 
-    if (isPrimary()) {
-      for (int i = 0; i < attractorMesh.vertices().size(); i++)
-        state().scene1Mesh[i] = attractorMesh.vertices()[i];
-      for (int i = 0; i < bodyMesh.vertices().size(); i++)
-        state().scene1BodyMesh[i] = bodyMesh.vertices()[i];
-    } else {
-      for (int i = 0; i < attractorMesh.vertices().size(); i++)
-        attractorMesh.vertices()[i] = state().scene1Mesh[i];
-      for (int i = 0; i < bodyMesh.vertices().size(); i++)
-        bodyMesh.vertices()[i] = state().scene1BodyMesh[i];
+    {
+      auto syncTime = frameProfiler.cpu(syncPhase);
+      if (isPrimary()) {
+        for (int i = 0; i < attractorMesh.vertices().size(); i++)
+          state().scene1Mesh[i] = attractorMesh.vertices()[i];
+        for (int i = 0; i < bodyMesh.vertices().size(); i++)
+          state().scene1BodyMesh[i] = bodyMesh.vertices()[i];
+      } else {
+        for (int i = 0; i < attractorMesh.vertices().size(); i++)
+          attractorMesh.vertices()[i] = state().scene1Mesh[i];
+        for (int i = 0; i < bodyMesh.vertices().size(); i++)
+          bodyMesh.vertices()[i] = state().scene1BodyMesh[i];
+      }
     }
 
     attractorMesh.update();
@@ -883,6 +1103,7 @@ public:
     g.draw(attractorMesh);
 
     if (sceneTime >= bodyCloudAppear) {
+      auto pass = frameProfiler.cpuGpu(pointPassPhase);
       g.shader(pointShader);
       pointShader.uniform("pointSize", 0.01);
       pointShader.uniform("inputColor",
@@ -907,24 +1128,22 @@ public:
     blobMesh.primitive(
         al::Mesh::LINE_STRIP_ADJACENCY); // test if i like lines of triangles
                                          // more in the sphere
-    blobMesh.generateNormals();
+    // lines have no faces to average, blobShader lights them instead
+    blobNormals.setMode(NormalsMode::SHADER_DERIVATIVE);
+    blobNormals.build(blobMesh);
     creature.addStarfish(starCreatureMesh);
+    starNormals.build(starCreatureMesh);
     starCreatureMesh.update();
 
-    for (int b = 0; b < nAgentsScene2; ++b) {
-      al::Nav p;
-      blobs.push_back(p);
-    }
+    blobSwarm.bind(state().blobs);
 
     // Only assign random positions and orientations on primary node
     if (isPrimary()) {
       for (int b = 0; b < nAgentsScene2; ++b) {
-        blobs[b].pos() = randomVec3f(5.0f);
-        blobs[b]
-            .quat()
-            .set(al::rnd::uniformS(), al::rnd::uniformS(), al::rnd::uniformS(),
-                 al::rnd::uniformS())
-            .normalize();
+        al::Vec3f p = randomVec3f(5.0f);
+        blobSwarm.setAgent(b, p.x, p.y, p.z, al::rnd::uniformS(),
+                           al::rnd::uniformS(), al::rnd::uniformS(),
+                           al::rnd::uniformS());
       }
     }
 
@@ -1020,62 +1239,47 @@ public:
         // blobsEffectChain.clear(); // Optional: end FX
       }
     }
-    // Animate all blobs
+    // Animate all blobs. the swarm writes straight into state(), replicas
+    // read the same arrays in drawScene2
     if (isPrimary()) {
-      for (int i = 0; i < blobs.size(); ++i) {
-        al::Vec3f pos = blobs[i].pos();
+      blobSwarm.bind(state().blobs);
+      FlockParams blobFlockParams;
+      blobFlockParams.separationRadius = blobSeperationThresh;
+      blobFlockParams.neighborRadius = blobSeperationThresh * 2.0f;
+      blobFlockParams.alignment = 0.1f;
+      blobFlockParams.cohesion = 0.02f;
+      blobFlock.compute(blobSwarm.positionX(), blobSwarm.positionY(),
+                        blobSwarm.positionZ(), blobSwarm.velocityX(),
+                        blobSwarm.velocityY(), blobSwarm.velocityZ(),
+                        blobSwarm.size(), blobFlockParams);
+
+      SwarmParams blobParams;
+      blobParams.boundary = scene2Boundary;
+      blobParams.homeRate = 0.01; // slow turn rate to avoid jitter
+      blobParams.speed = targetSpeedScene2 * 15.0f;
+      blobParams.steerX = blobFlock.x();
+      blobParams.steerY = blobFlock.y();
+      blobParams.steerZ = blobFlock.z();
+      blobParams.steerRate = 0.05f;
+      blobSwarm.step(dt, blobParams);
 
-        if (pos.mag() >= scene2Boundary) {
-          blobs[i].faceToward(al::Vec3f(0),
-                              0.01); // slow turn rate to avoid jitter
-          blobs[i].moveF(blobSizeScene2);
-        }
-        // for setting state for renderers
-        blobs[i].moveF(targetSpeedScene2 * 15.0f); // use smoothed speed
-        blobs[i].step(dt);
-        state().blobPosX[i] = blobs[i].pos().x;
-        state().blobPosY[i] = blobs[i].pos().y;
-        state().blobPosZ[i] = blobs[i].pos().z;
-        state().blobQuatW[i] = blobs[i].quat().w;
-        state().blobQuatX[i] = blobs[i].quat().x;
-        state().blobQuatY[i] = blobs[i].quat().y;
-        state().blobQuatZ[i] = blobs[i].quat().z;
-      }
       blobsEffectChain.process(blobMesh, sceneTime);
-      blobMesh.generateNormals();
+      blobNormals.update(blobMesh);
       blobMesh.update();
 
       starEffectChain.process(starCreatureMesh, sceneTime);
-      starCreatureMesh.generateNormals();
+      starNormals.update(starCreatureMesh);
       starCreatureMesh.update();
 
       // THIS PROCESSING MIGHT NEED TO UPDATE OUTSIDE PRIMARY AS WELL?
     }
     if (!isPrimary()) {
-      // updating pos and turning state
-      for (int i = 0; i < blobs.size(); ++i) {
-        blobs[i].pos().set(state().blobPosX[i], state().blobPosY[i],
-                           state().blobPosZ[i]);
-
-        // SETTING QUAT
-
-        blobs[i].quat().set(state().blobQuatW[i], state().blobQuatX[i],
-                            state().blobQuatY[i], state().blobQuatZ[i]);
-
-        // blobs[i]
-        //     .quat()
-        //     .set(blobs[i].pos().x, blobs[i].pos().y,
-        //     blobs[i].pos().z, 1.0f) .normalize(); // more efficient but
-        //     less interesting
-        // turning weird? come here
-        blobMesh.update();
-        starCreatureMesh.update();
-      }
+      blobMesh.update();
+      starCreatureMesh.update();
     }
   }
 
   void drawScene2(al::Graphics &g) {
-    std::cout << "scene 2 draw " << std::endl;
     g.clear(0.0, 0.0, 0.09 + ((sceneTime / (334.0 - 118.0)) * 0.15));
     g.light(light);
 
@@ -1092,17 +1296,24 @@ public:
     material.shininess(50);
     g.material(material);
 
-    for (int i = 0; i < blobs.size(); ++i) {
+    const auto &blobs = state().blobs;
+    for (int i = 0; i < nAgentsScene2; ++i) {
       al::Vec3f newColor = colorPallete[i % 3];
 
       g.pushMatrix();
-      g.translate(blobs[i].pos());
-      g.rotate(blobs[i].quat());
+      g.translate(blobs.posX[i], blobs.posY[i], blobs.posZ[i]);
+      g.rotate(al::Quatf(blobs.quatW[i], blobs.quatX[i], blobs.quatY[i],
+                         blobs.quatZ[i]));
       g.scale(1.5);
       if (i % 2 == 1) {
-        g.color(newColor.x, newColor.y, newColor.z,
-                0.3 + (sin(sceneTime * 2.0) * 0.1));
+        g.shader(blobShader);
+        blobShader.uniform("tint",
+                           al::Vec4f(newColor.x, newColor.y, newColor.z,
+                                     0.3 + (sin(sceneTime * 2.0) * 0.1)));
+        blobShader.uniform("lightDir", al::Vec3f(0.3, 1.0, 0.5));
+        blobShader.uniform("ambient", 0.5f);
         g.draw(blobMesh);
+        g.shader();
       } else {
         g.color(newColor.x + 0.4, newColor.y + 0.4, newColor.z + 0.4,
                 0.4 + (sin(sceneTime * 0.6) * 0.1));
@@ -1122,26 +1333,18 @@ public:
     jellyCreatureMesh.scale(jelliesizeScene2);
     jellyCreatureMesh.primitive(al::Mesh::POINTS);
     jellyCreatureMesh.generateNormals();
-    jellyPulse.setBaseMesh(jellyCreatureMesh.vertices());
+    jellyEffectChain.setBaseMesh(jellyCreatureMesh.vertices());
     jellyPulse.setParams(scene6pulseSpeed, scene6pulseAmount, 1);
     jellyEffectChain.pushBack(&jellyPulse);
     jellyCreatureMesh.update();
 
+    jellySwarm.bind(state().jellies);
     for (int b = 0; b < MAX_JELLIES; ++b) {
-      al::Nav p;
-      p.pos() = randomVec3f(5);
-      p.quat()
-          .set(al::rnd::uniformS(), al::rnd::uniformS(), al::rnd::uniformS(),
-               al::rnd::uniformS())
-          .normalize();
-      jellies.push_back(p);
-      state().jellyX[b] = p.pos().x;
-      state().jellyY[b] = p.pos().y;
-      state().jellyZ[b] = p.pos().z;
-      state().jellyQuatW[b] = p.quat().w;
-      state().jellyQuatX[b] = p.quat().x;
-      state().jellyQuatY[b] = p.quat().y;
-      state().jellyQuatZ[b] = p.quat().z;
+      al::Vec3f p = randomVec3f(5);
+      jellySwarm.setAgent(b, p.x, p.y, p.z, al::rnd::uniformS(),
+                          al::rnd::uniformS(), al::rnd::uniformS(),
+                          al::rnd::uniformS());
+      jellySwarm.setPhase(b, b * 10.0f); // staggered wobble
     }
   }
 
@@ -1214,41 +1417,38 @@ public:
         scene6Boundary = 60; // slow dissolve out
       }
 
-      for (int i = 0; i < jellies.size(); ++i) {
-        float t = globalTime + i * 10.0f;
-        float wobbleAmount = 0.01f * std::sin(t * 0.7f);
-        jellies[i].turnF(0.004f + wobbleAmount);
-        if (jellies[i].pos().mag() > scene6Boundary.get())
-          jellies[i].faceToward(al::Vec3f(0), 0.005f);
-        jellies[i].moveF(jelliesSpeedScene6.get() * 2.0);
-        jellies[i].step(dt);
-
-        state().jellyX[i] = jellies[i].pos().x;
-        state().jellyY[i] = jellies[i].pos().y;
-        state().jellyZ[i] = jellies[i].pos().z;
-        state().jellyQuatW[i] = jellies[i].quat().w;
-        state().jellyQuatX[i] = jellies[i].quat().x;
-        state().jellyQuatY[i] = jellies[i].quat().y;
-        state().jellyQuatZ[i] = jellies[i].quat().z;
-
-        state().flicker =
-            0.25f +
-            0.05f * std::sin(sceneTime * 2.0); // move back outside is primary
-
-        // move back outside is primary?
-        jellyPulse.setParams(scene6pulseSpeed / 2.0, scene6pulseAmount * 2.5,
-                             1);
-        jellyEffectChain.process(jellyCreatureMesh, sceneTime);
-        jellyCreatureMesh.update();
-      }
-    }
-    if (!isPrimary()) {
-      for (int i = 0; i < jellies.size(); ++i) {
-        jellies[i].pos().set(state().jellyX[i], state().jellyY[i],
-                             state().jellyZ[i]);
-        jellies[i].quat().set(state().jellyQuatW[i], state().jellyQuatX[i],
-                              state().jellyQuatY[i], state().jellyQuatZ[i]);
-      }
+      // wobble phase is globalTime + 10 * index, set up in createScene6
+      SwarmParams jellyParams;
+      jellyParams.turn = 0.004f;
+      jellyParams.wobbleAmount = 0.01f;
+      jellyParams.wobbleRate = 0.7f;
+      jellyParams.time = globalTime;
+      jellyParams.boundary = scene6Boundary.get();
+      jellyParams.homeRate = 0.005f;
+      jellyParams.speed = jelliesSpeedScene6.get() * 2.0;
+      jellySwarm.bind(state().jellies);
+
+      // jellies only keep their distance, no schooling
+      FlockParams jellyFlockParams;
+      jellyFlockParams.separationRadius = jellieseperationThresh.get();
+      jellyFlockParams.neighborRadius = jellieseperationThresh.get();
+      jellyFlock.compute(jellySwarm.positionX(), jellySwarm.positionY(),
+                         jellySwarm.positionZ(), nullptr, nullptr, nullptr,
+                         jellySwarm.size(), jellyFlockParams);
+      jellyParams.steerX = jellyFlock.x();
+      jellyParams.steerY = jellyFlock.y();
+      jellyParams.steerZ = jellyFlock.z();
+      jellyParams.steerRate = 0.02f;
+      jellySwarm.step(dt, jellyParams);
+
+      state().flicker =
+          0.25f +
+          0.05f * std::sin(sceneTime * 2.0); // move back outside is primary
+
+      // one shared mesh for every jelly, so deform it once per frame
+      jellyPulse.setParams(scene6pulseSpeed / 2.0, scene6pulseAmount * 2.5, 1);
+      jellyEffectChain.process(jellyCreatureMesh, sceneTime);
+      jellyCreatureMesh.update();
     }
   }
 
@@ -1268,11 +1468,12 @@ public:
     g.material(material);
     g.pointSize(pointSizeScene6.get());
 
-    for (int i = 0; i < jellies.size(); ++i) {
+    const auto &jellies = state().jellies;
+    for (int i = 0; i < MAX_JELLIES; ++i) {
       g.pushMatrix();
-      g.translate(state().jellyX[i], state().jellyY[i], state().jellyZ[i]);
-      g.rotate(al::Quatf(state().jellyQuatW[i], state().jellyQuatX[i],
-                         state().jellyQuatY[i], state().jellyQuatZ[i]));
+      g.translate(jellies.posX[i], jellies.posY[i], jellies.posZ[i]);
+      g.rotate(al::Quatf(jellies.quatW[i], jellies.quatX[i], jellies.quatY[i],
+                         jellies.quatZ[i]));
       g.pointSize(2.0);
       g.color(1.0f, 0.4f, 0.7f, state().flicker);
       g.draw(jellyCreatureMesh);
@@ -1281,63 +1482,118 @@ public:
   }
 
   void onSound(al::AudioIOData &io) override {
-    if (isPrimary()) {
-      spatializer->prepare(io);
+    if (isPrimary()) audioGraph.process(io, io.framesPerBuffer());
+  }
 
-      if (sceneIndex == 1) {
-        mSequencer1.render(io);
-      } else if (sceneIndex == 2) {
-        mSequencer2.render(io);
-      } else if (sceneIndex == 3) {
-        mSequencer3.render(io);
-      } else if (sceneIndex == 4) {
-        mSequencer4.render(io);
-      } else if (sceneIndex == 5) {
-        mSequencer5.render(io);
-      } else if (sceneIndex == 6) {
-        mSequencer6.render(io);
-      }
+  void onExit() override {
+    frameProfiler.print(std::cout);
+    frameProfiler.closeCsv();
+    if (isPrimary() && audioProfiler.blockCount()) {
+      audioProfiler.print(std::cout);
+      audioProfiler.writeCsv("audioProfile.csv");
+    }
+  }
 
-      // Joels idea to put sub routing before spatialization? this seems to
-      // seg fault comment it out if it breaks things for (unsigned sample =
-      // 0; sample < io.framesPerBuffer(); sample++) {
-      //   io.out(47, sample) = io.out(0);
-      // }
-      // comment this version out of it breaks things
-      while (io()) {
-        io.out(47) = io.out(0); // io.bus(0) * 0.5;
+  void buildAudioGraph() {
+    audioGraph.add("show", [this](al::AudioIOData &io, int fpb) {
+      const AudioControls &controls = audioControls.acquire();
+      show.advance(fpb);
+      sceneFade.process(io, controls.sceneIndex,
+                        [this](int scene, al::AudioIOData &out) {
+                          show.render(out, scene);
+                        });
+
+      // the voices mix to channel 0; pull that out and spatialize it as one
+      // source. anything with its own buffer and position can take another
+      // slot and costs one more pass over the speakers, not a spatializer
+      const int frames = std::min<int>(fpb, showMix.size());
+      float *mono = io.outBuffer(0);
+      std::copy(mono, mono + frames, showMix.data());
+      std::fill(mono, mono + frames, 0.0f);
+      audioFeatures.push(showMix.data(), frames);
+      if (controls.sceneIndex != pathScene || controls.seeks != pathSeeks) {
+        pathScene = controls.sceneIndex;
+        pathSeeks = controls.seeks;
+        pathFrame = 0;
+      }
+      if (pathScene == 1 && !scene1Path.empty() &&
+          scene1Path.speakers() == static_cast<int>(pathGains.size())) {
+        scene1Path.gainsAt(pathFrame / io.framesPerSecond(), pathGains.data());
+        spatializer.setSourceGains(0, showMix.data(), pathGains.data());
+      } else {
+        spatializer.setSource(0, showMix.data(), 0.0f, 0.0f, 0.0f);
       }
+      pathFrame += fpb;
+      if (monitoring) {
+        std::fill(feedScratch.begin(), feedScratch.end(), 0.0f);
+        spatializer.beginBlock(speakerFeeds.data(), frames);
+      } else {
+        spatializer.beginBlock(io);
+      }
+    });
+    audioGraph.addParallel(
+        "source gains",
+        [this](al::AudioIOData &) { return spatializer.sourceSlots(); },
+        [this](al::AudioIOData &, int i, int) { spatializer.updateGains(i); });
+    audioGraph.addParallel(
+        "speaker mix",
+        [this](al::AudioIOData &) { return spatializer.mixSpeakers(); },
+        [this](al::AudioIOData &, int k, int) { spatializer.mixSpeaker(k); });
+    audioGraph.add("route", [this](al::AudioIOData &io, int fpb) {
+      spatializer.endBlock();
+      if (monitoring) {
+        const int frames = std::min<int>(fpb, showMix.size());
+        binaural.process(feedPtrs.data(), static_cast<int>(feedPtrs.size()),
+                         io.outBuffer(0), io.outBuffer(1), frames);
+      } else {
+        outputRouter.process(io);
+      }
+    });
+    if (correcting && !monitoring)
+      audioGraph.addParallel(
+          "correction",
+          [this](al::AudioIOData &io) {
+            return std::min<int>(io.channelsOut(),
+                                 speakerCorrection.channelCount());
+          },
+          [this](al::AudioIOData &io, int c, int frames) {
+            speakerCorrection.processChannel(c, io.outBuffer(c), frames);
+          });
+    audioGraph.add("meter", [this](al::AudioIOData &io, int fpb) {
+      meter.process(io);
+      showClock.advance(fpb);
+    });
+  }
 
-      spatializer->renderBuffer(io, {0, 0, 0}, io.outBuffer(0),
-                                io.framesPerBuffer());
-      spatializer->finalize(io);
+  // every scene's voices, preallocated. cues are added in onCreate
+  ShowSequencer<SoundObject> show{64};
 
-      // while (io()) {
-      //   io.out(47) = io.out(0); // io.bus(0) * 0.5;
-      // }
-    }
+  // u_bands[], u_loudness, u_onset ... from the primary's analysis
+  void setFeatureUniforms(ShadedSphere &sphere) {
+    AudioFeatures::uniforms(state().features, [&](const char *name, float v) {
+      sphere.setUniformFloat(name, v);
+    });
   }
 
-  al::SynthSequencer mSequencer1;
-  al::SynthSequencer mSequencer2;
-  al::SynthSequencer mSequencer3;
-  al::SynthSequencer mSequencer4;
-  al::SynthSequencer mSequencer5;
-  al::SynthSequencer mSequencer6;
-
-  al::SynthSequencer &sequencer1() { return mSequencer1; }
-  al::SynthSequencer &sequencer2() { return mSequencer2; }
-  al::SynthSequencer &sequencer3() { return mSequencer3; }
-  al::SynthSequencer &sequencer4() { return mSequencer4; }
-  al::SynthSequencer &sequencer5() { return mSequencer5; }
-  al::SynthSequencer &sequencer6() { return mSequencer6; }
+  // jump the show clock, cues before t are treated as already fired
+  void seekShow(double t) {
+    ++seeks;
+    showClock.seek(t);
+    globalTime = t;
+    sceneStart = t;
+    sceneTime = 0.0;
+    cueTime = t;
+  }
 };
 
 int main() {
   MyApp app;
 
+  // 256 frame blocks on the sphere: the spatializer and correction fork
+  // across the audio workers (buildAudioGraph). off the sphere the show is
+  // still spatialized to the sphere's 60 speakers, then folded to headphones
   if (al::sphere::isSphereMachine())
-    app.configureAudio(44100, 512, 60, 0);
+    app.configureAudio(44100, 256, 60, 0);
   else
     app.configureAudio(44100, 512, 2, 0);
   app.start();
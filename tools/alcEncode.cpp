@@ -0,0 +1,161 @@
+// encodes wav stems into .alc (utility/losslessAudio.hpp) for AdmStreamer,
+// and checks every file decodes back to the same samples before keeping it.
+//
+//   bin/alcEncode in.wav [out.alc]
+//   bin/alcEncode --rate 48000 sourceAudio/piece/
+//
+// a folder encodes each of its wavs next to the original. .alc files don't
+// go through the SrcCache, so --rate converts (SrcCache::convert, the same
+// windowed sinc) before encoding when a file isn't at the device rate. the
+// converted samples are rounded to 24 bit, which is what lets them compress;
+// float output of the resampler would be stored at about its own size.
+// the wavs are left in place; only the streaming path reads .alc, see
+// AdmStreamer.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../utility/losslessAudio.hpp"
+#include "../utility/srcCache.hpp"
+
+namespace fs = std::filesystem;
+
+static long long fileBytes(const std::string &path) {
+  std::error_code ec;
+  const auto n = fs::file_size(path, ec);
+  return ec ? 0 : static_cast<long long>(n);
+}
+
+// the 24 bit grid .alc codes exactly (q / 2^23)
+static void round24(float *x, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    x[i] = std::round(std::clamp(x[i], -1.0f, 1.0f - 1.0f / 8388608.0f) *
+                      8388608.0f) /
+               8388608.0f +
+           0.0f; // + 0.0f: no -0, as WavReader
+}
+
+static bool sameSamples(const std::string &wav, const std::string &alcPath,
+                        bool rounded) {
+  WavReader a;
+  LosslessReader b;
+  if (!a.open(wav) || !b.open(alcPath)) return false;
+  if (a.frames != b.frames || a.channels != b.channels) return false;
+  const std::size_t chunk = 1 << 16;
+  std::vector<float> x(chunk * a.channels), y(chunk * a.channels);
+  for (;;) {
+    const std::size_t na = a.read(x.data(), chunk), nb = b.read(y.data(), chunk);
+    if (na != nb) return false;
+    if (na == 0) return true;
+    if (rounded) round24(x.data(), na * a.channels);
+    if (std::memcmp(x.data(), y.data(), na * a.channels * sizeof(float)))
+      return false;
+  }
+}
+
+// in -> out at rate (0: the file's own). false leaves no output behind
+static bool encode(const std::string &in, const std::string &out, int rate) {
+  WavReader probe;
+  if (!probe.open(in)) {
+    std::printf("alcEncode: couldnt open %s\n", in.c_str());
+    return false;
+  }
+  std::string source = in;
+  const std::string resampled = out + ".src.wav";
+  if (rate > 0 && probe.sampleRate != rate) {
+    std::printf("alcEncode: %s %d -> %d Hz\n", in.c_str(), probe.sampleRate,
+                rate);
+    WorkerPool pool;
+    if (!SrcCache::convert(in, resampled, rate, pool)) {
+      std::printf("alcEncode: couldnt convert %s\n", in.c_str());
+      fs::remove(resampled);
+      return false;
+    }
+    source = resampled;
+  }
+  probe.close();
+
+  const auto start = std::chrono::steady_clock::now();
+  WavReader r;
+  LosslessWriter w;
+  bool ok = r.open(source) && w.open(out, r.channels, r.sampleRate);
+  const std::size_t chunk = 1 << 16;
+  std::vector<float> buf(chunk * std::max(1, r.channels));
+  while (ok) {
+    const std::size_t got = r.read(buf.data(), chunk);
+    if (got == 0) break;
+    if (source != in) round24(buf.data(), got * r.channels);
+    ok = w.write(buf.data(), got);
+  }
+  ok = w.close() && ok;
+  ok = ok && sameSamples(source, out, source != in);
+  const double s = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+  if (ok)
+    std::printf("%s: %d ch, %d Hz, %.1f s, %.1f MB -> %.1f MB (%.1f%%) in "
+                "%.1f s\n",
+                out.c_str(), r.channels, r.sampleRate,
+                double(r.frames) / std::max(1, r.sampleRate),
+                fileBytes(source) / 1e6, fileBytes(out) / 1e6,
+                100.0 * fileBytes(out) / std::max(1LL, fileBytes(source)), s);
+  else
+    std::printf("alcEncode: %s failed or didnt decode back exactly, removed\n",
+                out.c_str());
+  std::error_code ec;
+  if (!ok) fs::remove(out, ec);
+  if (source != in) fs::remove(resampled, ec);
+  return ok;
+}
+
+static bool isWav(const fs::path &p) {
+  std::string ext = p.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".wav";
+}
+
+int main(int argc, char **argv) {
+  int rate = 0;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--rate") && i + 1 < argc)
+      rate = std::atoi(argv[++i]);
+    else
+      args.push_back(argv[i]);
+  }
+  if (args.empty() || args.size() > 2) {
+    std::printf("usage: alcEncode [--rate hz] in.wav [out.alc]\n"
+                "       alcEncode [--rate hz] folder/\n");
+    return 2;
+  }
+
+  std::error_code ec;
+  if (fs::is_directory(args[0], ec)) {
+    std::vector<fs::path> wavs;
+    for (const auto &e : fs::directory_iterator(args[0], ec))
+      if (e.is_regular_file() && isWav(e.path())) wavs.push_back(e.path());
+    std::sort(wavs.begin(), wavs.end());
+    if (wavs.empty()) {
+      std::printf("alcEncode: no wav files in %s\n", args[0].c_str());
+      return 1;
+    }
+    int failed = 0;
+    for (const fs::path &p : wavs) {
+      fs::path out = p;
+      out.replace_extension(".alc");
+      failed += !encode(p.string(), out.string(), rate);
+    }
+    return failed ? 1 : 0;
+  }
+
+  fs::path out = args.size() == 2 ? fs::path(args[1]) : fs::path(args[0]);
+  if (args.size() == 1) out.replace_extension(".alc");
+  return encode(args[0], out.string(), rate) ? 0 : 1;
+}
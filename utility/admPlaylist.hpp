@@ -0,0 +1,263 @@
+#pragma once
+
+// gapless playlist of 54.1 pieces on top of AdmStreamer. while one piece
+// plays, a loader thread opens the next one and its I/O thread fills the
+// ring, so the first ringSeconds of it are already in memory when the
+// callback gets there. the hand-off is inside a callback, on the exact
+// sample the outgoing piece ends (or an equal-power crossfade ending
+// there), and every hand-off is queued with its program frame so the
+// picture can change shader on the same sample once it is audible.
+//
+//   AdmPlaylist playlist;
+//   playlist.add("../sourceAudio/pieceA/", 0);   // folder, shader index
+//   playlist.add("../sourceAudio/pieceB/", 3);
+//   playlist.prepare(60, 512, 0.5);             // channels, block, crossfade
+//   playlist.start();
+//   onSound:   playlist.read(outs, 60, frames);
+//   onAnimate: int frag; if (playlist.pollSwitch(audibleFrame, frag)) ...
+//
+// pieces play at 1x (no varispeed), otherwise "the last sample" would move
+// with the speed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "admStreamer.hpp"
+#include "spscRing.hpp"
+
+class AdmPlaylist {
+public:
+  struct Entry {
+    std::string folder;
+    int fragIndex = 0;
+  };
+  // a piece starting at programFrame, audio thread -> picture
+  struct Switch {
+    int64_t programFrame = 0;
+    int entry = 0;
+  };
+
+  AdmPlaylist() = default;
+  ~AdmPlaylist() { stop(); }
+  AdmPlaylist(const AdmPlaylist &) = delete;
+  AdmPlaylist &operator=(const AdmPlaylist &) = delete;
+
+  // --- setup, not real-time safe ---
+
+  void add(const std::string &folder, int fragIndex) {
+    entries.push_back(Entry{folder, fragIndex});
+  }
+  void setLoop(bool on) { loop = on; }
+  // how much of each piece is read ahead, the prefetch
+  void setPrefetchSeconds(float s) { prefetchSeconds = s; }
+  void useSrcCache(SrcCache *cache, int deviceRate) {
+    srcCache = cache;
+    cacheRate = deviceRate;
+  }
+
+  void prepare(int channelCount, int maxFrames, double crossfadeSeconds,
+               double deviceRate = 48000.0) {
+    channels = std::min(channelCount, kMaxOut);
+    blockMax = maxFrames;
+    fadeFrames =
+        static_cast<int64_t>(std::max(0.0, crossfadeSeconds) * deviceRate);
+    incoming.assign(static_cast<std::size_t>(channels) * maxFrames, 0.0f);
+    switches.reset(16);
+  }
+
+  // opens the first piece (blocking, it has to be there) and starts the
+  // loader on the rest
+  bool start() {
+    stop();
+    if (entries.empty()) return false;
+    if (!open(0, 0)) return false;
+    // let the first piece's read-ahead get going so it doesn't start short
+    for (int i = 0; i < 200 && slots[0]->bufferedFrames() <
+                                   std::min<uint64_t>(slots[0]->lengthFrames(),
+                                                      kStartFrames);
+         ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    current = 0;
+    nextStarted = false;
+    programFrame.store(0);
+    havePending = false;
+    const Switch first{0, 0};
+    switches.write(&first, 1);
+    quit.store(false);
+    loader = std::thread([this] { loaderLoop(); });
+    return true;
+  }
+
+  void stop() {
+    quit.store(true);
+    if (loader.joinable()) loader.join();
+    for (auto &s : slots) s.reset();
+    nextReady.store(false);
+    retired.store(-1);
+  }
+
+  const Entry &entry(int i) const { return entries[i]; }
+  int size() const { return static_cast<int>(entries.size()); }
+
+  // --- audio thread ---
+
+  // writes (not adds) frames samples to out[0..outChannels)
+  void read(float *const *out, int outChannels, int frames) {
+    outChannels = std::min(outChannels, channels);
+    AdmStreamer *cur = slots[current].get();
+    if (!cur) {
+      zero(out, outChannels, 0, frames);
+      programFrame.fetch_add(frames, std::memory_order_relaxed);
+      return;
+    }
+    // frames of the outgoing piece left before this block
+    const int64_t remaining = cur->outputFramesLeft();
+    cur->read(out, outChannels, frames);
+    const bool ready = nextReady.load(std::memory_order_acquire);
+    // the next piece starts fadeFrames before this one's last sample
+    const int64_t startAt = std::max<int64_t>(0, remaining - fadeFrames);
+    if (ready && startAt < frames) {
+      AdmStreamer *next = slots[1 - current].get();
+      const int from = static_cast<int>(startAt);
+      float *in[kMaxOut];
+      for (int c = 0; c < outChannels; ++c)
+        in[c] = &incoming[static_cast<std::size_t>(c) * blockMax] + from;
+      next->read(in, outChannels, frames - from);
+      for (int f = from; f < frames; ++f) {
+        // 0 -> 1 across the fade, 1 once the outgoing piece is over
+        const int64_t left = remaining - f;
+        const float x = fadeFrames > 0 && left > 0
+                            ? 1.0f - static_cast<float>(left) / fadeFrames
+                            : 1.0f;
+        const float gIn = std::sin(x * 1.57079632679f);
+        const float gOut = std::cos(x * 1.57079632679f);
+        for (int c = 0; c < outChannels; ++c)
+          out[c][f] = out[c][f] * gOut + in[c][f - from] * gIn;
+      }
+      if (!nextStarted) {
+        nextStarted = true;
+        const Switch s{programFrame.load(std::memory_order_relaxed) + from,
+                       pendingEntry.load(std::memory_order_relaxed)};
+        switches.write(&s, 1);
+      }
+      if (remaining <= frames) {
+        // the outgoing piece is done; the loader closes it
+        retired.store(current, std::memory_order_release);
+        current = 1 - current;
+        nextStarted = false;
+        nextReady.store(false, std::memory_order_release);
+      }
+    }
+    programFrame.fetch_add(frames, std::memory_order_relaxed);
+  }
+
+  template <class IO> void onSound(IO &io) {
+    const int outs = std::min<int>(io.channelsOut(), kMaxOut);
+    float *outPtrs[kMaxOut];
+    for (int c = 0; c < outs; ++c) outPtrs[c] = io.outBuffer(c);
+    read(outPtrs, outs, io.framesPerBuffer());
+  }
+
+  // --- picture side, one reader ---
+
+  // frames handed to the device so far
+  int64_t programFrames() const {
+    return programFrame.load(std::memory_order_relaxed);
+  }
+  // true once a piece that started at or before audibleFrame is newly
+  // audible, with its shader index
+  bool pollSwitch(int64_t audibleFrame, int &fragIndex) {
+    if (!havePending && switches.read(&pending, 1) == 1) havePending = true;
+    if (!havePending || pending.programFrame > audibleFrame) return false;
+    havePending = false;
+    shown = pending.entry;
+    shownStart = pending.programFrame;
+    fragIndex = entries[pending.entry].fragIndex;
+    return true;
+  }
+  // position in the piece being shown, for u_time
+  double positionSeconds(int64_t audibleFrame, double rate) const {
+    return std::max<int64_t>(0, audibleFrame - shownStart) / rate;
+  }
+  int shownEntry() const { return shown; }
+
+  static constexpr int kMaxOut = 128;
+  static constexpr uint64_t kStartFrames = 8192;
+
+private:
+  bool open(int slot, int index) {
+    auto s = std::make_unique<AdmStreamer>();
+    s->setRingSeconds(prefetchSeconds);
+    if (srcCache) s->useSrcCache(srcCache, cacheRate);
+    if (!s->openFolder(entries[index].folder)) return false;
+    s->start();
+    slots[slot] = std::move(s);
+    return true;
+  }
+
+  // opens the piece after the playing one into the free slot, closes the
+  // one the callback retired
+  void loaderLoop() {
+    int loaded = 0; // entry in the slot the callback plays or will play next
+    while (!quit.load(std::memory_order_relaxed)) {
+      const int r = retired.exchange(-1, std::memory_order_acquire);
+      if (r >= 0) slots[r].reset(); // joins its I/O thread
+      if (!nextReady.load(std::memory_order_acquire) && retired.load() < 0) {
+        int index = loaded + 1;
+        if (index >= size()) index = loop ? 0 : -1;
+        const int free = 1 - current;
+        if (index >= 0 && !slots[free]) {
+          if (open(free, index)) {
+            pendingEntry.store(index, std::memory_order_relaxed);
+            nextReady.store(true, std::memory_order_release);
+          }
+          // a piece that won't open is skipped
+          loaded = index;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  static void zero(float *const *out, int chans, int from, int to) {
+    for (int c = 0; c < chans; ++c)
+      for (int f = from; f < to; ++f) out[c][f] = 0.0f;
+  }
+
+  std::vector<Entry> entries;
+  bool loop = false;
+  float prefetchSeconds = 3.0f;
+  SrcCache *srcCache = nullptr;
+  int cacheRate = 0;
+  int channels = 0;
+  int blockMax = 0;
+  int64_t fadeFrames = 0;
+
+  // slots[current] plays, slots[1 - current] is the prefetched next piece
+  std::unique_ptr<AdmStreamer> slots[2];
+  std::atomic<int> current{0}; // written by the callback only
+  std::atomic<bool> nextReady{false};
+  std::atomic<int> pendingEntry{0};
+  std::atomic<int> retired{-1};
+  std::thread loader;
+  std::atomic<bool> quit{false};
+
+  // audio thread
+  std::vector<float> incoming;
+  bool nextStarted = false;
+  std::atomic<int64_t> programFrame{0};
+  SpscRing<Switch> switches;
+
+  // picture
+  Switch pending;
+  bool havePending = false;
+  int shown = 0;
+  int64_t shownStart = 0;
+};
@@ -0,0 +1,481 @@
+#pragma once
+
+// disk streaming for the pre-decoded 54.1 ADM stems.
+// an I/O thread reads the wav (or .alc) files forward in big blocks (kernel
+// read-ahead on linux) and pushes interleaved frames into a lock-free SPSC
+// ring. the audio callback only ever copies out of the ring, so startup is
+// just opening headers, and memory is the ring size no matter how long the piece is.
+//
+//   AdmStreamer stream;
+//   stream.openFolder("../adm-allo-player/sourceAudio/piece/");
+//   stream.start();
+//   ... onSound: stream.onSound(io);
+//
+// a folder is either one multichannel wav or a set of mono / multichannel
+// stems, which are stacked into channels in filename order (natural sort, so
+// "src_2" comes before "src_10"). every stem has to open and share one
+// rate, otherwise open fails rather than play a shifted layout.
+//
+// .alc files (losslessAudio.hpp) are about half the size; the I/O thread
+// decodes them block by block ahead of the ring, across files when there are
+// several and across a file's channels when there is one, so the callback
+// never sees compressed data. make them with bin/alcEncode (tools/), at the
+// device rate (--rate): they don't go through the SrcCache. a stem with both
+// a .wav and a .alc plays the .alc. nothing else here reads .alc: al::
+// SoundFile (SoundObject, adm_player) needs the wavs.
+//
+// with a SrcCache, open never waits for a conversion: stems already
+// converted are played from the cache, otherwise the originals play through
+// the varispeed resampler at fileRate / deviceRate while the cache converts
+// them in the background for the next open.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "losslessAudio.hpp"
+#include "parallelFor.hpp"
+#include "spscRing.hpp"
+#include "srcCache.hpp"
+#include "varispeed.hpp"
+
+class AdmStreamer {
+public:
+  struct Stats {
+    uint64_t callbacks = 0;
+    uint64_t underruns = 0;      // callbacks that came up short
+    uint64_t underrunFrames = 0; // frames replaced by silence
+    std::size_t minFillFrames = 0; // lowest ring level seen by the callback
+  };
+
+  AdmStreamer() = default;
+  ~AdmStreamer() { stop(); }
+  AdmStreamer(const AdmStreamer &) = delete;
+  AdmStreamer &operator=(const AdmStreamer &) = delete;
+
+  // ring length and read size. set before open
+  void setRingSeconds(float s) { ringSeconds = s > 0.1f ? s : 0.1f; }
+  void setBlockFrames(std::size_t f) { blockFrames = f > 64 ? f : 64; }
+  // route playback through the resampler so setSpeed() works. costs the
+  // kernel's half width (16 frames) of latency even at speed 1
+  void enableVarispeed(bool on, int maxCallbackFrames = 2048) {
+    useVarispeed = on;
+    varispeedBlock = maxCallbackFrames;
+  }
+  // stems not at deviceRate are converted through the cache in the
+  // background, and resampled live until the conversion is there
+  void useSrcCache(SrcCache *cache, int deviceRate) {
+    srcCache = cache;
+    cacheRate = deviceRate;
+  }
+  // any thread. ramps smoothly on the audio thread
+  void setSpeed(float s) { speedTarget.store(s, std::memory_order_relaxed); }
+
+  bool openFolder(const std::string &folder) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(folder, ec)) {
+      if (!entry.is_regular_file()) continue;
+      std::string ext = entry.path().extension().string();
+      std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+      if (ext == ".wav" || ext == ".alc") files.push_back(entry.path().string());
+    }
+    if (ec || files.empty()) {
+      std::cout << "AdmStreamer: no wav or alc files in " << folder << std::endl;
+      return false;
+    }
+    // alcEncode leaves the wavs in place: a stem in both takes the .alc
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [&](const std::string &f) {
+                                 return !isCompressed(f) &&
+                                        std::find(files.begin(), files.end(),
+                                                  withAlc(f)) != files.end();
+                               }),
+                files.end());
+    std::sort(files.begin(), files.end(), naturalLess);
+    return openFiles(files);
+  }
+
+  // true when folder has .alc stems, which only this streamer can play
+  static bool hasCompressed(const std::string &folder) {
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(folder, ec))
+      if (entry.is_regular_file() && isCompressed(entry.path().string()))
+        return true;
+    return false;
+  }
+
+  bool openFiles(const std::vector<std::string> &paths) {
+    stop();
+    readers.clear();
+    totalChannels = 0;
+    totalFrames = 0;
+    rate = 0;
+    std::vector<std::string> resolved = paths;
+    if (srcCache) {
+      // the cache only if every stem is in it, so they share one rate
+      bool allReady = true;
+      std::vector<std::string> cached = paths;
+      for (auto &p : cached) {
+        if (isCompressed(p)) continue;
+        srcCache->request(p, cacheRate);
+        p = srcCache->ready(p, cacheRate);
+        allReady = allReady && !p.empty();
+      }
+      if (allReady) resolved = cached;
+    }
+    anyCompressed = false;
+    // every stem or none: a missing one would shift the later stems onto
+    // the wrong speakers, and one resampler can't play two rates
+    for (const auto &p : resolved) {
+      StemReader r;
+      if (!r.open(p)) {
+        std::cout << "AdmStreamer: couldnt open " << p << std::endl;
+        return failOpen();
+      }
+      if (rate == 0) rate = r.sampleRate;
+      if (r.sampleRate != rate) {
+        std::cout << "AdmStreamer: " << p << " is " << r.sampleRate
+                  << " Hz, expected " << rate;
+        if (srcCache)
+          std::cout << ", open again once the SrcCache has converted it";
+        std::cout << std::endl;
+        return failOpen();
+      }
+      totalChannels += r.channels;
+      totalFrames = std::max(totalFrames, r.frames);
+      anyCompressed = anyCompressed || r.compressed();
+      readers.push_back(std::move(r));
+    }
+    if (readers.empty()) return failOpen();
+    // one level of parallel decode: across files, or within the only file
+    const bool acrossFiles = anyCompressed && readers.size() > 1;
+    for (auto &r : readers)
+      r.setWorkers(acrossFiles ? nullptr : &WorkerPool::shared());
+
+    const std::size_t ringFrames =
+        static_cast<std::size_t>(ringSeconds * rate) + blockFrames;
+    ring.reset(ringFrames * totalChannels);
+    scratch.assign(blockFrames * totalChannels, 0.0f);
+    fileScratch.resize(readers.size());
+    fileGot.assign(readers.size(), 0);
+    for (std::size_t i = 0; i < readers.size(); ++i)
+      fileScratch[i].assign(blockFrames * readers[i].channels, 0.0f);
+    playhead = 0;
+    producerFrame = 0;
+    discardBefore.store(0);
+    mediaFrame.store(0.0);
+    seenGeneration = seekGeneration.load();
+    rateRatio = cacheRate > 0 && rate != cacheRate
+                    ? static_cast<float>(rate) / cacheRate
+                    : 1.0f;
+    resampling = useVarispeed || rateRatio != 1.0f;
+    if (rateRatio != 1.0f)
+      std::cout << "AdmStreamer: playing " << rate << " Hz stems at "
+                << cacheRate << " Hz through the resampler until the SrcCache "
+                << "has them" << std::endl;
+    if (resampling) {
+      varispeed.prepare(totalChannels, varispeedBlock, rate);
+      varispeed.setSpeed(speedTarget.load() * rateRatio);
+      varispeed.reset();
+    }
+    endOfStream.store(false);
+    resetStats();
+    std::cout << "AdmStreamer: " << readers.size() << " files, "
+              << totalChannels << " channels, " << totalFrames / double(rate)
+              << " s, ring " << ring.capacity() * sizeof(float) / 1e6 << " MB"
+              << std::endl;
+    return true;
+  }
+
+  void start() {
+    if (running.load() || readers.empty()) return;
+    running.store(true);
+    ioThread = std::thread([this] { ioLoop(); });
+  }
+
+  void stop() {
+    running.store(false);
+    if (ioThread.joinable()) ioThread.join();
+  }
+
+  // any thread. the I/O thread repositions and the callback drops whatever
+  // was queued from the old position
+  void seek(uint64_t frame) {
+    seekTarget.store(frame);
+    seekRequested.store(true, std::memory_order_release);
+  }
+  void seekSeconds(double s) {
+    seek(static_cast<uint64_t>(std::max(0.0, s) * rate));
+  }
+
+  int channels() const { return totalChannels; }
+  int sampleRate() const { return rate; }
+  uint64_t lengthFrames() const { return totalFrames; }
+  // file position of the audio the device was last handed, fractional when
+  // playing through the resampler
+  double positionFrames() const { return mediaFrame.load(std::memory_order_relaxed); }
+  double positionSeconds() const { return rate ? positionFrames() / rate : 0.0; }
+  // frames read ahead and waiting in the ring
+  std::size_t bufferedFrames() const {
+    return totalChannels ? ring.readAvailable() / totalChannels : 0;
+  }
+  // device frames until the last file frame is played
+  int64_t outputFramesLeft() const {
+    const double left = static_cast<double>(totalFrames) - positionFrames();
+    return static_cast<int64_t>(std::max(0.0, left) / rateRatio);
+  }
+  bool finished() const {
+    return endOfStream.load() && ring.readAvailable() == 0;
+  }
+
+  // non-real-time readers only. the counters are written by the callback
+  Stats stats() const {
+    Stats s;
+    s.callbacks = callbacks.load(std::memory_order_relaxed);
+    s.underruns = underruns.load(std::memory_order_relaxed);
+    s.underrunFrames = underrunFrames.load(std::memory_order_relaxed);
+    // 0 until the callback has seen the ring
+    s.minFillFrames = s.callbacks ? minFill.load(std::memory_order_relaxed) : 0;
+    return s;
+  }
+  void resetStats() {
+    callbacks.store(0);
+    underruns.store(0);
+    underrunFrames.store(0);
+    minFill.store(SIZE_MAX);
+  }
+
+  // audio thread: non-interleaved outputs, extra channels on either side are
+  // dropped / zeroed. never blocks
+  void read(float *const *out, int outChannels, int frames) {
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    const int ch = totalChannels;
+    if (ch == 0) {
+      zero(out, outChannels, 0, frames);
+      return;
+    }
+    // drop stale frames from before a seek
+    const uint32_t gen = seekGeneration.load(std::memory_order_acquire);
+    if (gen != seenGeneration) {
+      seenGeneration = gen;
+      ring.skipTo(discardBefore.load(std::memory_order_relaxed));
+      playhead = discardFrame.load(std::memory_order_relaxed);
+      if (resampling) varispeed.reset();
+    }
+    minFill.store(std::min(minFill.load(std::memory_order_relaxed),
+                           ring.readAvailable() / ch),
+                  std::memory_order_relaxed);
+
+    if (resampling) {
+      varispeed.setSpeed(speedTarget.load(std::memory_order_relaxed) *
+                         rateRatio);
+      varispeed.render(out, outChannels, frames,
+                       [this](float *dst, int stride, int n) {
+                         return pull(dst, stride, n);
+                       });
+      mediaFrame.store(playhead - varispeed.pendingFrames(),
+                       std::memory_order_relaxed);
+      return;
+    }
+
+    const std::size_t availFrames = ring.readAvailable() / ch;
+    const int n = static_cast<int>(
+        std::min<std::size_t>(availFrames, static_cast<std::size_t>(frames)));
+    const float *a, *b;
+    std::size_t na, nb;
+    ring.readRegions(a, na, b, nb);
+    const int used = std::min(outChannels, ch);
+    // the wrap point can land mid-frame (capacity is a power of 2, ch isn't)
+    for (int c = 0; c < used; ++c) {
+      float *o = out[c];
+      std::size_t idx = c;
+      for (int f = 0; f < n; ++f, idx += ch)
+        o[f] = idx < na ? a[idx] : b[idx - na];
+    }
+    ring.consume(static_cast<std::size_t>(n) * ch);
+    zero(out, used, n, frames);
+    if (outChannels > used) zero(out + used, outChannels - used, 0, frames);
+    playhead += n;
+    mediaFrame.store(static_cast<double>(playhead), std::memory_order_relaxed);
+    countShortfall(frames, n);
+  }
+
+  template <class IO> void onSound(IO &io) {
+    const int outs = std::min<int>(io.channelsOut(), kMaxOut);
+    float *outPtrs[kMaxOut];
+    for (int c = 0; c < outs; ++c) outPtrs[c] = io.outBuffer(c);
+    read(outPtrs, outs, io.framesPerBuffer());
+  }
+
+  static constexpr int kMaxOut = 128;
+
+private:
+  // resampler input: n interleaved frames at dst, channel stride `stride`
+  int pull(float *dst, int stride, int n) {
+    const int ch = totalChannels;
+    const int got = static_cast<int>(
+        std::min<std::size_t>(ring.readAvailable() / ch, static_cast<std::size_t>(n)));
+    const float *a, *b;
+    std::size_t na, nb;
+    ring.readRegions(a, na, b, nb);
+    std::size_t idx = 0;
+    for (int f = 0; f < got; ++f, dst += stride)
+      for (int c = 0; c < ch; ++c, ++idx) dst[c] = idx < na ? a[idx] : b[idx - na];
+    ring.consume(static_cast<std::size_t>(got) * ch);
+    playhead += got;
+    countShortfall(n, got);
+    return got;
+  }
+
+  void countShortfall(int wanted, int got) {
+    if (got < wanted && !endOfStream.load(std::memory_order_relaxed)) {
+      underruns.fetch_add(1, std::memory_order_relaxed);
+      underrunFrames.fetch_add(wanted - got, std::memory_order_relaxed);
+    }
+  }
+
+  static void zero(float *const *out, int chans, int from, int to) {
+    for (int c = 0; c < chans; ++c)
+      for (int f = from; f < to; ++f) out[c][f] = 0.0f;
+  }
+
+  bool failOpen() {
+    readers.clear();
+    totalChannels = 0;
+    totalFrames = 0;
+    rate = 0;
+    return false;
+  }
+
+  static bool isCompressed(const std::string &path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".alc";
+  }
+  static std::string withAlc(const std::string &path) {
+    return std::filesystem::path(path).replace_extension(".alc").string();
+  }
+
+  void ioLoop() {
+    while (running.load()) {
+      if (seekRequested.exchange(false, std::memory_order_acquire)) {
+        const uint64_t target = std::min(seekTarget.load(), totalFrames);
+        for (auto &r : readers) r.seek(target);
+        producerFrame = target;
+        endOfStream.store(false);
+        // everything already in the ring is from the old position
+        discardFrame.store(target, std::memory_order_relaxed);
+        discardBefore.store(ring.writePosition(), std::memory_order_relaxed);
+        seekGeneration.fetch_add(1, std::memory_order_release);
+      }
+      if (endOfStream.load() ||
+          ring.writeAvailable() < blockFrames * totalChannels) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        continue;
+      }
+      fillBlock();
+    }
+  }
+
+  // read one block from every file and interleave it into the ring
+  void fillBlock() {
+    const int ch = totalChannels;
+    std::size_t frames = blockFrames;
+    if (producerFrame + frames > totalFrames)
+      frames = static_cast<std::size_t>(totalFrames - producerFrame);
+    if (frames == 0) {
+      endOfStream.store(true);
+      return;
+    }
+    auto readFiles = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i)
+        fileGot[i] = readers[i].read(fileScratch[i].data(), frames);
+    };
+    // plain wavs stay sequential, that's what the disk read-ahead likes
+    if (anyCompressed && readers.size() > 1)
+      WorkerPool::shared().parallelFor(readers.size(), 1, readFiles);
+    else
+      readFiles(0, readers.size());
+    int base = 0;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+      const float *in = fileScratch[i].data();
+      const std::size_t got = fileGot[i];
+      const int rc = readers[i].channels;
+      for (std::size_t f = 0; f < frames; ++f)
+        for (int c = 0; c < rc; ++c)
+          scratch[f * ch + base + c] = f < got ? in[f * rc + c] : 0.0f;
+      base += rc;
+    }
+    ring.write(scratch.data(), frames * ch);
+    producerFrame += frames;
+  }
+
+  // "a2" < "a10"
+  static bool naturalLess(const std::string &a, const std::string &b) {
+    std::size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+      if (std::isdigit(static_cast<unsigned char>(a[i])) &&
+          std::isdigit(static_cast<unsigned char>(b[j]))) {
+        std::size_t ie = i, je = j;
+        while (ie < a.size() && std::isdigit(static_cast<unsigned char>(a[ie]))) ++ie;
+        while (je < b.size() && std::isdigit(static_cast<unsigned char>(b[je]))) ++je;
+        unsigned long long na = std::stoull(a.substr(i, ie - i));
+        unsigned long long nb = std::stoull(b.substr(j, je - j));
+        if (na != nb) return na < nb;
+        i = ie;
+        j = je;
+      } else {
+        if (a[i] != b[j]) return a[i] < b[j];
+        ++i;
+        ++j;
+      }
+    }
+    return a.size() - i < b.size() - j;
+  }
+
+  std::vector<StemReader> readers;
+  bool anyCompressed = false;
+  SrcCache *srcCache = nullptr;
+  int cacheRate = 0;
+  int totalChannels = 0;
+  int rate = 0;
+  uint64_t totalFrames = 0;
+  float ringSeconds = 2.0f;
+  std::size_t blockFrames = 8192;
+
+  SpscRing<float> ring;
+  std::vector<float> scratch;
+  std::vector<std::vector<float>> fileScratch; // one per file, I/O thread
+  std::vector<std::size_t> fileGot;
+  std::thread ioThread;
+  std::atomic<bool> running{false};
+
+  // seek handshake: control -> I/O thread -> callback
+  std::atomic<bool> seekRequested{false};
+  std::atomic<uint64_t> seekTarget{0};
+  std::atomic<uint64_t> discardBefore{0}; // ring position of the new data
+  std::atomic<uint64_t> discardFrame{0};  // file frame at that position
+  std::atomic<uint32_t> seekGeneration{0};
+  uint32_t seenGeneration = 0; // callback only
+  std::atomic<bool> endOfStream{false};
+  uint64_t producerFrame = 0; // I/O thread only
+
+  uint64_t playhead = 0; // frames taken from the ring, callback only
+  std::atomic<double> mediaFrame{0.0};
+  bool useVarispeed = false;
+  bool resampling = false; // varispeed, or files not at cacheRate
+  float rateRatio = 1.0f;  // file rate / device rate
+  int varispeedBlock = 2048;
+  Varispeed varispeed;
+  std::atomic<float> speedTarget{1.0f};
+  std::atomic<uint64_t> callbacks{0}, underruns{0}, underrunFrames{0};
+  std::atomic<std::size_t> minFill{SIZE_MAX};
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+// SoA agent engine for swarms of Nav-like agents (blobs, jellies).
+// position and orientation live directly in a SwarmState block inside the
+// distributed Common struct, so stepping on the primary *is* serializing:
+// no per-field copies into blobPosX / blobQuatW, and replicas read the same
+// arrays. velocity and per-agent phases stay local to the engine.
+//
+// one step() does per agent, in simd lanes and across the worker pool:
+//   - steer home: past `boundary` from `home`, rotate a fraction `homeRate`
+//     toward it (Nav::faceToward)
+//   - roll around the forward axis by turn + wobble (Nav::turnF)
+//   - move forward at `speed` units per second (Nav::moveF + step)
+//
+// forward is -z like al::Nav.
+
+#include <cmath>
+#include <cstddef>
+
+#include "parallelFor.hpp"
+#include "simdUtility.hpp"
+
+// fixed size, padded, trivially copyable so it can sit in Common
+template <std::size_t N> struct SwarmState {
+  static constexpr std::size_t capacity = simd::padded(N);
+  alignas(64) float posX[capacity];
+  alignas(64) float posY[capacity];
+  alignas(64) float posZ[capacity];
+  alignas(64) float quatW[capacity];
+  alignas(64) float quatX[capacity];
+  alignas(64) float quatY[capacity];
+  alignas(64) float quatZ[capacity];
+};
+
+struct SwarmParams {
+  float speed = 1.0f;
+  float boundary = 10.0f;
+  float homeRate = 0.01f;
+  float homeX = 0.0f, homeY = 0.0f, homeZ = 0.0f;
+  float turn = 0.0f;         // radians per step
+  float wobbleAmount = 0.0f; // radians per step
+  float wobbleRate = 0.0f;   // radians per second of (time + agent phase)
+  float time = 0.0f;         // drives the wobble
+  // optional per-agent steering force (FlockForces), padded arrays.
+  // each step turns steerRate of the way toward forward + force
+  const float *steerX = nullptr, *steerY = nullptr, *steerZ = nullptr;
+  float steerRate = 0.0f;
+};
+
+class AgentSwarm {
+public:
+  static constexpr std::size_t kGrain = 4096;
+
+  // point the engine at a state block. cheap, call it every frame in case
+  // the app swapped state buffers
+  template <std::size_t N> void bind(SwarmState<N> &s, std::size_t n = N) {
+    px = s.posX;
+    py = s.posY;
+    pz = s.posZ;
+    qw = s.quatW;
+    qx = s.quatX;
+    qy = s.quatY;
+    qz = s.quatZ;
+    capacity = SwarmState<N>::capacity;
+    setCount(n < N ? n : N);
+  }
+
+  std::size_t size() const { return count; }
+
+  // fills the padding past count with identity agents at the origin so the
+  // simd tail never normalizes a zero quaternion
+  void setCount(std::size_t n) {
+    count = n;
+    velX.resize(capacity);
+    velY.resize(capacity);
+    velZ.resize(capacity);
+    phase.resize(capacity);
+    for (std::size_t i = n; i < capacity; ++i) {
+      px[i] = py[i] = pz[i] = 0.0f;
+      qw[i] = 1.0f;
+      qx[i] = qy[i] = qz[i] = 0.0f;
+    }
+  }
+
+  void setPhase(std::size_t i, float p) { phase[i] = p; }
+
+  void setAgent(std::size_t i, float x, float y, float z, float w, float a,
+                float b, float c) {
+    px[i] = x;
+    py[i] = y;
+    pz[i] = z;
+    float m = std::sqrt(w * w + a * a + b * b + c * c);
+    if (m < 1e-12f) {
+      w = 1.0f;
+      m = 1.0f;
+    }
+    qw[i] = w / m;
+    qx[i] = a / m;
+    qy[i] = b / m;
+    qz[i] = c / m;
+  }
+
+  // per-agent world space velocity from the last step
+  const float *velocityX() const { return velX.data; }
+  const float *velocityY() const { return velY.data; }
+  const float *velocityZ() const { return velZ.data; }
+  const float *positionX() const { return px; }
+  const float *positionY() const { return py; }
+  const float *positionZ() const { return pz; }
+
+  void step(float dt, const SwarmParams &p) {
+    if (!px || count == 0) return;
+    const std::size_t blocks = simd::padded(count) / simd::kPad;
+    parallelFor(blocks, kGrain / simd::kPad,
+                [&](std::size_t b, std::size_t e) {
+                  stepRange(b * simd::kPad, e * simd::kPad, dt, p);
+                });
+  }
+
+private:
+  // rotate q a fraction k of the way from its forward (-z) toward the
+  // direction d (any length): shortest arc quaternion, nlerp'd with identity
+  static void turnToward(simd::floatv &w, simd::floatv &a, simd::floatv &b,
+                         simd::floatv &c, simd::floatv dx, simd::floatv dy,
+                         simd::floatv dz, simd::floatv k) {
+    using simd::floatv;
+    const floatv one(1.0f), two(2.0f), tiny(1e-12f);
+    floatv fx = -two * (a * c + w * b);
+    floatv fy = -two * (b * c - w * a);
+    floatv fz = two * (a * a + b * b) - one;
+    floatv inv = one / simd::sqrt(simd::max(
+                           simd::fmadd(dx, dx, simd::fmadd(dy, dy, dz * dz)),
+                           tiny));
+    dx *= inv;
+    dy *= inv;
+    dz *= inv;
+    // nlerp(identity, r, k), normalized below
+    floatv rw = simd::fmadd(one + fx * dx + fy * dy + fz * dz, k, one - k);
+    floatv rx = (fy * dz - fz * dy) * k;
+    floatv ry = (fz * dx - fx * dz) * k;
+    floatv rz = (fx * dy - fy * dx) * k;
+    floatv m = one / simd::sqrt(simd::max(
+                         simd::fmadd(rw, rw, simd::fmadd(rx, rx,
+                                     simd::fmadd(ry, ry, rz * rz))),
+                         tiny));
+    rw *= m;
+    rx *= m;
+    ry *= m;
+    rz *= m;
+    // q = r * q (world space rotation)
+    floatv nw = rw * w - rx * a - ry * b - rz * c;
+    floatv na = rw * a + rx * w + ry * c - rz * b;
+    floatv nb = rw * b - rx * c + ry * w + rz * a;
+    floatv nc = rw * c + rx * b - ry * a + rz * w;
+    w = nw;
+    a = na;
+    b = nb;
+    c = nc;
+  }
+
+  void stepRange(std::size_t begin, std::size_t end, float dt,
+                 const SwarmParams &p) {
+    using simd::floatv;
+    const floatv one(1.0f), two(2.0f), half(0.5f), zero(0.0f);
+    const floatv bound2(p.boundary * p.boundary), rate(p.homeRate);
+    const floatv hx(p.homeX), hy(p.homeY), hz(p.homeZ);
+    const floatv move(p.speed * dt), turn(p.turn), wobble(p.wobbleAmount);
+    const floatv wobbleRate(p.wobbleRate), time(p.time);
+    const floatv steerRate(p.steerRate);
+
+    for (std::size_t i = begin; i < end; i += simd::width) {
+      floatv x = floatv::load(px + i), y = floatv::load(py + i),
+             z = floatv::load(pz + i);
+      floatv w = floatv::load(qw + i), a = floatv::load(qx + i),
+             b = floatv::load(qy + i), c = floatv::load(qz + i);
+
+      floatv fx, fy, fz;
+      // steer home, only agents outside the boundary
+      floatv dx = hx - x, dy = hy - y, dz = hz - z;
+      floatv d2 = simd::fmadd(dx, dx, simd::fmadd(dy, dy, dz * dz));
+      floatv k = simd::select(simd::greater(d2, bound2), rate, zero);
+      turnToward(w, a, b, c, dx, dy, dz, k);
+
+      // steer along an external force (flocking), toward forward + force
+      if (p.steerX) {
+        fx = -two * (a * c + w * b);
+        fy = -two * (b * c - w * a);
+        fz = two * (a * a + b * b) - one;
+        turnToward(w, a, b, c, fx + floatv::loadu(p.steerX + i),
+                   fy + floatv::loadu(p.steerY + i),
+                   fz + floatv::loadu(p.steerZ + i), steerRate);
+      }
+      floatv nw = w, na = a, nb = b, nc = c;
+
+      // roll around local forward (-z): q = q * (cos(h), 0, 0, -sin(h))
+      floatv ph = floatv::load(phase.data + i);
+      floatv angle = simd::fmadd(wobble,
+                                 simd::sin(wobbleRate * (time + ph)), turn);
+      floatv hs = simd::sin(angle * half), hc = simd::cos(angle * half);
+      w = nw * hc + nc * hs;
+      a = na * hc - nb * hs;
+      b = nb * hc + na * hs;
+      c = nc * hc - nw * hs;
+
+      floatv m = one / simd::sqrt(simd::fmadd(
+                           w, w, simd::fmadd(a, a, simd::fmadd(b, b, c * c))));
+      w *= m;
+      a *= m;
+      b *= m;
+      c *= m;
+
+      fx = -two * (a * c + w * b);
+      fy = -two * (b * c - w * a);
+      fz = two * (a * a + b * b) - one;
+      floatv vx = fx * move, vy = fy * move, vz = fz * move;
+      (x + vx).store(px + i);
+      (y + vy).store(py + i);
+      (z + vz).store(pz + i);
+      w.store(qw + i);
+      a.store(qx + i);
+      b.store(qy + i);
+      c.store(qz + i);
+      const floatv invDt(dt > 0.0f ? 1.0f / dt : 0.0f);
+      (vx * invDt).store(velX.data + i);
+      (vy * invDt).store(velY.data + i);
+      (vz * invDt).store(velZ.data + i);
+    }
+  }
+
+  float *px = nullptr, *py = nullptr, *pz = nullptr;
+  float *qw = nullptr, *qx = nullptr, *qy = nullptr, *qz = nullptr;
+  std::size_t count = 0, capacity = 0;
+  simd::alignedBuffer velX, velY, velZ, phase;
+};
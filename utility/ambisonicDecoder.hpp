@@ -0,0 +1,266 @@
+#pragma once
+
+// higher order ambisonics (1st-5th and up to sh::kMaxOrder) for the sphere,
+// with the decode run as a matrix multiply over the whole block.
+//
+// sources are encoded into a B-format block (ACN / N3D, one row per SH
+// channel). the decoder is precomputed once per layout as a speakers x
+// channels matrix, so decoding is out = D * B: a small GEMM, here blocked as
+// 4 speakers x 2 vectors of frames per register tile, over frame chunks that
+// keep the B rows in L1. per sample that is channels x speakers fmas, but at
+// 8 (avx2) or 4 (sse2 / neon) samples an instruction and with every B load
+// reused across four speakers.
+//
+//   AmbisonicDecoder ambi;
+//   ambi.setSpeakers(speakerLayout);
+//   ambi.setOrder(3);
+//   ambi.prepare(16, io.framesPerBuffer());
+//   onSound: ambi.clear(); ambi.encode(i, buffer, x, y, z); ...; ambi.decode(io);
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "simdUtility.hpp"
+#include "sphericalHarmonics.hpp"
+
+class AmbisonicDecoder {
+public:
+  // any container of speakers with vec() and deviceChannel, like
+  // al::Speakers. not real-time safe
+  template <class Speakers> void setSpeakers(const Speakers &speakers) {
+    spkX.clear();
+    spkY.clear();
+    spkZ.clear();
+    spkChannel.clear();
+    for (const auto &s : speakers) {
+      const auto v = s.vec();
+      spkX.push_back(static_cast<float>(v[0]));
+      spkY.push_back(static_cast<float>(v[1]));
+      spkZ.push_back(static_cast<float>(v[2]));
+      spkChannel.push_back(static_cast<int>(s.deviceChannel));
+    }
+    rebuild();
+  }
+
+  // not real-time safe. maxRe narrows the lobe, which sounds better than the
+  // plain sampling decoder on a dense rig like the sphere
+  void setOrder(int ambisonicOrder, bool maxRe = true) {
+    order = std::clamp(ambisonicOrder, 1, sh::kMaxOrder);
+    useMaxRe = maxRe;
+    rebuild();
+  }
+
+  // not real-time safe
+  void prepare(int maxSourceCount, int maxFrames) {
+    blockMax = maxFrames;
+    stride = simd::padded(static_cast<std::size_t>(maxFrames));
+    bformat.resize(stride * sh::channelsForOrder(sh::kMaxOrder));
+    bformat.zero();
+    ramp.resize(maxFrames);
+    coefNow.assign(static_cast<std::size_t>(maxSourceCount) *
+                       sh::channelsForOrder(sh::kMaxOrder),
+                   0.0f);
+    started.assign(maxSourceCount, 0);
+    maxSources = maxSourceCount;
+  }
+
+  int channels() const { return sh::channelsForOrder(order); }
+  int speakers() const { return static_cast<int>(spkChannel.size()); }
+  int getOrder() const { return order; }
+  // row-major speakers() x channels()
+  const float *matrix() const { return decodeMatrix.data(); }
+  // B-format row for SH channel c, maxFrames long, 64-byte aligned
+  float *channel(int c) { return bformat.data + stride * c; }
+
+  // audio thread, start of each block
+  void clear() {
+    std::fill(bformat.data, bformat.data + stride * channels(), 0.0f);
+  }
+
+  // audio thread: adds a mono source into the B-format block. coefficients
+  // ramp per sample from the source's last direction, so motion is smooth
+  void encode(int i, const float *in, int frames, float x, float y, float z,
+              float gain = 1.0f) {
+    if (i < 0 || i >= maxSources) return;
+    frames = std::min(frames, blockMax);
+    const int nsh = channels();
+    float target[sh::channelsForOrder(sh::kMaxOrder)];
+    sh::evaluate(order, x, y, z, target);
+    float *now = &coefNow[static_cast<std::size_t>(i) *
+                          sh::channelsForOrder(sh::kMaxOrder)];
+    for (int c = 0; c < nsh; ++c) target[c] *= gain;
+    if (!started[i]) {
+      std::copy(target, target + nsh, now);
+      started[i] = 1;
+    }
+    const float inv = 1.0f / frames;
+    for (int f = 0; f < frames; ++f) ramp.data[f] = (f + 1) * inv;
+    const int vecFrames = frames / simd::width * simd::width;
+    for (int c = 0; c < nsh; ++c) {
+      const float c0 = now[c], dc = target[c] - c0;
+      float *b = channel(c);
+      if (std::fabs(c0) < kSilent && std::fabs(target[c]) < kSilent) continue;
+      const simd::floatv vc0(c0), vdc(dc);
+      int f = 0;
+      for (; f < vecFrames; f += simd::width) {
+        const simd::floatv g =
+            simd::fmadd(vdc, simd::floatv::load(ramp.data + f), vc0);
+        simd::fmadd(g, simd::floatv::loadu(in + f), simd::floatv::load(b + f))
+            .store(b + f);
+      }
+      for (; f < frames; ++f) b[f] += (c0 + dc * ramp.data[f]) * in[f];
+      now[c] = target[c];
+    }
+  }
+  void releaseSource(int i) {
+    if (i >= 0 && i < maxSources) started[i] = 0;
+  }
+
+  // audio thread: adds the decoded block into io's speaker channels
+  template <class IO> void decode(IO &io) {
+    const int n = std::min(speakers(), kMaxSpeakers);
+    float *outs[kMaxSpeakers];
+    for (int s = 0; s < n; ++s) outs[s] = io.outBuffer(spkChannel[s]);
+    decode(outs, io.framesPerBuffer());
+  }
+
+  // outs[s] is speaker s (layout order). out += D * B
+  void decode(float *const *outs, int frames) {
+    frames = std::min(frames, blockMax);
+    const int n = std::min(speakers(), kMaxSpeakers);
+    const int nsh = channels();
+    constexpr int W = simd::width;
+    constexpr int kRows = 4;
+    for (int f0 = 0; f0 < frames; f0 += kChunk) {
+      const int f1 = std::min(frames, f0 + kChunk);
+      const int vecEnd = f0 + (f1 - f0) / (2 * W) * (2 * W);
+      int s = 0;
+      for (; s + kRows <= n; s += kRows) {
+        const float *d0 = &decodeMatrix[static_cast<std::size_t>(s) * nsh];
+        const float *d1 = d0 + nsh, *d2 = d1 + nsh, *d3 = d2 + nsh;
+        float *o0 = outs[s], *o1 = outs[s + 1], *o2 = outs[s + 2],
+              *o3 = outs[s + 3];
+        int f = f0;
+        for (; f < vecEnd; f += 2 * W) {
+          simd::floatv a00(0.0f), a01(0.0f), a10(0.0f), a11(0.0f), a20(0.0f),
+              a21(0.0f), a30(0.0f), a31(0.0f);
+          for (int c = 0; c < nsh; ++c) {
+            const float *b = bformat.data + stride * c + f;
+            const simd::floatv b0 = simd::floatv::load(b);
+            const simd::floatv b1 = simd::floatv::load(b + W);
+            const simd::floatv g0(d0[c]), g1(d1[c]), g2(d2[c]), g3(d3[c]);
+            a00 = simd::fmadd(g0, b0, a00);
+            a01 = simd::fmadd(g0, b1, a01);
+            a10 = simd::fmadd(g1, b0, a10);
+            a11 = simd::fmadd(g1, b1, a11);
+            a20 = simd::fmadd(g2, b0, a20);
+            a21 = simd::fmadd(g2, b1, a21);
+            a30 = simd::fmadd(g3, b0, a30);
+            a31 = simd::fmadd(g3, b1, a31);
+          }
+          (simd::floatv::loadu(o0 + f) + a00).storeu(o0 + f);
+          (simd::floatv::loadu(o0 + f + W) + a01).storeu(o0 + f + W);
+          (simd::floatv::loadu(o1 + f) + a10).storeu(o1 + f);
+          (simd::floatv::loadu(o1 + f + W) + a11).storeu(o1 + f + W);
+          (simd::floatv::loadu(o2 + f) + a20).storeu(o2 + f);
+          (simd::floatv::loadu(o2 + f + W) + a21).storeu(o2 + f + W);
+          (simd::floatv::loadu(o3 + f) + a30).storeu(o3 + f);
+          (simd::floatv::loadu(o3 + f + W) + a31).storeu(o3 + f + W);
+        }
+        for (int r = 0; r < kRows; ++r)
+          decodeTail(outs[s + r], s + r, f, f1);
+      }
+      // leftover speakers, one row at a time
+      for (; s < n; ++s) decodeRow(outs[s], s, f0, f1);
+    }
+  }
+
+  static constexpr int kMaxSpeakers = 128;
+  static constexpr float kSilent = 1e-6f;
+  // frames per cache block: 36 channels x 128 frames is 18 kB of B-format
+  static constexpr int kChunk = 128;
+
+private:
+  void decodeRow(float *o, int s, int f0, int f1) {
+    const int nsh = channels();
+    const float *d = &decodeMatrix[static_cast<std::size_t>(s) * nsh];
+    constexpr int W = simd::width;
+    const int vecEnd = f0 + (f1 - f0) / W * W;
+    int f = f0;
+    for (; f < vecEnd; f += W) {
+      simd::floatv a(0.0f);
+      for (int c = 0; c < nsh; ++c)
+        a = simd::fmadd(simd::floatv(d[c]),
+                        simd::floatv::load(bformat.data + stride * c + f), a);
+      (simd::floatv::loadu(o + f) + a).storeu(o + f);
+    }
+    decodeTail(o, s, f, f1);
+  }
+
+  void decodeTail(float *o, int s, int f0, int f1) {
+    const int nsh = channels();
+    const float *d = &decodeMatrix[static_cast<std::size_t>(s) * nsh];
+    for (int f = f0; f < f1; ++f) {
+      float a = 0.0f;
+      for (int c = 0; c < nsh; ++c) a += d[c] * bformat.data[stride * c + f];
+      o[f] += a;
+    }
+  }
+
+  // sampling decoder: each speaker's row is its own SH vector (max-rE
+  // weighted), scaled so a source has about unit power on average
+  void rebuild() {
+    const int n = speakers();
+    const int nsh = channels();
+    decodeMatrix.assign(static_cast<std::size_t>(n) * nsh, 0.0f);
+    if (n == 0) return;
+    float w[sh::kMaxOrder + 1];
+    if (useMaxRe)
+      sh::maxReWeights(order, w);
+    else
+      std::fill(w, w + sh::kMaxOrder + 1, 1.0f);
+    for (int s = 0; s < n; ++s) {
+      float *row = &decodeMatrix[static_cast<std::size_t>(s) * nsh];
+      sh::evaluate(order, spkX[s], spkY[s], spkZ[s], row);
+      for (int l = 0; l <= order; ++l)
+        for (int m = -l; m <= l; ++m) row[l * l + l + m] *= w[l];
+    }
+    // average output power over a spread of directions (golden spiral)
+    constexpr int kProbes = 256;
+    float y[sh::channelsForOrder(sh::kMaxOrder)];
+    double power = 0.0;
+    for (int p = 0; p < kProbes; ++p) {
+      const double cy = 1.0 - 2.0 * (p + 0.5) / kProbes;
+      const double r = std::sqrt(1.0 - cy * cy);
+      const double a = p * 2.39996322972865332;
+      sh::evaluate(order, static_cast<float>(r * std::cos(a)),
+                   static_cast<float>(cy), static_cast<float>(r * std::sin(a)),
+                   y);
+      for (int s = 0; s < n; ++s) {
+        const float *row = &decodeMatrix[static_cast<std::size_t>(s) * nsh];
+        double v = 0.0;
+        for (int c = 0; c < nsh; ++c) v += double(row[c]) * y[c];
+        power += v * v;
+      }
+    }
+    const float scale = power > 0.0
+                            ? static_cast<float>(std::sqrt(kProbes / power))
+                            : 0.0f;
+    for (float &v : decodeMatrix) v *= scale;
+  }
+
+  int order = 3;
+  bool useMaxRe = true;
+  std::vector<float> spkX, spkY, spkZ;
+  std::vector<int> spkChannel;
+  std::vector<float> decodeMatrix;
+
+  int blockMax = 0;
+  int maxSources = 0;
+  std::size_t stride = 0;
+  simd::alignedBuffer bformat, ramp;
+  std::vector<float> coefNow;
+  std::vector<char> started;
+};
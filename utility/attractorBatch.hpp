@@ -0,0 +1,256 @@
+#pragma once
+
+// batch strange attractor integration over whole point clouds.
+// points are kept as SoA (VertexBlock) and integrated with simd lanes, split
+// across the worker pool for big clouds. systems: thomas, lorenz, aizawa,
+// halvorsen. integrators: euler and rk4.
+//
+// scene code can queue several steps + translations during a frame and apply
+// them in one pass with applyFrame(), instead of walking the mesh once per
+// processThomas() call:
+//   cloud.queueStep(0.00005f);
+//   cloud.queueTranslate(0, 20 * 0.00001, -5 * 0.00002);
+//   cloud.queueStep(0.00001f);
+//   cloud.applyFrame(attractorMesh);
+
+#include <cmath>
+#include <cstddef>
+
+#include "parallelFor.hpp"
+#include "simdUtility.hpp"
+#include "vfxBatch.hpp"
+
+enum class AttractorType { THOMAS, LORENZ, AIZAWA, HALVORSEN };
+enum class AttractorIntegrator { EULER, RK4 };
+
+struct AttractorParams {
+  float a = 0, b = 0, c = 0, d = 0, e = 0, f = 0;
+
+  // the usual published constants for each system
+  static AttractorParams defaults(AttractorType type) {
+    AttractorParams p;
+    switch (type) {
+    case AttractorType::THOMAS:
+      p.b = 0.208186f;
+      break;
+    case AttractorType::LORENZ:
+      p.a = 10.0f;        // sigma
+      p.b = 28.0f;        // rho
+      p.c = 8.0f / 3.0f;  // beta
+      break;
+    case AttractorType::AIZAWA:
+      p.a = 0.95f;
+      p.b = 0.7f;
+      p.c = 0.6f;
+      p.d = 3.5f;
+      p.e = 0.25f;
+      p.f = 0.1f;
+      break;
+    case AttractorType::HALVORSEN:
+      p.a = 1.89f;
+      break;
+    }
+    return p;
+  }
+};
+
+namespace attractor_detail {
+using simd::floatv;
+
+struct Thomas {
+  floatv b;
+  explicit Thomas(const AttractorParams &p) : b(p.b) {}
+  void operator()(floatv x, floatv y, floatv z, floatv &dx, floatv &dy,
+                  floatv &dz) const {
+    dx = simd::sin(y) - b * x;
+    dy = simd::sin(z) - b * y;
+    dz = simd::sin(x) - b * z;
+  }
+};
+
+struct Lorenz {
+  floatv sigma, rho, beta;
+  explicit Lorenz(const AttractorParams &p) : sigma(p.a), rho(p.b), beta(p.c) {}
+  void operator()(floatv x, floatv y, floatv z, floatv &dx, floatv &dy,
+                  floatv &dz) const {
+    dx = sigma * (y - x);
+    dy = x * (rho - z) - y;
+    dz = x * y - beta * z;
+  }
+};
+
+struct Aizawa {
+  floatv a, b, c, d, e, f;
+  explicit Aizawa(const AttractorParams &p)
+      : a(p.a), b(p.b), c(p.c), d(p.d), e(p.e), f(p.f) {}
+  void operator()(floatv x, floatv y, floatv z, floatv &dx, floatv &dy,
+                  floatv &dz) const {
+    floatv zb = z - b;
+    dx = zb * x - d * y;
+    dy = simd::fmadd(d, x, zb * y);
+    floatv r2 = simd::fmadd(x, x, y * y);
+    floatv z3 = z * z * z;
+    dz = c + a * z - z3 * floatv(1.0f / 3.0f) -
+         r2 * simd::fmadd(e, z, floatv(1.0f)) + f * z * x * x * x;
+  }
+};
+
+struct Halvorsen {
+  floatv a;
+  explicit Halvorsen(const AttractorParams &p) : a(p.a) {}
+  void operator()(floatv x, floatv y, floatv z, floatv &dx, floatv &dy,
+                  floatv &dz) const {
+    const floatv four(4.0f);
+    dx = -a * x - four * (y + z) - y * y;
+    dy = -a * y - four * (z + x) - z * z;
+    dz = -a * z - four * (x + y) - x * x;
+  }
+};
+
+// integrate [begin, end) for `steps` substeps of h, then translate
+template <class System, AttractorIntegrator I>
+void integrate(const System &sys, float *px, float *py, float *pz,
+               std::size_t begin, std::size_t end, int steps, float h,
+               float scale, const float *offset) {
+  const floatv hv(h), half(0.5f * h), sixth(h / 6.0f), two(2.0f);
+  const floatv toAttractor(1.0f / scale), toMesh(scale);
+  const floatv ox(offset[0]), oy(offset[1]), oz(offset[2]);
+  for (std::size_t i = begin; i < end; i += simd::width) {
+    // attractor space is the mesh divided by scale
+    floatv x = floatv::load(px + i) * toAttractor;
+    floatv y = floatv::load(py + i) * toAttractor;
+    floatv z = floatv::load(pz + i) * toAttractor;
+    for (int s = 0; s < steps; ++s) {
+      floatv k1x, k1y, k1z;
+      sys(x, y, z, k1x, k1y, k1z);
+      if (I == AttractorIntegrator::EULER) {
+        x = simd::fmadd(k1x, hv, x);
+        y = simd::fmadd(k1y, hv, y);
+        z = simd::fmadd(k1z, hv, z);
+        continue;
+      }
+      floatv k2x, k2y, k2z, k3x, k3y, k3z, k4x, k4y, k4z;
+      sys(simd::fmadd(k1x, half, x), simd::fmadd(k1y, half, y),
+          simd::fmadd(k1z, half, z), k2x, k2y, k2z);
+      sys(simd::fmadd(k2x, half, x), simd::fmadd(k2y, half, y),
+          simd::fmadd(k2z, half, z), k3x, k3y, k3z);
+      sys(simd::fmadd(k3x, hv, x), simd::fmadd(k3y, hv, y),
+          simd::fmadd(k3z, hv, z), k4x, k4y, k4z);
+      x = simd::fmadd(k1x + two * (k2x + k3x) + k4x, sixth, x);
+      y = simd::fmadd(k1y + two * (k2y + k3y) + k4y, sixth, y);
+      z = simd::fmadd(k1z + two * (k2z + k3z) + k4z, sixth, z);
+    }
+    simd::fmadd(x, toMesh, ox).store(px + i);
+    simd::fmadd(y, toMesh, oy).store(py + i);
+    simd::fmadd(z, toMesh, oz).store(pz + i);
+  }
+}
+} // namespace attractor_detail
+
+class AttractorCloud {
+public:
+  // points per parallel chunk. below this the cloud stays on one thread
+  static constexpr std::size_t kGrain = 16384;
+
+  AttractorCloud(AttractorType t = AttractorType::THOMAS,
+                 AttractorIntegrator i = AttractorIntegrator::EULER) {
+    setSystem(t, i);
+  }
+
+  void setSystem(AttractorType t,
+                 AttractorIntegrator i = AttractorIntegrator::EULER) {
+    type = t;
+    integrator = i;
+    params = AttractorParams::defaults(t);
+  }
+  void setParams(const AttractorParams &p) { params = p; }
+  // mesh units per attractor unit (a radius 10 sphere at scale 1 starts far
+  // outside the thomas basin, scale 2-3 keeps it on the attractor)
+  void setScale(float s) { scale = s > 0.0f ? s : 1.0f; }
+  // largest single integration step. queued steps bigger than this are
+  // split into substeps so rk4 / euler stay stable at high speeds
+  void setMaxStep(float h) { maxStep = h > 0.0f ? h : 0.01f; }
+
+  template <class Vec3Vector> void setPoints(const Vec3Vector &verts) {
+    pts.gather(verts);
+  }
+  template <class Vec3Vector> void getPoints(Vec3Vector &verts) const {
+    pts.scatter(verts);
+  }
+  VertexBlock &points() { return pts; }
+  const VertexBlock &points() const { return pts; }
+
+  // frame accumulation. steps are summed, translations are summed, and
+  // applyFrame() integrates then offsets in one pass
+  void queueStep(float h) { queuedStep += h; }
+  void queueTranslate(float x, float y, float z) {
+    queuedOffset[0] += x;
+    queuedOffset[1] += y;
+    queuedOffset[2] += z;
+  }
+
+  void applyFrame() {
+    step(queuedStep, queuedOffset);
+    queuedStep = 0.0f;
+    queuedOffset[0] = queuedOffset[1] = queuedOffset[2] = 0.0f;
+  }
+  template <class MeshT> void applyFrame(MeshT &mesh) {
+    auto &verts = mesh.vertices();
+    if (verts.size() != pts.count) pts.gather(verts);
+    applyFrame();
+    pts.scatter(verts);
+  }
+
+  // integrate every point by total time h right now
+  void step(float h, const float *offset = nullptr) {
+    static const float zero[3] = {0.0f, 0.0f, 0.0f};
+    if (!offset) offset = zero;
+    if (h == 0.0f && !offset[0] && !offset[1] && !offset[2]) return;
+    int steps = h == 0.0f ? 0 : static_cast<int>(std::ceil(std::fabs(h) / maxStep));
+    float sub = steps ? h / steps : 0.0f;
+    switch (type) {
+    case AttractorType::THOMAS:
+      run(attractor_detail::Thomas(params), steps, sub, offset);
+      break;
+    case AttractorType::LORENZ:
+      run(attractor_detail::Lorenz(params), steps, sub, offset);
+      break;
+    case AttractorType::AIZAWA:
+      run(attractor_detail::Aizawa(params), steps, sub, offset);
+      break;
+    case AttractorType::HALVORSEN:
+      run(attractor_detail::Halvorsen(params), steps, sub, offset);
+      break;
+    }
+  }
+
+private:
+  template <class System>
+  void run(const System &sys, int steps, float h, const float *offset) {
+    const std::size_t n = simd::padded(pts.count);
+    float *px = pts.x.data, *py = pts.y.data, *pz = pts.z.data;
+    const float s = scale;
+    const bool rk4 = integrator == AttractorIntegrator::RK4;
+    parallelFor(n / simd::kPad, kGrain / simd::kPad,
+                [&](std::size_t b, std::size_t e) {
+                  b *= simd::kPad;
+                  e *= simd::kPad;
+                  if (rk4)
+                    attractor_detail::integrate<System, AttractorIntegrator::RK4>(
+                        sys, px, py, pz, b, e, steps, h, s, offset);
+                  else
+                    attractor_detail::integrate<System,
+                                                AttractorIntegrator::EULER>(
+                        sys, px, py, pz, b, e, steps, h, s, offset);
+                });
+  }
+
+  VertexBlock pts;
+  AttractorType type = AttractorType::THOMAS;
+  AttractorIntegrator integrator = AttractorIntegrator::EULER;
+  AttractorParams params;
+  float scale = 1.0f;
+  float maxStep = 0.01f;
+  float queuedStep = 0.0f;
+  float queuedOffset[3] = {0.0f, 0.0f, 0.0f};
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+// master show clock counted in audio frames. the audio callback advances it
+// by the frames it actually rendered, so picture follows sound instead of
+// integrating graphics dt and drifting away from it over a long piece.
+//
+// audio thread:   clock.advance(io.framesPerBuffer());   // end of onSound
+// graphics:       double t = clock.seconds();            // once per frame
+//
+// seconds() is what is audible now: rendered frames minus the output latency,
+// plus the wall time since the last block (clamped to one block) so it moves
+// smoothly at any frame rate instead of in 10 ms steps. if the audio device
+// stops calling back, the clock carries on with wall time so a machine
+// without audio still plays the show.
+//
+// publishing uses a seqlock, the audio thread never waits on anything.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class AudioClock {
+public:
+  void setSampleRate(double rate) { sampleRate.store(rate > 0.0 ? rate : 48000.0); }
+  double getSampleRate() const { return sampleRate.load(); }
+  // time between a frame being rendered and it leaving the speakers.
+  // one device buffer is the usual minimum
+  void setOutputLatency(double seconds) {
+    latency.store(std::max(0.0, seconds));
+  }
+
+  // the clock only counts while running (paused shows hold their time)
+  void setRunning(bool r) { running.store(r, std::memory_order_relaxed); }
+  bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+  // any thread. applied by the next advance(), or read back right away
+  void seek(double seconds) {
+    seekFrame.store(static_cast<int64_t>(seconds * sampleRate.load()),
+                    std::memory_order_relaxed);
+    seekPending.store(true, std::memory_order_release);
+    seekCount.fetch_add(1, std::memory_order_release);
+  }
+
+  // audio thread, once per callback
+  void advance(int frames) {
+    int64_t f = frameCount.load(std::memory_order_relaxed);
+    if (seekPending.exchange(false, std::memory_order_acquire)) {
+      f = seekFrame.load(std::memory_order_relaxed) + latencyFrames();
+      ++seekGeneration;
+    } else if (running.load(std::memory_order_relaxed))
+      f += frames;
+    publish(f, frames);
+  }
+
+  // frames rendered so far, minus latency. exact, steps once per block
+  int64_t frames() const {
+    Snapshot s = read();
+    return s.frames - latencyFrames();
+  }
+
+  // smoothed audible time in seconds. monotonic between seeks for a single
+  // reader thread (the graphics loop)
+  double seconds() const {
+    const double rate = sampleRate.load();
+    const int64_t now = nowNanos();
+    const double wallStep = lastReadNanos ? (now - lastReadNanos) * 1e-9 : 0.0;
+    lastReadNanos = now;
+    const uint32_t sc = seekCount.load(std::memory_order_acquire);
+    if (sc != seenSeekCount) {
+      seenSeekCount = sc;
+      lastSeconds = seekFrame.load(std::memory_order_relaxed) / rate;
+    }
+    const bool pending = seekPending.load(std::memory_order_acquire);
+    Snapshot s = read();
+    const double base = (s.frames - latencyFrames()) / rate;
+    if (!running.load(std::memory_order_relaxed)) {
+      live = false;
+      return pending ? lastSeconds : lastSeconds = base;
+    }
+    const double since = s.wallNanos ? (now - s.wallNanos) * 1e-9 : 1e9;
+    if (since >= kStalledSeconds) {
+      // no callbacks (device stopped, or no audio on this machine): carry on
+      // from where we were on wall time
+      live = false;
+      return lastSeconds += wallStep;
+    }
+    // the audio thread applies a seek on its next block
+    if (pending) return lastSeconds;
+    // a live device is never more than a block ahead of what we've seen
+    double t = base + std::min(since, s.blockFrames / rate);
+    // stay monotonic, except across a seek or when audio comes back
+    if (live && s.generation == lastGeneration && t < lastSeconds)
+      t = lastSeconds;
+    live = true;
+    lastGeneration = s.generation;
+    return lastSeconds = t;
+  }
+
+  static constexpr double kStalledSeconds = 0.25;
+
+private:
+  struct Snapshot {
+    int64_t frames = 0;
+    int64_t wallNanos = 0;
+    int blockFrames = 0;
+    uint32_t generation = 0;
+  };
+
+  int64_t latencyFrames() const {
+    return static_cast<int64_t>(latency.load() * sampleRate.load());
+  }
+
+  static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void publish(int64_t f, int blockFrames) {
+    const uint32_t s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed); // odd: writing
+    std::atomic_thread_fence(std::memory_order_release);
+    frameCount.store(f, std::memory_order_relaxed);
+    wall.store(nowNanos(), std::memory_order_relaxed);
+    block.store(blockFrames, std::memory_order_relaxed);
+    generation.store(seekGeneration, std::memory_order_relaxed);
+    sequence.store(s + 2, std::memory_order_release);
+  }
+
+  Snapshot read() const {
+    Snapshot out;
+    for (;;) {
+      const uint32_t s0 = sequence.load(std::memory_order_acquire);
+      if (s0 & 1) continue;
+      out.frames = frameCount.load(std::memory_order_relaxed);
+      out.wallNanos = wall.load(std::memory_order_relaxed);
+      out.blockFrames = block.load(std::memory_order_relaxed);
+      out.generation = generation.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == s0) return out;
+    }
+  }
+
+  std::atomic<double> sampleRate{48000.0};
+  std::atomic<double> latency{0.0};
+  std::atomic<bool> running{false};
+  std::atomic<bool> seekPending{false};
+  std::atomic<int64_t> seekFrame{0};
+  std::atomic<uint32_t> seekCount{0};
+
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<int64_t> frameCount{0};
+  std::atomic<int64_t> wall{0};
+  std::atomic<int> block{0};
+  std::atomic<uint32_t> generation{0};
+  uint32_t seekGeneration = 0; // audio thread only
+
+  // reader side smoothing state, graphics thread only
+  mutable double lastSeconds = 0.0;
+  mutable uint32_t lastGeneration = 0;
+  mutable int64_t lastReadNanos = 0;
+  mutable bool live = false;
+  mutable uint32_t seenSeekCount = 0;
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+// audio-reactive features for the shaders: log-spaced band energies,
+// loudness, spectral flux, an onset pulse and the spectral centroid, all
+// 0..1. the audio thread only copies its mix into an SpscRing. a worker
+// thread does the FFTs every hop and publishes a small Frame through a
+// ControlSnapshot, and the render loop picks up whichever Frame is newest.
+// neither of them ever waits on the analysis. Frame is plain data, so the
+// primary can put it in the distributed state for the replicas.
+//
+//   AudioFeatures features;
+//   features.start(48000, 512);                    // setup, starts the worker
+//   onSound:   features.push(mix, frames);          // or pushOutputs(io)
+//   onAnimate: state().features = features.latest();
+//   onDraw:    AudioFeatures::uniforms(state().features,
+//                  [&](const char *n, float v) { sphere.setUniformFloat(n, v); });
+//
+// in glsl: uniform float u_bands[16]; uniform float u_loudness, u_onset,
+// u_flux, u_centroid;
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "controlSnapshot.hpp"
+#include "fft.hpp"
+#include "simdUtility.hpp"
+#include "spscRing.hpp"
+
+class AudioFeatures {
+public:
+  static constexpr int kBands = 16;
+
+  struct Frame {
+    float bands[kBands]; // log energy per band, -70..0 dBFS -> 0..1
+    float loudness;      // block RMS, -60..0 dBFS -> 0..1
+    float flux;          // rise in band energy since the last hop
+    float onset;         // 1 on an onset, decaying over ~150 ms
+    float centroid;      // spectral centroid over nyquist
+  };
+
+  AudioFeatures() = default;
+  ~AudioFeatures() { stop(); }
+  AudioFeatures(const AudioFeatures &) = delete;
+  AudioFeatures &operator=(const AudioFeatures &) = delete;
+
+  // not real-time safe. fftSize and hop are powers of two, hop <= fftSize
+  void start(double sampleRate, int maxFrames, int fftSize = 1024,
+             int hopSize = 512) {
+    stop();
+    rate = sampleRate;
+    size = fftSize;
+    hop = std::min(hopSize, fftSize);
+    fft.setSize(size);
+    ring.reset(static_cast<std::size_t>(sampleRate)); // a second of slack
+    mono.resize(maxFrames);
+    window.resize(size);
+    window.zero();
+    windowed.resize(size);
+    hann.resize(size);
+    for (int i = 0; i < size; ++i)
+      hann.data[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / size));
+    const int bins = size / 2 + 1;
+    re.resize(bins);
+    im.resize(bins);
+    power.resize(bins);
+    re.zero();
+    im.zero();
+    power.zero();
+    // log-spaced edges from 40 Hz to 16 kHz (or nyquist), at least one bin
+    const double lo = 40.0, hi = std::min(16000.0, 0.5 * sampleRate);
+    for (int b = 0; b <= kBands; ++b) {
+      const double hz = lo * std::pow(hi / lo, double(b) / kBands);
+      edges[b] = std::clamp(static_cast<int>(hz * size / sampleRate + 0.5), 1,
+                            bins - 1);
+      if (b > 0) edges[b] = std::max(edges[b], edges[b - 1] + 1);
+    }
+    std::fill(std::begin(previous), std::end(previous), 0.0f);
+    fluxMean = 0.0f;
+    state = Frame{};
+    published.publish(state);
+    quit.store(false);
+    worker = std::thread([this] { workerLoop(); });
+  }
+
+  void stop() {
+    quit.store(true);
+    if (worker.joinable()) worker.join();
+  }
+
+  // --- audio thread ---
+
+  // mono samples. when the worker falls behind the newest audio is dropped
+  void push(const float *in, int frames) {
+    ring.write(in, static_cast<std::size_t>(frames));
+  }
+  // the average of io's outputs
+  template <class IO> void pushOutputs(IO &io) {
+    const int frames =
+        std::min<int>(io.framesPerBuffer(), static_cast<int>(mono.size));
+    const int chans = static_cast<int>(io.channelsOut());
+    if (chans == 0) return;
+    std::fill(mono.data, mono.data + frames, 0.0f);
+    const simd::floatv g(1.0f / chans);
+    const int vecFrames = frames / simd::width * simd::width;
+    for (int c = 0; c < chans; ++c) {
+      const float *x = io.outBuffer(c);
+      int f = 0;
+      for (; f < vecFrames; f += simd::width)
+        simd::fmadd(g, simd::floatv::loadu(x + f), simd::floatv::load(mono.data + f))
+            .store(mono.data + f);
+      for (; f < frames; ++f) mono.data[f] += x[f] / chans;
+    }
+    push(mono.data, frames);
+  }
+
+  // --- one reader (the render loop) ---
+
+  // newest analysis, stays valid until the next latest()
+  const Frame &latest() { return published.acquire(); }
+
+  // set(name, value) for each uniform a Frame becomes
+  template <class Set> static void uniforms(const Frame &f, Set &&set) {
+    static const std::vector<std::string> names = [] {
+      std::vector<std::string> n;
+      for (int b = 0; b < kBands; ++b)
+        n.push_back("u_bands[" + std::to_string(b) + "]");
+      return n;
+    }();
+    for (int b = 0; b < kBands; ++b) set(names[b].c_str(), f.bands[b]);
+    set("u_loudness", f.loudness);
+    set("u_flux", f.flux);
+    set("u_onset", f.onset);
+    set("u_centroid", f.centroid);
+  }
+
+private:
+  void workerLoop() {
+    while (!quit.load(std::memory_order_relaxed)) {
+      // a stalled worker catches up to the present instead of lagging
+      while (ring.readAvailable() >= static_cast<std::size_t>(4 * size)) {
+        ring.read(window.data + size - hop, hop);
+      }
+      if (ring.readAvailable() < static_cast<std::size_t>(hop)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        continue;
+      }
+      std::copy(window.data + hop, window.data + size, window.data);
+      ring.read(window.data + size - hop, hop);
+      analyze();
+      published.publish(state);
+    }
+  }
+
+  void analyze() {
+    const float *x = window.data;
+    simd::floatv sq(0.0f);
+    for (int i = size - hop; i < size; i += simd::width) {
+      const simd::floatv v = simd::floatv::load(x + i);
+      sq = simd::fmadd(v, v, sq);
+    }
+    for (int i = 0; i < size; i += simd::width)
+      (simd::floatv::load(x + i) * simd::floatv::load(hann.data + i))
+          .store(windowed.data + i);
+    fft.forward(windowed.data, re.data, im.data);
+
+    // normalized so a full-scale sine's bin is about 1
+    const int bins = size / 2 + 1;
+    const simd::floatv norm(16.0f / (float(size) * size));
+    for (std::size_t k = 0; k < static_cast<std::size_t>(bins);
+         k += simd::width) {
+      const simd::floatv r = simd::floatv::load(re.data + k);
+      const simd::floatv i = simd::floatv::load(im.data + k);
+      (simd::fmadd(r, r, i * i) * norm).store(power.data + k);
+    }
+
+    const float dt = static_cast<float>(hop / rate);
+    float flux = 0.0f, total = 0.0f, moment = 0.0f;
+    for (int b = 0; b < kBands; ++b) {
+      float e = 0.0f;
+      for (int k = edges[b]; k < edges[b + 1]; ++k) e += power.data[k];
+      const float level = std::clamp(
+          (10.0f * std::log10(e + 1e-12f) + 70.0f) / 70.0f, 0.0f, 1.0f);
+      flux += std::max(0.0f, level - previous[b]);
+      previous[b] = level;
+      // fast attack, ~200 ms release, so bars don't flicker on the dome
+      const float k = level > state.bands[b] ? 1.0f : 1.0f - std::exp(-dt / 0.2f);
+      state.bands[b] += k * (level - state.bands[b]);
+    }
+    for (int k = 1; k < bins; ++k) {
+      total += power.data[k];
+      moment += k * power.data[k];
+    }
+    flux /= kBands;
+
+    const float rms = std::sqrt(simd::hsum(sq) / hop);
+    const float loud = std::clamp(
+        (20.0f * std::log10(rms + 1e-9f) + 60.0f) / 60.0f, 0.0f, 1.0f);
+    state.loudness += (1.0f - std::exp(-dt / 0.1f)) * (loud - state.loudness);
+    state.flux = flux;
+    state.centroid = total > 1e-9f ? moment / (total * (bins - 1)) : 0.0f;
+
+    // onset: flux well above its recent average
+    const bool onset = flux > 1.5f * fluxMean + 0.02f;
+    fluxMean += (1.0f - std::exp(-dt / 0.5f)) * (flux - fluxMean);
+    state.onset = onset ? 1.0f : state.onset * std::exp(-dt / 0.15f);
+  }
+
+  static constexpr double kPi = 3.14159265358979323846;
+
+  double rate = 48000.0;
+  int size = 1024, hop = 512;
+  int edges[kBands + 1] = {};
+
+  SpscRing<float> ring;
+  simd::alignedBuffer mono; // audio thread
+
+  // worker only
+  RealFft fft;
+  simd::alignedBuffer window, windowed, hann, re, im, power;
+  float previous[kBands] = {};
+  float fluxMean = 0.0f;
+  Frame state{};
+
+  ControlSnapshot<Frame> published;
+  std::thread worker;
+  std::atomic<bool> quit{false};
+};
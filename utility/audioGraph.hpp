@@ -0,0 +1,133 @@
+#pragma once
+
+// the callback as a fixed list of nodes, run in order once per block. a
+// node is either serial (one call on the audio thread) or parallel: count
+// independent tasks (per-source gains, per-speaker mixes, per-channel FIR)
+// that AudioWorkers fans out across its spinning threads, with the
+// fork/join in run() as the barrier before the next node.
+//
+//   AudioGraph<al::AudioIOData> graph;
+//   graph.add("show", [&](al::AudioIOData &io, int frames) { ... });
+//   graph.addParallel("mix", [&](al::AudioIOData &) { return spat.mixSpeakers(); },
+//                     [&](al::AudioIOData &, int k, int frames) { spat.mixSpeaker(k); });
+//   graph.setWorkers(&audioWorkers);
+//   onSound: graph.process(io, io.framesPerBuffer());
+//
+// a parallel node whose block is too small to be worth waking the workers
+// for (tasks x frames under the threshold) just loops on the audio thread,
+// so short blocks and idle sections don't pay the fork/join.
+//
+// with a profiler set, each block is timed and each node is a stage of
+// it (utility/audioProfiler.hpp).
+//
+// nodes are added during setup only. process() doesn't allocate or lock;
+// the std::functions are built once and only called.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "audioProfiler.hpp"
+#include "audioWorkers.hpp"
+
+template <class Context> class AudioGraph {
+public:
+  using Serial = std::function<void(Context &, int frames)>;
+  using Count = std::function<int(Context &)>;
+  using Task = std::function<void(Context &, int index, int frames)>;
+
+  // --- setup, not real-time safe ---
+
+  // returns the node's index
+  int add(const std::string &name, Serial fn) {
+    Node n;
+    n.name = name;
+    n.serial = std::move(fn);
+    nodes.push_back(std::move(n));
+    return size() - 1;
+  }
+  int addParallel(const std::string &name, Count count, Task task) {
+    Node n;
+    n.name = name;
+    n.count = std::move(count);
+    n.task = std::move(task);
+    nodes.push_back(std::move(n));
+    return size() - 1;
+  }
+  int addParallel(const std::string &name, int count, Task task) {
+    return addParallel(name, [count](Context &) { return count; },
+                       std::move(task));
+  }
+
+  // nullptr runs every node on the caller
+  void setWorkers(AudioWorkers *w) { workers = w; }
+  // parallel nodes with fewer than this many task-frames run serially
+  void setParallelThreshold(int taskFrames) { threshold = taskFrames; }
+  // adds a stage per node, so call after the last add() and before
+  // profiler->prepare(). nullptr stops profiling
+  void setProfiler(AudioProfiler *p) {
+    profiler = p;
+    if (p)
+      for (Node &n : nodes) n.stage = p->addStage(n.name);
+  }
+  // a disabled node is skipped. setup only, or from the audio thread
+  void setEnabled(int node, bool on) { nodes[node].enabled = on; }
+
+  int size() const { return static_cast<int>(nodes.size()); }
+  const std::string &name(int node) const { return nodes[node].name; }
+  // blocks in which a node forked, and in which it ran on the caller
+  uint64_t forkedBlocks(int node) const { return nodes[node].forkCount; }
+  uint64_t serialBlocks(int node) const { return nodes[node].serialCount; }
+
+  // --- audio thread ---
+
+  void process(Context &ctx, int frames) {
+    if (profiler) profiler->beginBlock(frames);
+    for (Node &n : nodes) {
+      if (!n.enabled) continue;
+      run(n, ctx, frames);
+      if (profiler) profiler->mark(n.stage);
+    }
+    if (profiler) profiler->endBlock();
+  }
+
+  // about one 60 channel block of 64 frames: below that the workers'
+  // wake-up is a real share of the work
+  static constexpr int kDefaultThreshold = 4096;
+
+private:
+  struct Node;
+
+  void run(Node &n, Context &ctx, int frames) {
+    if (n.serial) {
+      n.serial(ctx, frames);
+      return;
+    }
+    const int count = n.count(ctx);
+    if (count <= 0) return;
+    if (workers && workers->size() > 1 && count > 1 &&
+        static_cast<int64_t>(count) * frames >= threshold) {
+      ++n.forkCount;
+      workers->run(count, [&](int i) { n.task(ctx, i, frames); });
+    } else {
+      ++n.serialCount;
+      for (int i = 0; i < count; ++i) n.task(ctx, i, frames);
+    }
+  }
+
+  struct Node {
+    std::string name;
+    Serial serial;
+    Count count;
+    Task task;
+    bool enabled = true;
+    int stage = 0;
+    uint64_t forkCount = 0, serialCount = 0;
+  };
+
+  std::vector<Node> nodes;
+  AudioWorkers *workers = nullptr;
+  AudioProfiler *profiler = nullptr;
+  int threshold = kDefaultThreshold;
+};
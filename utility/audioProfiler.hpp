@@ -0,0 +1,372 @@
+#pragma once
+
+// what onSound costs against its deadline, stage by stage. the audio
+// thread stamps the start of each block and the end of each stage with the
+// cpu's cycle counter (rdtsc / cntvct, a few ns and no syscall), and drops
+// every duration into a log-spaced histogram of relaxed atomics it alone
+// writes. a non-real-time reader turns those into percentiles and worst
+// cases, or a CSV, whenever it likes.
+//
+// late callbacks are counted too: a block that starts more than 1.5
+// periods after the last one is late (the device or the OS held us up),
+// one that itself runs past its period is an overrun (we held the device
+// up), and the gap tells how many blocks went missing. each of those also
+// goes into a small event ring for the log.
+//
+//   AudioProfiler prof;
+//   int spat = prof.addStage("spatialize");   // setup, before prepare
+//   prof.prepare(48000, 512);
+//   onSound: prof.beginBlock(frames); ... prof.mark(spat); ... prof.endBlock();
+//   later:   prof.writeCsv("audioProfile.csv");  prof.print(std::cout);
+//
+// everything between two marks is charged to the second mark's stage.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spscRing.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace cycles {
+
+// a cheap monotonic tick
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+  return __rdtsc();
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+  uint64_t v;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// ns per tick, measured against steady_clock. not real-time safe (sleeps)
+inline double calibrate(double seconds = 0.02) {
+  using clock = std::chrono::steady_clock;
+  const auto t0 = clock::now();
+  const uint64_t c0 = now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  const uint64_t c1 = now();
+  const double ns =
+      std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+  return c1 > c0 ? ns / double(c1 - c0) : 1.0;
+}
+
+// index of the highest set bit, n > 0
+inline int highestBit(uint64_t n) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i;
+  _BitScanReverse64(&i, n);
+  return static_cast<int>(i);
+#elif defined(_MSC_VER)
+  int i = 0;
+  while (n >>= 1) ++i;
+  return i;
+#else
+  return 63 - __builtin_clzll(n);
+#endif
+}
+
+} // namespace cycles
+
+class AudioProfiler {
+public:
+  static constexpr int kMaxStages = 16;
+  // 8 bins per octave from 64 ns up to ~4 s
+  static constexpr int kBinsPerOctave = 8;
+  static constexpr int kBins = 26 * kBinsPerOctave;
+  static constexpr int kFloorShift = 6;
+  static constexpr double kFloorNs = 1 << kFloorShift;
+
+  enum class EventKind : uint8_t { LATE, OVERRUN };
+  struct Event {
+    uint64_t block = 0;
+    EventKind kind = EventKind::LATE;
+    float intervalUs = 0; // since the previous block started
+    float durationUs = 0; // this block's callback time
+    uint32_t missed = 0;  // periods skipped before a late block
+  };
+
+  struct Summary {
+    std::string name;
+    uint64_t count = 0;
+    double meanUs = 0, p50Us = 0, p90Us = 0, p99Us = 0, p999Us = 0,
+           maxUs = 0;
+  };
+
+  AudioProfiler() = default;
+  AudioProfiler(const AudioProfiler &) = delete;
+  AudioProfiler &operator=(const AudioProfiler &) = delete;
+
+  // --- setup, not real-time safe ---
+
+  // returns the stage's index for mark(). at most kMaxStages
+  int addStage(const std::string &name) {
+    if (static_cast<int>(names.size()) >= kMaxStages) return kMaxStages - 1;
+    names.push_back(name);
+    return static_cast<int>(names.size()) - 1;
+  }
+  int stageCount() const { return static_cast<int>(names.size()); }
+
+  // the deadline is blockFrames / sampleRate. calibrates the tick (20 ms)
+  void prepare(double sampleRate, int blockFrames) {
+    rate = sampleRate;
+    periodNs = blockFrames / sampleRate * 1e9;
+    nsPerTick = cycles::calibrate();
+    events.reset(256);
+    clear();
+  }
+
+  // blocks over this share of the deadline also count as over budget
+  void setBudget(double fractionOfDeadline) { budget = fractionOfDeadline; }
+
+  // any thread. the audio thread zeroes everything at its next block
+  void reset() { resetRequested.store(true, std::memory_order_release); }
+
+  // --- audio thread ---
+
+  void beginBlock(int frames) {
+    if (resetRequested.load(std::memory_order_acquire)) {
+      resetRequested.store(false, std::memory_order_relaxed);
+      clear();
+    }
+    const uint64_t t = cycles::now();
+    const double expected = frames / rate * 1e9;
+    if (lastStart) {
+      const double interval = (t - lastStart) * nsPerTick;
+      if (interval > 1.5 * expected) {
+        const uint32_t missed =
+            static_cast<uint32_t>(std::max(0.0, interval / expected - 0.5));
+        add(late, 1);
+        add(missedBlocks, missed);
+        Event e;
+        e.block = blockIndex;
+        e.kind = EventKind::LATE;
+        e.intervalUs = static_cast<float>(interval * 1e-3);
+        e.missed = missed;
+        events.write(&e, 1);
+      }
+    }
+    lastStart = t;
+    stageStart = t;
+    blockDeadlineNs = expected;
+  }
+
+  // ends `stage`: everything since the last mark (or beginBlock)
+  void mark(int stage) {
+    const uint64_t t = cycles::now();
+    record(stage, (t - stageStart) * nsPerTick);
+    stageStart = t;
+  }
+
+  void endBlock() {
+    const double ns = (cycles::now() - lastStart) * nsPerTick;
+    record(kMaxStages, ns);
+    if (ns > blockDeadlineNs) {
+      add(overruns, 1);
+      Event e;
+      e.block = blockIndex;
+      e.kind = EventKind::OVERRUN;
+      e.durationUs = static_cast<float>(ns * 1e-3);
+      events.write(&e, 1);
+    }
+    if (ns > budget * blockDeadlineNs) add(overBudget, 1);
+    add(blocks, 1);
+    ++blockIndex;
+  }
+
+  // marks a stage over its scope
+  struct Scope {
+    AudioProfiler &p;
+    int stage;
+    Scope(AudioProfiler &prof, int s) : p(prof), stage(s) {}
+    ~Scope() { p.mark(stage); }
+  };
+
+  // --- reader, any non-real-time thread ---
+
+  uint64_t blockCount() const { return blocks.load(std::memory_order_relaxed); }
+  uint64_t lateCallbacks() const { return late.load(std::memory_order_relaxed); }
+  uint64_t missedCallbacks() const {
+    return missedBlocks.load(std::memory_order_relaxed);
+  }
+  uint64_t overrunCount() const { return overruns.load(std::memory_order_relaxed); }
+  uint64_t overBudgetCount() const {
+    return overBudget.load(std::memory_order_relaxed);
+  }
+  double deadlineUs() const { return periodNs * 1e-3; }
+
+  // stage -1 is the whole callback
+  Summary summary(int stage) const {
+    const int s = stage < 0 ? kMaxStages : stage;
+    const Stage &st = stats[s];
+    Summary out;
+    out.name = stage < 0 ? "callback" : names[stage];
+    uint64_t counts[kBins];
+    for (int b = 0; b < kBins; ++b)
+      counts[b] = st.bins[b].load(std::memory_order_relaxed);
+    for (int b = 0; b < kBins; ++b) out.count += counts[b];
+    if (out.count == 0) return out;
+    out.meanUs = st.sumNs.load(std::memory_order_relaxed) * 1e-3 / out.count;
+    out.maxUs = st.maxNs.load(std::memory_order_relaxed) * 1e-3;
+    out.p50Us = percentile(counts, out.count, 0.5);
+    out.p90Us = percentile(counts, out.count, 0.9);
+    out.p99Us = percentile(counts, out.count, 0.99);
+    out.p999Us = percentile(counts, out.count, 0.999);
+    // a bin's upper edge can overshoot the real worst case
+    out.p50Us = std::min(out.p50Us, out.maxUs);
+    out.p90Us = std::min(out.p90Us, out.maxUs);
+    out.p99Us = std::min(out.p99Us, out.maxUs);
+    out.p999Us = std::min(out.p999Us, out.maxUs);
+    return out;
+  }
+
+  // late / overrun events since the last call
+  template <class F> int pollEvents(F &&f) {
+    Event e;
+    int n = 0;
+    while (events.read(&e, 1) == 1) {
+      f(e);
+      ++n;
+    }
+    return n;
+  }
+
+  // one row per stage plus the whole callback, then the xrun counters
+  bool writeCsv(const std::string &path) const {
+    std::FILE *f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "stage,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,"
+                    "deadline_us\n");
+    for (int s = -1; s < stageCount(); ++s) {
+      const Summary m = summary(s);
+      std::fprintf(f, "%s,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f\n",
+                   m.name.c_str(), static_cast<unsigned long long>(m.count),
+                   m.meanUs, m.p50Us, m.p90Us, m.p99Us, m.p999Us, m.maxUs,
+                   deadlineUs());
+    }
+    std::fprintf(f, "\ncounter,value\nblocks,%llu\nlate,%llu\nmissed,%llu\n"
+                    "overruns,%llu\nover_budget,%llu\n",
+                 static_cast<unsigned long long>(blockCount()),
+                 static_cast<unsigned long long>(lateCallbacks()),
+                 static_cast<unsigned long long>(missedCallbacks()),
+                 static_cast<unsigned long long>(overrunCount()),
+                 static_cast<unsigned long long>(overBudgetCount()));
+    return std::fclose(f) == 0;
+  }
+
+  void print(std::ostream &out) const {
+    char line[160];
+    std::snprintf(line, sizeof line, "%-14s %9s %8s %8s %8s %8s %8s  (deadline %.0f us)\n",
+                  "stage", "blocks", "mean", "p50", "p99", "p99.9", "max",
+                  deadlineUs());
+    out << line;
+    for (int s = -1; s < stageCount(); ++s) {
+      const Summary m = summary(s);
+      std::snprintf(line, sizeof line,
+                    "%-14s %9llu %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+                    m.name.c_str(), static_cast<unsigned long long>(m.count),
+                    m.meanUs, m.p50Us, m.p99Us, m.p999Us, m.maxUs);
+      out << line;
+    }
+    out << "late " << lateCallbacks() << " (missed " << missedCallbacks()
+        << "), overruns " << overrunCount() << ", over "
+        << static_cast<int>(budget * 100) << "% " << overBudgetCount()
+        << std::endl;
+  }
+
+private:
+  // one writer (the audio thread), so plain load + store, no RMW
+  struct Stage {
+    std::atomic<uint32_t> bins[kBins];
+    std::atomic<uint64_t> sumNs{0};
+    std::atomic<uint64_t> maxNs{0};
+  };
+
+  static void add(std::atomic<uint64_t> &a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  // octave from the leading bit, then the next three bits split it in 8.
+  // integer only: no log2 on the audio thread
+  static int binOf(uint64_t ns) {
+    const uint64_t n = ns >> kFloorShift;
+    if (n == 0) return 0;
+    const int octave = cycles::highestBit(n);
+    const int sub = static_cast<int>(
+        (octave >= 3 ? n >> (octave - 3) : n << (3 - octave)) & 7);
+    return std::min(kBins - 1, octave * kBinsPerOctave + sub);
+  }
+  static double binUpperUs(int b) {
+    const int octave = b / kBinsPerOctave, sub = b % kBinsPerOctave;
+    return kFloorNs * std::ldexp(1.0 + (sub + 1.0) / kBinsPerOctave, octave) *
+           1e-3;
+  }
+  static double percentile(const uint64_t *counts, uint64_t total, double p) {
+    const uint64_t want = static_cast<uint64_t>(std::ceil(p * total));
+    uint64_t seen = 0;
+    for (int b = 0; b < kBins; ++b) {
+      seen += counts[b];
+      if (seen >= want) return binUpperUs(b);
+    }
+    return binUpperUs(kBins - 1);
+  }
+
+  void record(int stage, double ns) {
+    if (stage < 0 || stage > kMaxStages) return;
+    Stage &st = stats[stage];
+    const uint64_t n = static_cast<uint64_t>(ns);
+    std::atomic<uint32_t> &bin = st.bins[binOf(n)];
+    bin.store(bin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    add(st.sumNs, n);
+    if (n > st.maxNs.load(std::memory_order_relaxed))
+      st.maxNs.store(n, std::memory_order_relaxed);
+  }
+
+  // audio thread (or setup)
+  void clear() {
+    for (Stage &st : stats) {
+      for (auto &b : st.bins) b.store(0, std::memory_order_relaxed);
+      st.sumNs.store(0, std::memory_order_relaxed);
+      st.maxNs.store(0, std::memory_order_relaxed);
+    }
+    for (auto *c : {&blocks, &late, &missedBlocks, &overruns, &overBudget})
+      c->store(0, std::memory_order_relaxed);
+    lastStart = 0;
+  }
+
+  std::vector<std::string> names;
+  double rate = 48000.0;
+  double periodNs = 1e7;
+  double nsPerTick = 1.0;
+  double budget = 0.7;
+
+  // audio thread
+  uint64_t lastStart = 0, stageStart = 0, blockIndex = 0;
+  double blockDeadlineNs = 1e7;
+
+  Stage stats[kMaxStages + 1]; // the last one is the whole callback
+  std::atomic<uint64_t> blocks{0}, late{0}, missedBlocks{0}, overruns{0},
+      overBudget{0};
+  std::atomic<bool> resetRequested{false};
+  SpscRing<Event> events;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+// fork/join helpers for the audio callback. WorkerPool (parallelFor.hpp)
+// parks its threads on a condition variable and serializes jobs on a mutex,
+// fine for a frame loop but not inside onSound. here the workers spin on an
+// atomic instead, the callback hands out job indices through a counter and
+// works on them too, and nothing locks or allocates once it is built.
+//
+//   AudioWorkers workers{3};                       // setup
+//   onSound: workers.run(channels, [&](int c) { process(c); });
+//
+// run() returns once every index is done. a worker that is slow to wake
+// just finds nothing left, so a busy machine degrades to the callback doing
+// all the work, never to a missed deadline waiting on a thread.
+//
+// idle workers spin for a moment, then yield, then after kSleepAfter with
+// no jobs sleep in short naps so a stopped show doesn't hold cores at 100%.
+//
+// start(n, firstCore) pins worker i to core firstCore + i and asks for
+// SCHED_FIFO just under the audio thread (linux only, and only if the user
+// may; otherwise they stay ordinary threads), so the scheduler can't park
+// a worker behind the renderer mid-block.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#define AUDIO_WORKERS_PAUSE() _mm_pause()
+#elif defined(__aarch64__)
+#define AUDIO_WORKERS_PAUSE() asm volatile("yield")
+#else
+#define AUDIO_WORKERS_PAUSE() ((void)0)
+#endif
+
+class AudioWorkers {
+public:
+  // threads besides the audio thread. 0 runs everything on the caller
+  explicit AudioWorkers(unsigned threads = 0) { start(threads); }
+  ~AudioWorkers() { stop(); }
+
+  AudioWorkers(const AudioWorkers &) = delete;
+  AudioWorkers &operator=(const AudioWorkers &) = delete;
+
+  // not real-time safe. firstCore < 0 leaves the workers unpinned
+  void start(unsigned threads, int firstCore = -1) {
+    stop();
+    quit.store(false);
+    for (unsigned i = 0; i < threads; ++i) {
+      threadsRunning.emplace_back([this] { workerLoop(); });
+      if (firstCore >= 0)
+        pinned += pin(threadsRunning.back(), firstCore + static_cast<int>(i));
+    }
+  }
+  void stop() {
+    quit.store(true);
+    for (auto &t : threadsRunning) t.join();
+    threadsRunning.clear();
+    pinned = 0;
+  }
+
+  // audio thread plus workers
+  unsigned size() const { return static_cast<unsigned>(threadsRunning.size()) + 1; }
+  // workers that got their core
+  unsigned pinnedCount() const { return pinned; }
+
+  // calls fn(i) for i in [0, n), on the caller and any awake workers.
+  // one caller at a time (the audio thread)
+  template <class F> void run(int n, F &&fn) {
+    if (n <= 0) return;
+    if (threadsRunning.empty() || n == 1) {
+      for (int i = 0; i < n; ++i) fn(i);
+      return;
+    }
+    using Fn = typename std::remove_reference<F>::type;
+    context = const_cast<void *>(static_cast<const void *>(&fn));
+    call = [](void *ctx, int i) { (*static_cast<Fn *>(ctx))(i); };
+    count = n;
+    next.store(0, std::memory_order_relaxed);
+    pending.store(n, std::memory_order_relaxed);
+    lastJob.store(nowNanos(), std::memory_order_relaxed);
+    // odd generation: a job is open
+    const uint64_t g = generation.load(std::memory_order_relaxed) + 1;
+    generation.store(g, std::memory_order_seq_cst);
+
+    work();
+    while (pending.load(std::memory_order_acquire) > 0) AUDIO_WORKERS_PAUSE();
+
+    // close the job, then wait out any worker that got in before it closed
+    // so none of them sees the next job's index counter with this fn
+    generation.store(g + 1, std::memory_order_seq_cst);
+    while (busy.load(std::memory_order_seq_cst) > 0) AUDIO_WORKERS_PAUSE();
+  }
+
+  static constexpr int kSpins = 4000;
+  static constexpr double kSleepAfter = 1.0; // seconds without a job
+
+private:
+  void work() {
+    for (;;) {
+      const int i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= count) return;
+      call(context, i);
+      pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  void workerLoop() {
+    uint64_t seen = generation.load();
+    int spins = 0;
+    while (!quit.load(std::memory_order_relaxed)) {
+      const uint64_t g = generation.load(std::memory_order_acquire);
+      if (g == seen || (g & 1) == 0) {
+        if (++spins < kSpins) {
+          AUDIO_WORKERS_PAUSE();
+        } else if (nowNanos() - lastJob.load(std::memory_order_relaxed) <
+                   static_cast<int64_t>(kSleepAfter * 1e9)) {
+          std::this_thread::yield();
+        } else {
+          std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        continue;
+      }
+      busy.fetch_add(1, std::memory_order_seq_cst);
+      if (generation.load(std::memory_order_seq_cst) == g) {
+        seen = g;
+        work();
+      }
+      busy.fetch_sub(1, std::memory_order_seq_cst);
+      spins = 0;
+    }
+  }
+
+  // true if the thread got the core. the priority is best effort
+  static bool pin(std::thread &t, int core) {
+#if defined(__linux__)
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores <= 0 || core >= cores) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    const bool ok =
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) == 0;
+    sched_param param{};
+    param.sched_priority = std::max(1, sched_get_priority_max(SCHED_FIFO) - 2);
+    pthread_setschedparam(t.native_handle(), SCHED_FIFO, &param);
+    return ok;
+#else
+    (void)t;
+    (void)core;
+    return false;
+#endif
+  }
+
+  static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  std::vector<std::thread> threadsRunning;
+  std::atomic<bool> quit{false};
+  unsigned pinned = 0;
+
+  // the open job. written by the caller only while no worker is busy
+  void *context = nullptr;
+  void (*call)(void *, int) = nullptr;
+  int count = 0;
+
+  alignas(64) std::atomic<uint64_t> generation{0};
+  alignas(64) std::atomic<int> next{0};
+  alignas(64) std::atomic<int> pending{0};
+  alignas(64) std::atomic<int> busy{0};
+  alignas(64) std::atomic<int64_t> lastJob{0};
+};
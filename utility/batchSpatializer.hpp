@@ -0,0 +1,284 @@
+#pragma once
+
+// spatializes N mono sources onto the speaker rack in one pass, instead of a
+// spatializer->renderBuffer() per source.
+//
+// per block: every source's speaker gains are computed once, at its new
+// position (DBAP, or an ambisonic panning function decoded straight to
+// speaker gains). the mix then ramps each gain linearly from last block's
+// value across the block, so moving sources don't zipper, and accumulates
+// speaker by speaker so one output stays hot in cache while all sources are
+// summed into it.
+//
+//   BatchSpatializer spat;
+//   spat.setSpeakers(speakerLayout);          // al::Speakers or similar
+//   spat.prepare(64, io.framesPerBuffer());
+//   onSound: spat.setSource(i, buffer, x, y, z) ...; spat.render(io);
+//
+// render() also comes in pieces for an AudioGraph (audioGraph.hpp): after
+// beginBlock, updateGains(i) for each source slot and then mixSpeaker(k) for
+// each speaker are independent, so each set can be split across workers.
+//
+// cost is sources x speakers per sample. past a few dozen sources at high
+// order, encoding to B-format and decoding once (ambisonicDecoder.hpp) wins.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "simdUtility.hpp"
+#include "sphericalHarmonics.hpp"
+
+enum class PanMode { DBAP, AMBISONIC };
+
+class BatchSpatializer {
+public:
+  // any container of speakers with vec() (x, y, z) and deviceChannel, like
+  // al::Speakers. not real-time safe
+  template <class Speakers> void setSpeakers(const Speakers &speakers) {
+    spkX.clear();
+    spkY.clear();
+    spkZ.clear();
+    spkChannel.clear();
+    for (const auto &s : speakers) {
+      const auto v = s.vec();
+      spkX.push_back(static_cast<float>(v[0]));
+      spkY.push_back(static_cast<float>(v[1]));
+      spkZ.push_back(static_cast<float>(v[2]));
+      spkChannel.push_back(static_cast<int>(s.deviceChannel));
+    }
+    rebuild();
+  }
+
+  // DBAP: rolloff in dB per doubling of distance, blur keeps gains finite
+  // when a source sits on a speaker. AMBISONIC: order 1-7, max-rE weighted
+  void setMode(PanMode m, int ambisonicOrder = 3) {
+    mode = m;
+    order = std::clamp(ambisonicOrder, 1, sh::kMaxOrder);
+    rebuild();
+  }
+  void setDbap(float rolloffDb = 6.0f, float blur = 0.2f) {
+    dbapExponent = rolloffDb / 6.0206f; // gain ~ 1 / d^a
+    dbapBlur2 = blur * blur;
+  }
+
+  // not real-time safe
+  void prepare(int maxSourceCount, int maxFrames) {
+    maxSources = maxSourceCount;
+    blockMax = maxFrames;
+    const std::size_t g = static_cast<std::size_t>(maxSources) * speakers();
+    gainsNow.assign(g, 0.0f);
+    gainsNext.assign(g, 0.0f);
+    sources.assign(maxSources, Source{});
+    ramp.resize(maxFrames);
+    // one accumulator per speaker so speakers can mix in parallel
+    mixStride = simd::padded(static_cast<std::size_t>(std::max(1, maxFrames)));
+    mixBuffer.resize(mixStride * std::max(1, speakers()));
+  }
+
+  int speakers() const { return static_cast<int>(spkChannel.size()); }
+  int capacity() const { return maxSources; }
+
+  // audio thread, before render(). buffer holds framesPerBuffer samples and
+  // must stay valid until render() returns. position is in speaker space
+  void setSource(int i, const float *buffer, float x, float y, float z,
+                 float gain = 1.0f) {
+    if (i < 0 || i >= maxSources) return;
+    Source &s = sources[i];
+    s.buffer = buffer;
+    s.x = x;
+    s.y = y;
+    s.z = z;
+    s.gain = gain;
+    s.active = buffer != nullptr;
+    activeCount = std::max(activeCount, i + 1);
+  }
+  void clearSource(int i) {
+    if (i >= 0 && i < maxSources) sources[i].active = sources[i].started = false;
+  }
+
+  // precomputed gains for a source (e.g. from a trajectory table), skips the
+  // panning law this block. speakers() floats
+  void setSourceGains(int i, const float *buffer, const float *gains) {
+    if (i < 0 || i >= maxSources) return;
+    setSource(i, buffer, 0, 0, 0);
+    sources[i].fixedGains = gains;
+  }
+
+  // the gains render() would use for a source at (x, y, z), speakers()
+  // floats. for precomputing (trajectoryTable.hpp)
+  void gainsFor(float x, float y, float z, float *g, float gain = 1.0f) {
+    Source s;
+    s.x = x;
+    s.y = y;
+    s.z = z;
+    s.gain = gain;
+    computeGains(s, g);
+  }
+
+  // audio thread: adds every active source into io's speaker channels
+  template <class IO> void render(IO &io) {
+    beginBlock(io);
+    for (int i = 0; i < sourceSlots(); ++i) updateGains(i);
+    for (int k = 0; k < mixSpeakers(); ++k) mixSpeaker(k);
+    endBlock();
+  }
+
+  // outs[s] is speaker s's output (speaker order, not device channel order)
+  void render(float *const *outs, int frames) {
+    beginBlock(outs, frames);
+    for (int i = 0; i < sourceSlots(); ++i) updateGains(i);
+    for (int k = 0; k < mixSpeakers(); ++k) mixSpeaker(k);
+    endBlock();
+  }
+
+  // --- render() in pieces, audio thread ---
+
+  template <class IO> void beginBlock(IO &io) {
+    const int n = std::min(speakers(), kMaxSpeakers);
+    for (int s = 0; s < n; ++s) blockOuts[s] = io.outBuffer(spkChannel[s]);
+    beginBlock(blockOuts, io.framesPerBuffer());
+  }
+  void beginBlock(float *const *outs, int frames) {
+    blockFrames = std::min(frames, blockMax);
+    const int n = std::min(speakers(), kMaxSpeakers);
+    if (outs != blockOuts) std::copy(outs, outs + n, blockOuts);
+    blockSources = activeCount;
+    const float inv = 1.0f / std::max(1, blockFrames);
+    for (int f = 0; f < blockFrames; ++f) ramp[f] = (f + 1) * inv;
+  }
+  // source slots and speakers for this block
+  int sourceSlots() const { return blockSources; }
+  int mixSpeakers() const { return std::min(speakers(), kMaxSpeakers); }
+
+  // this block's gains for source slot i. slots are independent
+  void updateGains(int i) {
+    Source &s = sources[i];
+    if (!s.active) return;
+    const int n = mixSpeakers();
+    float *g = &gainsNext[static_cast<std::size_t>(i) * n];
+    if (s.fixedGains) {
+      for (int k = 0; k < n; ++k) g[k] = s.fixedGains[k] * s.gain;
+      s.fixedGains = nullptr;
+    } else {
+      computeGains(s, g);
+    }
+    if (!s.started) {
+      // first block: no ramp from silence at the wrong place
+      std::copy(g, g + n, &gainsNow[static_cast<std::size_t>(i) * n]);
+      s.started = true;
+    }
+  }
+
+  // every source into speaker k, after all updateGains. speakers are
+  // independent: one output accumulates all sources, then is added once
+  void mixSpeaker(int k) {
+    const int n = mixSpeakers(), frames = blockFrames;
+    const int vecFrames = frames / simd::width * simd::width;
+    float *acc = mixBuffer.data + k * mixStride;
+    std::fill(acc, acc + frames, 0.0f);
+    bool any = false;
+    for (int i = 0; i < blockSources; ++i) {
+      const Source &s = sources[i];
+      if (!s.active) continue;
+      const float g0 = gainsNow[static_cast<std::size_t>(i) * n + k];
+      const float g1 = gainsNext[static_cast<std::size_t>(i) * n + k];
+      if (std::fabs(g0) < kSilent && std::fabs(g1) < kSilent) continue;
+      any = true;
+      const simd::floatv vg0(g0), vdg(g1 - g0);
+      const float *in = s.buffer;
+      int f = 0;
+      for (; f < vecFrames; f += simd::width) {
+        const simd::floatv g =
+            simd::fmadd(vdg, simd::floatv::load(ramp.data + f), vg0);
+        simd::fmadd(g, simd::floatv::loadu(in + f), simd::floatv::load(acc + f))
+            .store(acc + f);
+      }
+      for (; f < frames; ++f) acc[f] += (g0 + (g1 - g0) * ramp[f]) * in[f];
+    }
+    if (!any) return;
+    float *o = blockOuts[k];
+    for (int f = 0; f < frames; ++f) o[f] += acc[f];
+  }
+
+  void endBlock() { gainsNow.swap(gainsNext); }
+
+  static constexpr int kMaxSpeakers = 128;
+  static constexpr float kSilent = 1e-5f;
+
+private:
+  struct Source {
+    const float *buffer = nullptr;
+    const float *fixedGains = nullptr;
+    float x = 0, y = 0, z = 0, gain = 1.0f;
+    bool active = false, started = false;
+  };
+
+  void computeGains(const Source &s, float *g) {
+    const int n = speakers();
+    double power = 0.0;
+    if (mode == PanMode::DBAP) {
+      for (int k = 0; k < n; ++k) {
+        const float dx = s.x - spkX[k], dy = s.y - spkY[k], dz = s.z - spkZ[k];
+        const float d2 = dx * dx + dy * dy + dz * dz + dbapBlur2;
+        g[k] = std::pow(d2, -0.5f * dbapExponent);
+        power += double(g[k]) * g[k];
+      }
+    } else {
+      // panning function = speaker SH (pre-weighted in rebuild) . source SH
+      const int nsh = sh::channelsForOrder(order);
+      float y[sh::channelsForOrder(sh::kMaxOrder)];
+      sh::evaluate(order, s.x, s.y, s.z, y);
+      for (int k = 0; k < n; ++k) {
+        const float *row = &decode[static_cast<std::size_t>(k) * nsh];
+        float v = 0.0f;
+        for (int c = 0; c < nsh; ++c) v += row[c] * y[c];
+        g[k] = v;
+        power += double(v) * v;
+      }
+    }
+    // constant power wherever the source is
+    const float norm =
+        power > 1e-20 ? static_cast<float>(s.gain / std::sqrt(power)) : 0.0f;
+    for (int k = 0; k < n; ++k) g[k] *= norm;
+  }
+
+  // speaker SH rows with the max-rE weights folded in (a sampling decoder)
+  void rebuild() {
+    const int n = speakers();
+    const int nsh = sh::channelsForOrder(order);
+    decode.assign(static_cast<std::size_t>(n) * nsh, 0.0f);
+    float w[sh::kMaxOrder + 1];
+    sh::maxReWeights(order, w);
+    for (int k = 0; k < n; ++k) {
+      float *row = &decode[static_cast<std::size_t>(k) * nsh];
+      sh::evaluate(order, spkX[k], spkY[k], spkZ[k], row);
+      for (int l = 0; l <= order; ++l)
+        for (int m = -l; m <= l; ++m) row[l * l + l + m] *= w[l];
+    }
+    if (maxSources) prepare(maxSources, blockMax); // speaker count may change
+  }
+
+  PanMode mode = PanMode::DBAP;
+  int order = 3;
+  float dbapExponent = 1.0f;
+  float dbapBlur2 = 0.04f;
+
+  std::vector<float> spkX, spkY, spkZ;
+  std::vector<int> spkChannel;
+  std::vector<float> decode;
+
+  int maxSources = 0;
+  int blockMax = 0;
+  int activeCount = 0;
+  std::vector<Source> sources;
+  std::vector<float> gainsNow, gainsNext;
+  simd::alignedBuffer ramp, mixBuffer;
+  std::size_t mixStride = 0;
+
+  // the block in flight, set by beginBlock
+  float *blockOuts[kMaxSpeakers] = {};
+  int blockFrames = 0;
+  int blockSources = 0;
+};
@@ -0,0 +1,499 @@
+#pragma once
+
+// headphone monitoring of the sphere's 54.1 program on a laptop: every
+// speaker feed is convolved with the HRIR pair for where that speaker sits,
+// and the ears are summed in the frequency domain, so the whole program is
+// one FFT per feed plus two inverse FFTs per block (fdl:: pieces from
+// partitionedConvolver.hpp).
+//
+// HRIRs come from a wav with two channels (left, right) per speaker in
+// setSpeakers() order. without one, a spherical head model (interaural
+// delay plus head shadow, Brown & Duda 1998) stands in, which is enough to
+// hear left / right / behind.
+//
+// when the callback gets too heavy the renderer collapses to virtual
+// ambisonics: the feeds are encoded to order-N B-format and only the
+// (N+1)^2 SH channels are convolved, with filters that fold a sampling
+// decoder into the HRIRs. order 3 is 16 convolutions instead of 54.
+//
+//   BinauralRenderer binaural;
+//   binaural.setSpeakers(al::AlloSphereSpeakerLayoutCompensated());
+//   binaural.addLfe(47);
+//   binaural.prepare(512, 48000);
+//   onSound: binaural.process(feeds, 60, io.outBuffer(0), io.outBuffer(1), n);
+//
+// n can be anything; buffers that aren't whole blocks cost one block of
+// latency, see process().
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ambisonicDecoder.hpp"
+#include "fft.hpp"
+#include "partitionedConvolver.hpp"
+#include "simdUtility.hpp"
+#include "sphericalHarmonics.hpp"
+#include "wavFile.hpp"
+
+class BinauralRenderer {
+public:
+  enum class Mode { DIRECT, VIRTUAL_AMBISONIC };
+
+  // --- setup, not real-time safe ---
+
+  // any container of speakers with vec() and deviceChannel, like
+  // al::Speakers. feed channel = deviceChannel
+  template <class Speakers> void setSpeakers(const Speakers &speakers) {
+    feeds.clear();
+    for (const auto &s : speakers) {
+      const auto v = s.vec();
+      feeds.push_back(Feed{static_cast<int>(s.deviceChannel),
+                           static_cast<float>(v[0]), static_cast<float>(v[1]),
+                           static_cast<float>(v[2])});
+    }
+  }
+  // a feed with no direction (the .1), sent to both ears
+  void addLfe(int channel, float gain = 0.7071f) {
+    lfes.push_back(Lfe{channel, gain});
+  }
+  // 2 channels per speaker, in setSpeakers() order. call before prepare()
+  bool loadHrirs(const std::string &path) {
+    WavReader r;
+    if (!r.open(path) || r.channels < 2 * static_cast<int>(feeds.size())) {
+      std::cout << "BinauralRenderer: couldnt use " << path
+                << ", using the head model" << std::endl;
+      return false;
+    }
+    hrirTaps = static_cast<int>(std::min<uint64_t>(r.frames, kMaxHrirTaps));
+    std::vector<float> interleaved(static_cast<std::size_t>(hrirTaps) *
+                                   r.channels);
+    hrirTaps = static_cast<int>(r.read(interleaved.data(), hrirTaps));
+    hrirs.assign(feeds.size() * 2 * hrirTaps, 0.0f);
+    for (std::size_t s = 0; s < feeds.size(); ++s)
+      for (int ear = 0; ear < 2; ++ear)
+        for (int i = 0; i < hrirTaps; ++i)
+          hrirs[(s * 2 + ear) * hrirTaps + i] =
+              interleaved[i * r.channels + s * 2 + ear];
+    hrirRate = r.sampleRate;
+    return true;
+  }
+
+  // builds both renderers. block is the device block (a power of two)
+  void prepare(int blockSize, double sampleRate, int ambisonicOrder = 3) {
+    block = blockSize;
+    rate = sampleRate;
+    stride = simd::padded(static_cast<std::size_t>(block + 1));
+    fft.setSize(2 * block);
+    if (hrirs.empty() || hrirRate != static_cast<int>(sampleRate))
+      buildHeadModel();
+    const float scale = 1.0f / (2 * block);
+
+    // direct: one delay line per feed, an HRIR pair each
+    const int n = static_cast<int>(feeds.size());
+    direct.clear();
+    direct.resize(n);
+    for (int s = 0; s < n; ++s) {
+      for (int ear = 0; ear < 2; ++ear)
+        fdl::makeSpectra(fft, block, stride, hrir(s, ear), hrirTaps, scale,
+                         direct[s].ear[ear]);
+      direct[s].line.prepare(block, stride, direct[s].ear[0].parts);
+    }
+
+    // virtual ambisonics: the sampling decoder over the same speakers,
+    // folded into the HRIR spectra so each SH channel has one pair
+    AmbisonicDecoder decoder;
+    decoder.setSpeakers(speakerView());
+    decoder.setOrder(ambisonicOrder);
+    order = decoder.getOrder();
+    const int nsh = decoder.channels();
+    const float *d = decoder.matrix();
+    ambi.clear();
+    ambi.resize(nsh);
+    const int parts = n ? direct[0].ear[0].parts : 0;
+    for (int c = 0; c < nsh; ++c) {
+      for (int ear = 0; ear < 2; ++ear) {
+        fdl::Spectra &g = ambi[c].ear[ear];
+        g.parts = parts;
+        g.re.resize(parts * stride);
+        g.im.resize(parts * stride);
+        g.re.zero();
+        g.im.zero();
+        for (int s = 0; s < n; ++s) {
+          const float w = d[s * nsh + c];
+          const fdl::Spectra &h = direct[s].ear[ear];
+          for (std::size_t k = 0; k < parts * stride; ++k) {
+            g.re.data[k] += w * h.re.data[k];
+            g.im.data[k] += w * h.im.data[k];
+          }
+        }
+      }
+      ambi[c].line.prepare(block, stride, parts);
+    }
+    // encoder: feed s -> SH channel c
+    encode.assign(static_cast<std::size_t>(n) * nsh, 0.0f);
+    for (int s = 0; s < n; ++s)
+      sh::evaluate(order, feeds[s].x, feeds[s].y, feeds[s].z,
+                   &encode[static_cast<std::size_t>(s) * nsh]);
+    matchAmbisonicLevel();
+
+    bformat.resize(static_cast<std::size_t>(nsh) * block);
+    for (auto *b : {&accL, &accR}) b->resize(2 * stride); // re, then im
+    for (auto *b : {&time, &outL, &outR, &fadeL, &fadeR}) b->resize(2 * block);
+    current = Mode::DIRECT;
+    load = 0.0;
+
+    // remainder fifo for buffers that aren't whole blocks
+    fifoChannels = 0;
+    for (const Feed &f : feeds)
+      fifoChannels = std::max(fifoChannels, f.channel + 1);
+    for (const Lfe &l : lfes)
+      fifoChannels = std::max(fifoChannels, l.channel + 1);
+    fifoChannels = std::min(fifoChannels, kMaxChannels);
+    fifoIn.resize(static_cast<std::size_t>(std::max(1, fifoChannels)) * block);
+    for (auto *b : {&fifoL, &fifoR}) {
+      b->resize(block);
+      std::fill(b->data, b->data + block, 0.0f);
+    }
+    fifoFill = 0;
+    buffering = false;
+  }
+
+  // pick a renderer by hand; turns automatic switching off
+  void setMode(Mode m) {
+    automatic = false;
+    requested = m;
+  }
+  // switch to virtual ambisonics when the renderer alone takes more than
+  // `budget` of the block's duration, and back when direct would fit again
+  void setAutomatic(bool on, double budget = 0.5) {
+    automatic = on;
+    loadBudget = budget;
+  }
+  Mode mode() const { return current; }
+  double cpuLoad() const { return load; }
+  int feedCount() const { return static_cast<int>(feeds.size()); }
+
+  // --- audio thread ---
+
+  // in[ch] for every feed / lfe channel below inChannels. writes (not adds)
+  // frames samples to left and right. whole blocks render in place; the
+  // first call that isn't a multiple of the block (a short last buffer, a
+  // backend with its own size) switches to a fifo, and from then on the
+  // output is one block late
+  void process(const float *const *in, int inChannels, float *left,
+               float *right, int frames) {
+    const auto start = std::chrono::steady_clock::now();
+    const int chans = std::min(inChannels, kMaxChannels);
+    if (frames % block) buffering = true;
+    if (!buffering) {
+      for (int f = 0; f < frames; f += block) {
+        const float *blockIn[kMaxChannels];
+        for (int c = 0; c < chans; ++c) blockIn[c] = in[c] + f;
+        processBlock(blockIn, chans, left + f, right + f);
+      }
+    } else {
+      processBuffered(in, chans, left, right, frames);
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    // smoothed share of real time
+    load += 0.05 * (seconds / (frames / rate) - load);
+  }
+
+  static constexpr int kMaxChannels = 128;
+  static constexpr int kMaxHrirTaps = 4096;
+
+private:
+  struct Feed {
+    int channel;
+    float x, y, z;
+  };
+  struct Lfe {
+    int channel;
+    float gain;
+  };
+  struct FeedState {
+    fdl::DelayLine line;
+    fdl::Spectra ear[2];
+  };
+  // setSpeakers()-shaped view of the feeds, for AmbisonicDecoder
+  struct SpeakerView {
+    const Feed *f;
+    const float *vec() const { return &f->x; }
+    int deviceChannel = 0;
+  };
+  std::vector<SpeakerView> speakerView() const {
+    std::vector<SpeakerView> v;
+    for (const Feed &f : feeds) v.push_back(SpeakerView{&f, f.channel});
+    return v;
+  }
+
+  // input collects in fifoIn until it holds a block, which renders into
+  // fifoL / fifoR and is played out while the next block collects
+  void processBuffered(const float *const *in, int chans, float *left,
+                       float *right, int frames) {
+    const int used = std::min(chans, fifoChannels);
+    for (int f = 0; f < frames;) {
+      const int n = std::min(frames - f, block - fifoFill);
+      for (int c = 0; c < used; ++c)
+        std::copy(in[c] + f, in[c] + f + n,
+                  fifoIn.data + static_cast<std::size_t>(c) * block + fifoFill);
+      std::copy(fifoL.data + fifoFill, fifoL.data + fifoFill + n, left + f);
+      std::copy(fifoR.data + fifoFill, fifoR.data + fifoFill + n, right + f);
+      fifoFill += n;
+      f += n;
+      if (fifoFill == block) {
+        const float *blockIn[kMaxChannels];
+        for (int c = 0; c < used; ++c)
+          blockIn[c] = fifoIn.data + static_cast<std::size_t>(c) * block;
+        processBlock(blockIn, used, fifoL.data, fifoR.data);
+        fifoFill = 0;
+      }
+    }
+  }
+
+  const float *hrir(int s, int ear) const {
+    return &hrirs[(static_cast<std::size_t>(s) * 2 + ear) * hrirTaps];
+  }
+
+  void processBlock(const float *const *in, int chans, float *left,
+                    float *right) {
+    Mode target = automatic ? chooseMode() : requested;
+    if (target != current) {
+      // render both this block and fade, the new side's windows primed
+      if (target == Mode::VIRTUAL_AMBISONIC)
+        primeAmbisonic();
+      else
+        primeDirect();
+      render(current, in, chans, fadeL.data, fadeR.data, false);
+      render(target, in, chans, outL.data, outR.data, false);
+      for (int f = 0; f < block; ++f) {
+        const float x = (f + 1.0f) / block;
+        left[f] = outL.data[f] * x + fadeL.data[f] * (1.0f - x);
+        right[f] = outR.data[f] * x + fadeR.data[f] * (1.0f - x);
+      }
+      current = target;
+    } else {
+      render(current, in, chans, left, right, true);
+    }
+    for (const Lfe &l : lfes) {
+      if (l.channel >= chans) continue;
+      const float *x = in[l.channel];
+      for (int f = 0; f < block; ++f) {
+        left[f] += l.gain * x[f];
+        right[f] += l.gain * x[f];
+      }
+    }
+  }
+
+  Mode chooseMode() const {
+    const int nsh = static_cast<int>(ambi.size());
+    if (current == Mode::DIRECT) {
+      return load > loadBudget ? Mode::VIRTUAL_AMBISONIC : Mode::DIRECT;
+    }
+    // back to direct once its estimated cost fits with room to spare
+    const double directLoad = load * feeds.size() / std::max(1, nsh);
+    return directLoad < 0.5 * loadBudget ? Mode::DIRECT
+                                         : Mode::VIRTUAL_AMBISONIC;
+  }
+
+  // neighbouring HRIRs add up coherently at low frequencies, so the decoded
+  // ambisonic path comes out louder than the direct one. scale it so a feed
+  // heard either way carries the same energy on average, otherwise the mode
+  // switch is a level jump
+  void matchAmbisonicLevel() {
+    const int n = static_cast<int>(feeds.size());
+    const int nsh = static_cast<int>(ambi.size());
+    if (n == 0 || nsh == 0) return;
+    const std::size_t bins = static_cast<std::size_t>(ambi[0].ear[0].parts) * stride;
+    double directEnergy = 0.0, ambiEnergy = 0.0;
+    std::vector<float> re(bins), im(bins);
+    for (int s = 0; s < n; ++s) {
+      const float *e = &encode[static_cast<std::size_t>(s) * nsh];
+      for (int ear = 0; ear < 2; ++ear) {
+        std::fill(re.begin(), re.end(), 0.0f);
+        std::fill(im.begin(), im.end(), 0.0f);
+        for (int c = 0; c < nsh; ++c) {
+          const fdl::Spectra &g = ambi[c].ear[ear];
+          for (std::size_t k = 0; k < bins; ++k) {
+            re[k] += e[c] * g.re.data[k];
+            im[k] += e[c] * g.im.data[k];
+          }
+        }
+        const fdl::Spectra &h = direct[s].ear[ear];
+        for (std::size_t k = 0; k < bins; ++k) {
+          directEnergy += h.re.data[k] * h.re.data[k] + h.im.data[k] * h.im.data[k];
+          ambiEnergy += re[k] * re[k] + im[k] * im[k];
+        }
+      }
+    }
+    if (ambiEnergy <= 0.0) return;
+    const float g = static_cast<float>(std::sqrt(directEnergy / ambiEnergy));
+    for (FeedState &st : ambi)
+      for (fdl::Spectra &sp : st.ear)
+        for (std::size_t k = 0; k < bins; ++k) {
+          sp.re.data[k] *= g;
+          sp.im.data[k] *= g;
+        }
+  }
+
+  // slideIdle: in ambisonic mode also slide the direct windows (not while
+  // crossfading, where the direct side renders for real)
+  void render(Mode m, const float *const *in, int chans, float *left,
+              float *right, bool slideIdle) {
+    float *lr = accL.data, *li = accL.data + stride;
+    float *rr = accR.data, *ri = accR.data + stride;
+    std::fill(accL.data, accL.data + 2 * stride, 0.0f);
+    std::fill(accR.data, accR.data + 2 * stride, 0.0f);
+    const int n = static_cast<int>(feeds.size());
+    if (m == Mode::DIRECT) {
+      for (int s = 0; s < n; ++s) {
+        if (feeds[s].channel >= chans) continue;
+        FeedState &st = direct[s];
+        st.line.push(fft, in[feeds[s].channel], block, stride);
+        fdl::multiplyAdd(st.line, st.ear[0], stride, lr, li);
+        fdl::multiplyAdd(st.line, st.ear[1], stride, rr, ri);
+      }
+    } else {
+      encodeBlock(in, chans, false);
+      for (std::size_t c = 0; c < ambi.size(); ++c) {
+        FeedState &st = ambi[c];
+        st.line.push(fft, bformat.data + c * block, block, stride);
+        fdl::multiplyAdd(st.line, st.ear[0], stride, lr, li);
+        fdl::multiplyAdd(st.line, st.ear[1], stride, rr, ri);
+      }
+      // the direct lines keep their windows current for switching back
+      for (int s = 0; s < n && slideIdle; ++s)
+        if (feeds[s].channel < chans)
+          direct[s].line.slide(in[feeds[s].channel], block);
+    }
+    fdl::finish(fft, lr, li, time.data, block, left);
+    fdl::finish(fft, rr, ri, time.data, block, right);
+  }
+
+  // B-format for this block into bformat, from the feeds or, when priming,
+  // from each direct window's last block
+  void encodeBlock(const float *const *in, int chans, bool fromWindows) {
+    const int n = static_cast<int>(feeds.size());
+    const int nsh = static_cast<int>(ambi.size());
+    std::fill(bformat.data, bformat.data + static_cast<std::size_t>(nsh) * block,
+              0.0f);
+    for (int s = 0; s < n; ++s) {
+      const float *x = fromWindows ? direct[s].line.window.data + block
+                       : feeds[s].channel < chans ? in[feeds[s].channel]
+                                                  : nullptr;
+      if (!x) continue;
+      const float *e = &encode[static_cast<std::size_t>(s) * nsh];
+      for (int c = 0; c < nsh; ++c) {
+        if (std::fabs(e[c]) < 1e-6f) continue;
+        const simd::floatv g(e[c]);
+        float *b = bformat.data + static_cast<std::size_t>(c) * block;
+        for (int f = 0; f < block; f += simd::width)
+          simd::fmadd(g, simd::floatv::loadu(x + f), simd::floatv::load(b + f))
+              .store(b + f);
+      }
+    }
+  }
+
+  // ambisonic windows get the last block as the direct side heard it, and
+  // both sides drop spectra older than that
+  void primeAmbisonic() {
+    encodeBlock(nullptr, 0, true);
+    for (std::size_t c = 0; c < ambi.size(); ++c) {
+      fdl::DelayLine &l = ambi[c].line;
+      l.clearHistory();
+      std::copy(bformat.data + c * block, bformat.data + (c + 1) * block,
+                l.window.data + block);
+    }
+  }
+  void primeDirect() {
+    for (FeedState &st : direct) st.line.clearHistory();
+  }
+
+  // spherical head: per ear a head-shadow shelf and the Woodworth delay,
+  // built in the frequency domain
+  void buildHeadModel() {
+    int taps = 64;
+    while (taps < 0.005 * rate) taps *= 2;
+    hrirTaps = taps;
+    hrirRate = static_cast<int>(rate);
+    const int n = static_cast<int>(feeds.size());
+    hrirs.assign(static_cast<std::size_t>(n) * 2 * taps, 0.0f);
+    RealFft model(2 * taps);
+    std::vector<float> re(taps + 1), im(taps + 1), ir(2 * taps);
+    const double a = 0.0875, c = 343.0, w0 = c / a;
+    const double pi = 3.14159265358979323846;
+    for (int s = 0; s < n; ++s) {
+      const Feed &fd = feeds[s];
+      const double len =
+          std::sqrt(double(fd.x) * fd.x + double(fd.y) * fd.y + double(fd.z) * fd.z);
+      for (int ear = 0; ear < 2; ++ear) {
+        // ears on -x (left) and +x (right)
+        const double cosT =
+            len > 0 ? std::clamp((ear ? fd.x : -fd.x) / len, -1.0, 1.0) : 0.0;
+        const double theta = std::acos(cosT);
+        const double alpha = 1.05 + 0.95 * std::cos(theta * 180.0 / 150.0);
+        const double tau = theta < pi / 2 ? -(a / c) * cosT
+                                          : (a / c) * (theta - pi / 2);
+        const double delay = 8.0 + (tau + a / c) * rate; // samples, causal
+        for (int k = 0; k <= taps; ++k) {
+          const double w = pi * k / taps; // radians per sample
+          const double wHz = w * rate;
+          // (1 + j alpha w / 2w0) / (1 + j w / 2w0)
+          const double nr = 1.0, ni = alpha * wHz / (2 * w0);
+          const double dr = 1.0, di = wHz / (2 * w0);
+          const double den = dr * dr + di * di;
+          const double hr = (nr * dr + ni * di) / den;
+          const double hi = (ni * dr - nr * di) / den;
+          const double pr = std::cos(-w * delay), pim = std::sin(-w * delay);
+          re[k] = static_cast<float>(hr * pr - hi * pim);
+          im[k] = static_cast<float>(hr * pim + hi * pr);
+        }
+        im[0] = im[taps] = 0.0f;
+        model.inverse(re.data(), im.data(), ir.data());
+        float *out = &hrirs[(static_cast<std::size_t>(s) * 2 + ear) * taps];
+        const int fade = taps / 4;
+        for (int i = 0; i < taps; ++i) {
+          const float win =
+              i < taps - fade
+                  ? 1.0f
+                  : 0.5f + 0.5f * static_cast<float>(std::cos(
+                                      pi * (i - (taps - fade)) / fade));
+          out[i] = ir[i] / (2 * taps) * win;
+        }
+      }
+    }
+  }
+
+  std::vector<Feed> feeds;
+  std::vector<Lfe> lfes;
+  std::vector<float> hrirs; // feed x ear x taps
+  int hrirTaps = 0;
+  int hrirRate = 0;
+
+  int block = 512;
+  double rate = 48000.0;
+  std::size_t stride = 528;
+  int order = 3;
+  RealFft fft;
+  std::vector<FeedState> direct, ambi;
+  std::vector<float> encode; // feeds x SH channels
+  simd::alignedBuffer bformat, accL, accR, time, outL, outR, fadeL, fadeR;
+  simd::alignedBuffer fifoIn, fifoL, fifoR; // channels x block, block, block
+  int fifoChannels = 0;
+  int fifoFill = 0;
+  bool buffering = false;
+
+  Mode current = Mode::DIRECT;
+  Mode requested = Mode::DIRECT;
+  bool automatic = true;
+  double loadBudget = 0.5;
+  double load = 0.0;
+};
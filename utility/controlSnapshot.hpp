@@ -0,0 +1,144 @@
+#pragma once
+
+// getting control values (scene index, running, gains...) to the audio thread
+// without it ever touching a Parameter, mutex or OSC-written value directly.
+//
+// ControlSnapshot<T> is a triple buffer: writers fill a whole T and publish
+// it, the audio thread picks up the latest complete T once per block. the
+// reader side is wait-free; writers serialize on a mutex, which is fine
+// because none of them are real-time.
+//
+// SceneCrossfade renders a scene change as a short equal-power crossfade
+// between the outgoing and incoming renderers, so switching at a block
+// boundary never clicks.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+template <class T> class ControlSnapshot {
+public:
+  ControlSnapshot() = default;
+  explicit ControlSnapshot(const T &initial) {
+    for (auto &s : slots) s = initial;
+  }
+
+  // any non-real-time thread
+  void publish(const T &value) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    slots[back] = value;
+    // hand the filled slot to the middle, take the old middle as next back
+    const uint8_t prev =
+        middle.exchange(static_cast<uint8_t>(back | kFresh),
+                        std::memory_order_acq_rel);
+    back = prev & kIndex;
+  }
+
+  // audio thread, once per block. returns the newest published value; the
+  // reference stays valid and unchanged until the next acquire()
+  const T &acquire() {
+    if (middle.load(std::memory_order_relaxed) & kFresh) {
+      const uint8_t prev =
+          middle.exchange(front, std::memory_order_acq_rel);
+      front = prev & kIndex;
+    }
+    return slots[front];
+  }
+
+  // last acquired value, audio thread only
+  const T &current() const { return slots[front]; }
+
+private:
+  static constexpr uint8_t kIndex = 3;
+  static constexpr uint8_t kFresh = 4;
+
+  T slots[3]{};
+  alignas(64) std::atomic<uint8_t> middle{1};
+  alignas(64) uint8_t front = 0; // reader only
+  alignas(64) uint8_t back = 2;  // writers only, under writeMutex
+  std::mutex writeMutex;
+};
+
+class SceneCrossfade {
+public:
+  // not real-time safe, sizes the scratch buffers
+  void prepare(int channels, int maxFrames, double sampleRate,
+               double fadeSeconds = 0.02) {
+    scratch.assign(static_cast<std::size_t>(channels) * maxFrames, 0.0f);
+    rampIn.assign(maxFrames, 0.0f);
+    rampOut.assign(maxFrames, 0.0f);
+    numChannels = channels;
+    blockMax = maxFrames;
+    fadeFrames = std::max(1, static_cast<int>(fadeSeconds * sampleRate));
+  }
+
+  int scene() const { return currentScene; }
+  bool fading() const { return fadeFrom >= 0; }
+
+  // audio thread, once per block with the snapshot's scene. render(scene, io)
+  // must add that scene's output into io's out buffers. during a fade both
+  // scenes render: the incoming one into scratch, the outgoing one in place
+  template <class IO, class Render>
+  void process(IO &io, int targetScene, Render &&render) {
+    if (targetScene != currentScene) {
+      // a change mid-fade restarts from whatever was fading in
+      fadeFrom = currentScene;
+      currentScene = targetScene;
+      fadePos = 0;
+    }
+    const int frames = io.framesPerBuffer();
+    const int chans = std::min<int>(io.channelsOut(), numChannels);
+    if (fadeFrom < 0 || frames > blockMax) {
+      fadeFrom = -1;
+      render(currentScene, io);
+      return;
+    }
+
+    // equal power, so uncorrelated scenes don't dip in the middle
+    for (int f = 0; f < frames; ++f) {
+      const float x =
+          std::min(1.0f, static_cast<float>(fadePos + f) / fadeFrames);
+      rampIn[f] = std::sin(x * 1.57079632679f);
+      rampOut[f] = std::cos(x * 1.57079632679f);
+    }
+
+    // incoming scene, faded in, parked in scratch
+    clear(io, chans, frames);
+    render(currentScene, io);
+    for (int c = 0; c < chans; ++c) {
+      const float *o = io.outBuffer(c);
+      float *s = &scratch[static_cast<std::size_t>(c) * blockMax];
+      for (int f = 0; f < frames; ++f) s[f] = o[f] * rampIn[f];
+    }
+    // outgoing scene, faded out, then sum
+    clear(io, chans, frames);
+    render(fadeFrom, io);
+    for (int c = 0; c < chans; ++c) {
+      float *o = io.outBuffer(c);
+      const float *s = &scratch[static_cast<std::size_t>(c) * blockMax];
+      for (int f = 0; f < frames; ++f)
+        o[f] = o[f] * rampOut[f] + s[f];
+    }
+    fadePos += frames;
+    if (fadePos >= fadeFrames) fadeFrom = -1;
+  }
+
+private:
+  template <class IO> static void clear(IO &io, int chans, int frames) {
+    for (int c = 0; c < chans; ++c) {
+      float *o = io.outBuffer(c);
+      std::fill(o, o + frames, 0.0f);
+    }
+  }
+
+  std::vector<float> scratch, rampIn, rampOut;
+  int numChannels = 0;
+  int blockMax = 0;
+  int fadeFrames = 1;
+  int currentScene = 0;
+  int fadeFrom = -1;
+  int fadePos = 0;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+// power-of-two real FFT on split (re[], im[]) arrays, for block convolution.
+//
+// a real n point transform is a complex n/2 point Stockham FFT (no bit
+// reversal pass, ping-pongs between two buffers) plus the usual split step.
+// stages whose butterfly stride is at least simd::width run on simd::floatv;
+// the first few, with stride 1-4, are scalar. the spectrum is n/2 + 1 bins,
+// unnormalized: inverse(forward(x)) == n * x.
+//
+//   RealFft fft(1024);
+//   fft.forward(samples, re, im);     // 513 bins
+//   fft.inverse(re, im, samples);     // scaled by 1024
+
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "simdUtility.hpp"
+
+class RealFft {
+public:
+  RealFft() = default;
+  explicit RealFft(int n) { setSize(n); }
+
+  // not real-time safe. n is a power of two, at least 4
+  void setSize(int n) {
+    size = n;
+    half = n / 2;
+    stages.clear();
+    // complex n/2 Stockham: stage k has length len = half >> k, stride s
+    for (int len = half, s = 1; len > 1; len /= 2, s *= 2) {
+      Stage st;
+      st.len = len;
+      st.stride = s;
+      const int m = len / 2;
+      st.wr.resize(m);
+      st.wi.resize(m);
+      for (int p = 0; p < m; ++p) {
+        const double a = 2.0 * kPi * p / len;
+        st.wr[p] = static_cast<float>(std::cos(a));
+        st.wi[p] = static_cast<float>(-std::sin(a));
+      }
+      stages.push_back(std::move(st));
+    }
+    // split step twiddles, e^(-2 pi i k / n)
+    splitR.resize(half + 1);
+    splitI.resize(half + 1);
+    for (int k = 0; k <= half; ++k) {
+      const double a = 2.0 * kPi * k / n;
+      splitR[k] = static_cast<float>(std::cos(a));
+      splitI[k] = static_cast<float>(-std::sin(a));
+    }
+    for (auto *b : {&ar, &ai, &br, &bi}) {
+      b->resize(half);
+      b->zero();
+    }
+  }
+
+  int getSize() const { return size; }
+  int bins() const { return half + 1; }
+
+  // n real samples in, bins() complex bins out
+  void forward(const float *in, float *re, float *im) {
+    // even samples as real part, odd as imaginary
+    for (int i = 0; i < half; ++i) {
+      ar.data[i] = in[2 * i];
+      ai.data[i] = in[2 * i + 1];
+    }
+    const bool inB = transform();
+    const float *zr = inB ? br.data : ar.data;
+    const float *zi = inB ? bi.data : ai.data;
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[half] = zr[0] - zi[0];
+    im[half] = 0.0f;
+    for (int k = 1; k < half; ++k) {
+      const int j = half - k;
+      // even / odd spectra from Z[k] and conj(Z[n/2 - k])
+      const float er = 0.5f * (zr[k] + zr[j]), ei = 0.5f * (zi[k] - zi[j]);
+      const float or_ = 0.5f * (zi[k] + zi[j]), oi = -0.5f * (zr[k] - zr[j]);
+      const float wr = splitR[k], wi = splitI[k];
+      re[k] = er + (or_ * wr - oi * wi);
+      im[k] = ei + (or_ * wi + oi * wr);
+    }
+  }
+
+  // bins() complex bins in, n real samples out (times n)
+  void inverse(const float *re, const float *im, float *out) {
+    // rebuild Z[k] = E[k] + i O[k], then an inverse complex FFT via
+    // conjugation: ifft(z) = conj(fft(conj(z)))
+    for (int k = 0; k < half; ++k) {
+      const int j = half - k;
+      const float er = re[k] + re[j], ei = im[k] - im[j];
+      const float dr = re[k] - re[j], di = im[k] + im[j];
+      // O[k] = (X[k] - conj X[n/2-k]) * e^(+2 pi i k / n)
+      const float wr = splitR[k], wi = -splitI[k];
+      const float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+      // Z = E + i O, conjugated for the forward transform
+      ar.data[k] = er - oi;
+      ai.data[k] = -(ei + or_);
+    }
+    const bool inB = transform();
+    const float *zr = inB ? br.data : ar.data;
+    const float *zi = inB ? bi.data : ai.data;
+    for (int i = 0; i < half; ++i) {
+      out[2 * i] = zr[i];
+      out[2 * i + 1] = -zi[i];
+    }
+  }
+
+private:
+  struct Stage {
+    int len, stride;
+    std::vector<float> wr, wi;
+  };
+
+  // complex FFT of a{r,i}, returns true if the result landed in b{r,i}
+  bool transform() {
+    float *xr = ar.data, *xi = ai.data, *yr = br.data, *yi = bi.data;
+    bool inB = false;
+    for (const Stage &st : stages) {
+      const int m = st.len / 2, s = st.stride;
+      if (s >= simd::width) {
+        for (int p = 0; p < m; ++p) {
+          const simd::floatv wr(st.wr[p]), wi(st.wi[p]);
+          const float *ar0 = xr + s * p, *ai0 = xi + s * p;
+          const float *br0 = xr + s * (p + m), *bi0 = xi + s * (p + m);
+          float *y0r = yr + s * 2 * p, *y0i = yi + s * 2 * p;
+          float *y1r = y0r + s, *y1i = y0i + s;
+          for (int q = 0; q < s; q += simd::width) {
+            const simd::floatv a_r = simd::floatv::load(ar0 + q);
+            const simd::floatv a_i = simd::floatv::load(ai0 + q);
+            const simd::floatv b_r = simd::floatv::load(br0 + q);
+            const simd::floatv b_i = simd::floatv::load(bi0 + q);
+            (a_r + b_r).store(y0r + q);
+            (a_i + b_i).store(y0i + q);
+            const simd::floatv dr = a_r - b_r, di = a_i - b_i;
+            (dr * wr - di * wi).store(y1r + q);
+            (dr * wi + di * wr).store(y1i + q);
+          }
+        }
+      } else {
+        for (int p = 0; p < m; ++p) {
+          const float wr = st.wr[p], wi = st.wi[p];
+          for (int q = 0; q < s; ++q) {
+            const float a_r = xr[q + s * p], a_i = xi[q + s * p];
+            const float b_r = xr[q + s * (p + m)], b_i = xi[q + s * (p + m)];
+            yr[q + s * 2 * p] = a_r + b_r;
+            yi[q + s * 2 * p] = a_i + b_i;
+            const float dr = a_r - b_r, di = a_i - b_i;
+            yr[q + s * (2 * p + 1)] = dr * wr - di * wi;
+            yi[q + s * (2 * p + 1)] = dr * wi + di * wr;
+          }
+        }
+      }
+      std::swap(xr, yr);
+      std::swap(xi, yi);
+      inB = !inB;
+    }
+    return inB;
+  }
+
+  static constexpr double kPi = 3.14159265358979323846;
+
+  int size = 0, half = 0;
+  std::vector<Stage> stages;
+  std::vector<float> splitR, splitI;
+  simd::alignedBuffer ar, ai, br, bi;
+};
@@ -0,0 +1,351 @@
+#pragma once
+
+// where a node's frame goes. named phases (animate, state sync, each
+// scene's draw, shader passes) are timed on the cpu with scopes and, when
+// GL is included first, on the gpu with timestamp queries around the same
+// scopes. every frame becomes one CSV row and goes into a rolling window,
+// which keeps p50 / p99 / max per phase for print() and the overlay.
+//
+//   FrameProfiler frames;
+//   int animate = frames.addPhase("animate");
+//   int sceneDraw = frames.addPhase("scene 1");
+//   frames.openCsv("frameTiming.csv");
+//   onAnimate: frames.beginFrame(); auto t = frames.cpu(animate); ...
+//   onDraw:    auto t = frames.cpuGpu(sceneDraw); ...
+//
+// phases can nest and repeat: a phase's time in a frame is the sum of its
+// scopes, so the 6 cube faces of an omni render add up into one draw.
+//
+// gpu timestamps are read kLatency frames later, only if the driver has
+// them by then, so the profiler never stalls the pipeline. a frame whose
+// queries aren't ready just has no gpu numbers. everything here runs on
+// the graphics thread.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(GL_TIMESTAMP)
+#define FRAME_PROFILER_GL 1
+#else
+#define FRAME_PROFILER_GL 0
+#endif
+
+class FrameProfiler {
+  using clock = std::chrono::steady_clock;
+
+public:
+  static constexpr int kMaxPhases = 24;
+  static constexpr int kWindow = 240; // frames in the rolling stats
+  static constexpr int kLatency = 3;  // frames before gpu results are read
+  static constexpr int kQueriesPerFrame = 256;
+
+  struct Stats {
+    double p50 = 0, p99 = 0, max = 0; // ms
+    int frames = 0;                  // frames in the window that ran it
+  };
+
+  FrameProfiler() = default;
+  FrameProfiler(const FrameProfiler &) = delete;
+  FrameProfiler &operator=(const FrameProfiler &) = delete;
+  ~FrameProfiler() { closeCsv(); }
+
+  // --- setup ---
+
+  // returns the phase's index. at most kMaxPhases
+  int addPhase(const std::string &name) {
+    if (static_cast<int>(names.size()) >= kMaxPhases) return kMaxPhases - 1;
+    names.push_back(name);
+    for (Slot &s : slots) s.clear(phaseCount());
+    cpuWindow.assign(phaseCount(), std::vector<float>(kWindow, -1.0f));
+    gpuWindow = cpuWindow;
+    return phaseCount() - 1;
+  }
+  int phaseCount() const { return static_cast<int>(names.size()); }
+  const std::string &name(int phase) const { return names[phase]; }
+
+  // the bars in the overlay are drawn against this
+  void setBudgetMs(double ms) { budgetMs = ms; }
+  double budget() const { return budgetMs; }
+
+  // one row per frame: frame, interval, then every phase's cpu and gpu ms.
+  // empty cells for phases that didn't run
+  bool openCsv(const std::string &path) {
+    closeCsv();
+    csv = std::fopen(path.c_str(), "w");
+    if (!csv) {
+      std::printf("FrameProfiler: couldnt open %s\n", path.c_str());
+      return false;
+    }
+    std::fprintf(csv, "frame,interval_ms");
+    for (const std::string &n : names) std::fprintf(csv, ",%s cpu_ms", n.c_str());
+    for (const std::string &n : names) std::fprintf(csv, ",%s gpu_ms", n.c_str());
+    std::fprintf(csv, "\n");
+    return true;
+  }
+  void closeCsv() {
+    if (csv) std::fclose(csv);
+    csv = nullptr;
+  }
+
+  // --- per frame ---
+
+  // once per frame, before anything is timed (top of onAnimate). retires
+  // the frame from kLatency frames ago
+  void beginFrame() {
+    const auto now = clock::now();
+    const double interval =
+        frameIndex ? std::chrono::duration<double, std::milli>(now - frameStart)
+                         .count()
+                   : 0.0;
+    frameStart = now;
+    if (frameIndex) current().intervalMs = interval;
+    ++frameIndex;
+    Slot &s = current();
+    if (s.frame) retire(s);
+    s.clear(phaseCount());
+    s.frame = frameIndex;
+  }
+
+  class Scope {
+  public:
+    Scope(FrameProfiler *p, int phase, bool gpu)
+        : prof(p), phase(phase), start(clock::now()) {
+      if (gpu) query = prof->gpuMark(phase);
+    }
+    Scope(Scope &&o) noexcept
+        : prof(o.prof), phase(o.phase), start(o.start), query(o.query) {
+      o.prof = nullptr;
+    }
+    Scope(const Scope &) = delete;
+    ~Scope() {
+      if (!prof) return;
+      Slot &s = prof->current();
+      s.cpuMs[phase] +=
+          std::chrono::duration<double, std::milli>(clock::now() - start)
+              .count();
+      s.ranCpu[phase] = true;
+      if (query >= 0) prof->gpuMark(phase, query);
+    }
+
+  private:
+    FrameProfiler *prof;
+    int phase;
+    clock::time_point start;
+    int query = -1;
+  };
+
+  // cpu time of phase over the scope
+  Scope cpu(int phase) { return Scope(this, phase, false); }
+  // cpu time, and gpu time of the GL commands issued in the scope
+  Scope cpuGpu(int phase) { return Scope(this, phase, FRAME_PROFILER_GL); }
+
+  // --- readers ---
+
+  uint64_t frames() const { return frameIndex; }
+  // frames whose gpu results weren't ready after kLatency frames
+  uint64_t gpuDropped() const { return dropped; }
+
+  // over the last kWindow retired frames. gpu stats stay empty without GL
+  Stats cpuStats(int phase) const { return stats(cpuWindow[phase]); }
+  Stats gpuStats(int phase) const { return stats(gpuWindow[phase]); }
+  Stats intervalStats() const { return stats(intervalWindow); }
+
+  void print(std::ostream &out) const {
+    char line[160];
+    const Stats iv = intervalStats();
+    std::snprintf(line, sizeof line,
+                  "frame interval p50 %.2f p99 %.2f max %.2f ms (budget %.2f)\n",
+                  iv.p50, iv.p99, iv.max, budgetMs);
+    out << line;
+    std::snprintf(line, sizeof line, "%-14s %8s %8s %8s %8s %8s %8s\n",
+                  "phase", "cpu p50", "p99", "max", "gpu p50", "p99", "max");
+    out << line;
+    for (int p = 0; p < phaseCount(); ++p) {
+      const Stats c = cpuStats(p), g = gpuStats(p);
+      if (!c.frames && !g.frames) continue;
+      std::snprintf(line, sizeof line,
+                    "%-14s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+                    names[p].c_str(), c.p50, c.p99, c.max, g.p50, g.p99, g.max);
+      out << line;
+    }
+    if (dropped) out << dropped << " frames without gpu results" << std::endl;
+  }
+
+  // one row per phase across the top of the window, as triangles in
+  // normalized device coordinates: a dark bar for the budget, cpu p50 in
+  // blue with a white tick at p99, gpu p50 in orange beneath it. the
+  // phases' rows are in addPhase order, as in print()
+  template <class Mesh> void buildOverlay(Mesh &mesh) const {
+    mesh.reset();
+    const int n = phaseCount();
+    if (n == 0) return;
+    const float x0 = -0.95f, width = 0.9f, top = 0.95f;
+    const float row = std::min(0.08f, 0.9f / n);
+    auto quad = [&](float a, float y0, float b, float y1, float r, float g,
+                    float bl, float al) {
+      mesh.vertex(a, y0);
+      mesh.vertex(b, y0);
+      mesh.vertex(b, y1);
+      mesh.vertex(a, y0);
+      mesh.vertex(b, y1);
+      mesh.vertex(a, y1);
+      for (int i = 0; i < 6; ++i) mesh.color(r, g, bl, al);
+    };
+    auto x = [&](double ms) {
+      return x0 + width * static_cast<float>(std::min(ms / budgetMs, 1.5)) /
+                      1.5f;
+    };
+    const float budgetX = x(budgetMs);
+    for (int p = 0; p < n; ++p) {
+      const float y1 = top - p * row, y0 = y1 - 0.85f * row;
+      const float mid = 0.5f * (y0 + y1);
+      const Stats c = cpuStats(p), g = gpuStats(p);
+      quad(x0, y0, x0 + width, y1, 0.1f, 0.1f, 0.1f, 0.6f);
+      quad(x0, mid, x(c.p50), y1, 0.3f, 0.5f, 1.0f, 0.9f);
+      const float t = x(c.p99);
+      quad(t - 0.002f, mid, t + 0.002f, y1, 1.0f, 1.0f, 1.0f, 1.0f);
+      if (g.frames) quad(x0, y0, x(g.p50), mid, 1.0f, 0.6f, 0.2f, 0.9f);
+    }
+    // the budget line through every row
+    quad(budgetX - 0.002f, top - n * row, budgetX + 0.002f, top, 1.0f, 0.2f,
+         0.1f, 1.0f);
+  }
+
+private:
+  struct Slot {
+    uint64_t frame = 0;
+    double intervalMs = 0;
+    double cpuMs[kMaxPhases];
+    bool ranCpu[kMaxPhases];
+    // query pairs this frame, and which phase each belongs to
+    int queries = 0;
+    int queryPhase[kQueriesPerFrame / 2];
+    void clear(int phases) {
+      frame = 0;
+      intervalMs = 0;
+      queries = 0;
+      std::fill(cpuMs, cpuMs + phases, 0.0);
+      std::fill(ranCpu, ranCpu + phases, false);
+    }
+  };
+
+  Slot &current() { return slots[frameIndex % slots.size()]; }
+
+#if FRAME_PROFILER_GL
+  // a timestamp at the start of the scope: returns the pair's index, or
+  // -1 when this frame's queries are used up
+  int gpuMark(int phase) {
+    Slot &s = current();
+    const std::size_t slot = frameIndex % slots.size();
+    if (queryIds[slot].empty()) {
+      queryIds[slot].resize(kQueriesPerFrame);
+      glGenQueries(kQueriesPerFrame, queryIds[slot].data());
+    }
+    if (s.queries >= kQueriesPerFrame / 2) return -1;
+    const int pair = s.queries++;
+    s.queryPhase[pair] = phase;
+    glQueryCounter(queryIds[slot][2 * pair], GL_TIMESTAMP);
+    return pair;
+  }
+  // and at its end
+  void gpuMark(int, int pair) {
+    const std::size_t slot = frameIndex % slots.size();
+    glQueryCounter(queryIds[slot][2 * pair + 1], GL_TIMESTAMP);
+  }
+  // true with ms filled in when every query of the slot has landed
+  bool gpuResults(const Slot &s, double *ms) {
+    std::fill(ms, ms + phaseCount(), -1.0);
+    if (s.queries == 0) return true;
+    const std::vector<GLuint> &ids = queryIds[&s - slots.data()];
+    GLint ready = 0;
+    glGetQueryObjectiv(ids[2 * s.queries - 1], GL_QUERY_RESULT_AVAILABLE,
+                       &ready);
+    if (!ready) return false;
+    for (int q = 0; q < s.queries; ++q) {
+      GLuint64 a = 0, b = 0;
+      glGetQueryObjectui64v(ids[2 * q], GL_QUERY_RESULT, &a);
+      glGetQueryObjectui64v(ids[2 * q + 1], GL_QUERY_RESULT, &b);
+      double &m = ms[s.queryPhase[q]];
+      m = std::max(m, 0.0) + (b > a ? (b - a) * 1e-6 : 0.0);
+    }
+    return true;
+  }
+#else
+  int gpuMark(int) { return -1; }
+  void gpuMark(int, int) {}
+  bool gpuResults(const Slot &, double *ms) {
+    std::fill(ms, ms + phaseCount(), -1.0);
+    return true;
+  }
+#endif
+
+  // the slot's frame is done on the cpu, and kLatency frames old on the gpu
+  void retire(Slot &s) {
+    double gpuMs[kMaxPhases];
+    if (!gpuResults(s, gpuMs)) {
+      ++dropped;
+      std::fill(gpuMs, gpuMs + phaseCount(), -1.0);
+    }
+    const int w = static_cast<int>(retired++ % kWindow);
+    intervalWindow[w] = static_cast<float>(s.intervalMs);
+    for (int p = 0; p < phaseCount(); ++p) {
+      cpuWindow[p][w] = s.ranCpu[p] ? static_cast<float>(s.cpuMs[p]) : -1.0f;
+      gpuWindow[p][w] = static_cast<float>(gpuMs[p]);
+    }
+    if (!csv) return;
+    std::fprintf(csv, "%llu,%.3f", static_cast<unsigned long long>(s.frame),
+                 s.intervalMs);
+    for (int p = 0; p < phaseCount(); ++p) {
+      if (s.ranCpu[p])
+        std::fprintf(csv, ",%.3f", s.cpuMs[p]);
+      else
+        std::fputs(",", csv);
+    }
+    for (int p = 0; p < phaseCount(); ++p) {
+      if (gpuMs[p] >= 0)
+        std::fprintf(csv, ",%.3f", gpuMs[p]);
+      else
+        std::fputs(",", csv);
+    }
+    std::fputs("\n", csv);
+  }
+
+  // negative entries are frames the phase didn't run in
+  static Stats stats(const std::vector<float> &window) {
+    std::vector<float> v;
+    v.reserve(window.size());
+    for (float x : window)
+      if (x >= 0) v.push_back(x);
+    Stats s;
+    s.frames = static_cast<int>(v.size());
+    if (v.empty()) return s;
+    auto at = [&](double p) {
+      const std::size_t k =
+          std::min(v.size() - 1, static_cast<std::size_t>(p * v.size()));
+      std::nth_element(v.begin(), v.begin() + k, v.end());
+      return static_cast<double>(v[k]);
+    };
+    s.p50 = at(0.5);
+    s.p99 = at(0.99);
+    s.max = *std::max_element(v.begin(), v.end());
+    return s;
+  }
+
+  std::vector<std::string> names;
+  double budgetMs = 1000.0 / 60.0;
+  // the frame being recorded, and the kLatency before it waiting on the gpu
+  std::vector<Slot> slots = std::vector<Slot>(kLatency + 1);
+#if FRAME_PROFILER_GL
+  std::vector<GLuint> queryIds[kLatency + 1];
+#endif
+  uint64_t frameIndex = 0, retired = 0, dropped = 0;
+  clock::time_point frameStart;
+  std::vector<std::vector<float>> cpuWindow, gpuWindow;
+  std::vector<float> intervalWindow = std::vector<float>(kWindow, -1.0f);
+  std::FILE *csv = nullptr;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+// per-channel peak / RMS / clip metering of the outputs, for the GUI and
+// OSC. the audio thread does one simd pass over each output per block (and
+// applies the master gain in the same pass, so metering costs no extra
+// trip through memory), then drops a small MeterBlock into an SpscRing. a
+// non-real-time thread polls the ring, integrates RMS, holds peaks and
+// counts clips. a consumer that stops polling just makes the audio thread's
+// writes fail; nothing waits.
+//
+//   LevelMeter meter;
+//   meter.prepare(60, 48000);                 // setup
+//   onSound: meter.process(io, outputGain);   // last stage before the device
+//   onAnimate: meter.poll();  meter.rms(c), meter.peak(c), meter.clips(c)
+//              meter.sendOsc(oscSend);
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simdUtility.hpp"
+#include "spscRing.hpp"
+
+class LevelMeter {
+public:
+  static constexpr int kMaxChannels = 128;
+
+  // what one callback saw, audio thread -> poller
+  struct MeterBlock {
+    int channels = 0;
+    int frames = 0;
+    float peak[kMaxChannels];
+    float sumSquares[kMaxChannels];
+    uint32_t clips[kMaxChannels];
+  };
+
+  // not real-time safe
+  void prepare(int channelCount, double sampleRate, int ringBlocks = 64) {
+    channels = std::min(channelCount, kMaxChannels);
+    rate = sampleRate;
+    ring.reset(ringBlocks);
+    rmsNow.assign(channels, 0.0f);
+    peakHeld.assign(channels, 0.0f);
+    clipTotal.assign(channels, 0);
+    peakHeldFor.assign(channels, 0.0);
+  }
+
+  // samples above this count as clipped (default: full scale)
+  void setClipLevel(float level) { clipLevel = level; }
+  // RMS integration time and how long a peak holds before falling
+  void setBallistics(double rmsSeconds, double holdSeconds) {
+    rmsTime = rmsSeconds;
+    holdTime = holdSeconds;
+  }
+
+  // --- audio thread ---
+
+  // scales io's outputs by gain in place and meters the result. gain moves
+  // linearly over the block when it changes
+  template <class IO> void process(IO &io, float gain = 1.0f) {
+    float *bufs[kMaxChannels];
+    const int n = std::min<int>(static_cast<int>(io.channelsOut()), channels);
+    for (int c = 0; c < n; ++c) bufs[c] = io.outBuffer(c);
+    process(bufs, n, io.framesPerBuffer(), gain);
+  }
+
+  void process(float *const *bufs, int n, int frames, float gain = 1.0f) {
+    n = std::min(n, channels);
+    MeterBlock &b = scratch;
+    b.channels = n;
+    b.frames = frames;
+    const float g0 = lastGain, dg = (gain - g0) / std::max(1, frames);
+    const bool ramp = gain != g0;
+    lastGain = gain;
+    const int vecFrames = frames / simd::width * simd::width;
+    const simd::floatv clipAt(clipLevel), one(1.0f), zero(0.0f);
+    for (int c = 0; c < n; ++c) {
+      float *x = bufs[c];
+      simd::floatv peak(0.0f), sum(0.0f), clips(0.0f);
+      int f = 0;
+      if (!ramp) {
+        const simd::floatv g(gain);
+        for (; f < vecFrames; f += simd::width) {
+          const simd::floatv v = simd::floatv::loadu(x + f) * g;
+          v.storeu(x + f);
+          const simd::floatv a = simd::abs(v);
+          peak = simd::max(peak, a);
+          sum = simd::fmadd(v, v, sum);
+          clips += simd::select(simd::greater(a, clipAt), one, zero);
+        }
+      }
+      float pk = simd::hmax(peak), s = simd::hsum(sum),
+            cl = simd::hsum(clips);
+      for (; f < frames; ++f) {
+        const float v = x[f] * (ramp ? g0 + dg * (f + 1) : gain);
+        x[f] = v;
+        const float a = std::fabs(v);
+        pk = std::max(pk, a);
+        s += v * v;
+        cl += a > clipLevel ? 1.0f : 0.0f;
+      }
+      b.peak[c] = pk;
+      b.sumSquares[c] = s;
+      b.clips[c] = static_cast<uint32_t>(cl);
+    }
+    if (ring.write(&b, 1) == 0)
+      dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // --- consumer (GUI / OSC thread) ---
+
+  // drains everything published since the last poll. returns blocks read
+  int poll() {
+    MeterBlock b;
+    int got = 0;
+    while (ring.read(&b, 1) == 1) {
+      ++got;
+      const double dt = b.frames / rate;
+      const float k = static_cast<float>(1.0 - std::exp(-dt / rmsTime));
+      for (int c = 0; c < b.channels && c < channels; ++c) {
+        const float ms = b.sumSquares[c] / std::max(1, b.frames);
+        rmsNow[c] += k * (ms - rmsNow[c]); // mean square, smoothed
+        peakHeldFor[c] += dt;
+        if (b.peak[c] >= peakHeld[c]) {
+          peakHeld[c] = b.peak[c];
+          peakHeldFor[c] = 0.0;
+        } else if (peakHeldFor[c] > holdTime) {
+          // fall 20 dB per second after the hold
+          peakHeld[c] = std::max(b.peak[c],
+                                 peakHeld[c] * static_cast<float>(
+                                                   std::pow(0.1, dt)));
+        }
+        clipTotal[c] += b.clips[c];
+      }
+    }
+    return got;
+  }
+
+  int channelCount() const { return channels; }
+  float rms(int c) const { return std::sqrt(rmsNow[c]); }
+  float peak(int c) const { return peakHeld[c]; }
+  uint64_t clips(int c) const { return clipTotal[c]; }
+  // blocks the audio thread couldn't publish because nobody was polling
+  uint64_t droppedBlocks() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+  void resetClips() { std::fill(clipTotal.begin(), clipTotal.end(), 0); }
+
+  // /meters/rms and /meters/peak (dB) and /meters/clips, one value per
+  // channel. Send is anything shaped like al::osc::Send
+  template <class Send> void sendOsc(Send &osc, const std::string &prefix =
+                                                   "/meters") const {
+    osc.beginMessage(prefix + "/rms");
+    for (int c = 0; c < channels; ++c) osc << toDb(rms(c));
+    osc.endMessage();
+    osc.send();
+    osc.beginMessage(prefix + "/peak");
+    for (int c = 0; c < channels; ++c) osc << toDb(peak(c));
+    osc.endMessage();
+    osc.send();
+    osc.beginMessage(prefix + "/clips");
+    for (int c = 0; c < channels; ++c) osc << static_cast<int>(clips(c));
+    osc.endMessage();
+    osc.send();
+  }
+
+  static float toDb(float linear) {
+    return linear > 1e-6f ? 20.0f * std::log10(linear) : -120.0f;
+  }
+
+private:
+  int channels = 0;
+  double rate = 48000.0;
+  float clipLevel = 1.0f;
+  double rmsTime = 0.3, holdTime = 1.5;
+
+  // audio thread
+  MeterBlock scratch;
+  float lastGain = 1.0f;
+  std::atomic<uint64_t> dropped{0};
+
+  SpscRing<MeterBlock> ring;
+
+  // consumer
+  std::vector<float> rmsNow, peakHeld;
+  std::vector<double> peakHeldFor;
+  std::vector<uint64_t> clipTotal;
+};
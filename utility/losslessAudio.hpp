@@ -0,0 +1,602 @@
+#pragma once
+
+// lossless compressed multichannel audio (.alc), so the 54.1 stems and song
+// files take about half the disk and half the copy time to every machine.
+//
+// FLAC-style coding on blocks of 4096 frames, each channel on its own: the
+// samples are taken back to integers (16 / 24 bit sources, and float files
+// that hold 24 bit values, are exact at q / 2^23), shared low zero bits are
+// shifted out, the best of the fixed polynomial predictors (order 0-4) is
+// subtracted, and the residual is Rice coded in 256 sample partitions. a
+// channel block that isn't integer-exact is stored as raw floats, so any
+// float32 file round-trips bit for bit.
+//
+// the file ends in a seek index (one offset per block), so seeking is one
+// fseek plus decoding a single block. a block's channels decode
+// independently and run on a WorkerPool; readers are used from the I/O
+// thread (AdmStreamer), never the audio callback.
+//
+//   LosslessWriter w;  w.open("stem.alc", 60, 48000);  w.write(frames, n);
+//   LosslessReader r;  r.open("stem.alc");  r.read(interleaved, n);
+//
+// StemReader opens either a .wav or a .alc behind the same interface.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "parallelFor.hpp"
+#include "wavFile.hpp"
+
+namespace alc {
+
+constexpr char kMagic[4] = {'A', 'L', 'C', '1'};
+constexpr int kHeaderBytes = 40;
+constexpr int kScaleBits = 23; // sample = q / 2^23, as WavReader scales 24 bit
+constexpr int kPartition = 256;
+constexpr int kMaxOrder = 4;
+constexpr uint32_t kEscape = 48; // rice quotients this big are sent raw
+constexpr double kMaxQ = 1073741824.0; // 2^30
+
+enum BlockType : uint8_t { INTEGER = 0, CONSTANT = 1, VERBATIM = 2 };
+
+// zero bits above the highest / below the lowest set bit, v > 0
+inline int leadingZeros(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i;
+  _BitScanReverse64(&i, v);
+  return 63 - static_cast<int>(i);
+#elif defined(_MSC_VER)
+  int z = 0;
+  for (uint64_t top = uint64_t(1) << 63; !(v & top); top >>= 1) ++z;
+  return z;
+#else
+  return __builtin_clzll(v);
+#endif
+}
+inline int trailingZeros(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i;
+  _BitScanForward64(&i, v);
+  return static_cast<int>(i);
+#elif defined(_MSC_VER)
+  int z = 0;
+  for (; !(v & 1); v >>= 1) ++z;
+  return z;
+#else
+  return __builtin_ctzll(v);
+#endif
+}
+
+struct BitWriter {
+  std::vector<uint8_t> &out;
+  uint64_t acc = 0;
+  int bits = 0;
+
+  explicit BitWriter(std::vector<uint8_t> &o) : out(o) {}
+  // n <= 32
+  void put(uint32_t v, int n) {
+    if (n == 0) return;
+    acc = (acc << n) | (n == 32 ? v : v & ((1u << n) - 1));
+    bits += n;
+    while (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<uint8_t>(acc >> bits));
+    }
+    acc &= (uint64_t(1) << bits) - 1;
+  }
+  void put64(uint64_t v) {
+    put(static_cast<uint32_t>(v >> 32), 32);
+    put(static_cast<uint32_t>(v), 32);
+  }
+  // q zeros then a one
+  void unary(uint32_t q) {
+    for (; q >= 32; q -= 32) put(0, 32);
+    put(1, static_cast<int>(q) + 1);
+  }
+  void flush() {
+    if (bits) put(0, 8 - bits);
+  }
+};
+
+struct BitReader {
+  const uint8_t *p, *end;
+  uint64_t buf = 0; // msb aligned
+  int bits = 0;
+
+  BitReader(const uint8_t *data, std::size_t size) : p(data), end(data + size) {}
+  void refill() {
+    while (bits <= 56 && p < end) {
+      buf |= uint64_t(*p++) << (56 - bits);
+      bits += 8;
+    }
+  }
+  // n <= 32
+  uint32_t get(int n) {
+    if (n == 0) return 0;
+    refill();
+    const uint32_t v = static_cast<uint32_t>(buf >> (64 - n));
+    buf <<= n;
+    bits -= n;
+    return v;
+  }
+  uint64_t get64() {
+    const uint64_t hi = get(32);
+    return (hi << 32) | get(32);
+  }
+  uint32_t unary() {
+    uint32_t q = 0;
+    for (;;) {
+      refill();
+      if (bits == 0) return q; // truncated data
+      if (buf == 0) {
+        q += bits;
+        buf = 0;
+        bits = 0;
+        continue;
+      }
+      const int z = leadingZeros(buf);
+      if (z >= bits) {
+        q += bits;
+        buf = 0;
+        bits = 0;
+        continue;
+      }
+      buf <<= z + 1;
+      bits -= z + 1;
+      return q + z;
+    }
+  }
+};
+
+inline uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+inline int64_t unzigzag(uint64_t u) {
+  return static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+}
+
+// fixed predictor of order k at i (i >= k)
+inline int64_t predict(const int64_t *q, int i, int order) {
+  switch (order) {
+  case 1: return q[i - 1];
+  case 2: return 2 * q[i - 1] - q[i - 2];
+  case 3: return 3 * q[i - 1] - 3 * q[i - 2] + q[i - 3];
+  case 4: return 4 * q[i - 1] - 6 * q[i - 2] + 4 * q[i - 3] - q[i - 4];
+  default: return 0;
+  }
+}
+
+// one channel of one block, appended to out
+inline void encodeChannel(const float *x, std::size_t stride, int n,
+                          std::vector<uint8_t> &out) {
+  std::vector<int64_t> q(n);
+  bool exact = true;
+  for (int i = 0; i < n && exact; ++i) {
+    const double v = static_cast<double>(x[i * stride]) * (1 << kScaleBits);
+    // -0.0f has no integer form, keep it bit exact through the raw path
+    exact = v == std::floor(v) && std::fabs(v) <= kMaxQ &&
+            !(v == 0.0 && std::signbit(v));
+    q[i] = exact ? static_cast<int64_t>(v) : 0;
+  }
+  if (!exact) {
+    out.push_back(VERBATIM);
+    for (int i = 0; i < n; ++i) {
+      uint8_t b[4];
+      std::memcpy(b, &x[i * stride], 4); // little endian hosts only
+      out.insert(out.end(), b, b + 4);
+    }
+    return;
+  }
+  if (std::all_of(q.begin(), q.end(), [&](int64_t v) { return v == q[0]; })) {
+    out.push_back(CONSTANT);
+    BitWriter w(out);
+    w.put(static_cast<uint32_t>(q.empty() ? 0 : q[0]), 32);
+    w.flush();
+    return;
+  }
+
+  // low bits that are zero everywhere (16 bit material at 2^23 scale)
+  uint64_t any = 0;
+  for (int64_t v : q) any |= static_cast<uint64_t>(v);
+  const int shift = any ? std::min(trailingZeros(any), 31) : 0;
+  for (auto &v : q) v >>= shift;
+
+  // cheapest fixed predictor by sum of |residual|
+  int order = 0;
+  uint64_t best = UINT64_MAX;
+  for (int k = 0; k <= kMaxOrder && k < n; ++k) {
+    uint64_t sum = 0;
+    for (int i = kMaxOrder; i < n; ++i)
+      sum += static_cast<uint64_t>(std::llabs(q[i] - predict(q.data(), i, k)));
+    if (sum < best) {
+      best = sum;
+      order = k;
+    }
+  }
+
+  out.push_back(INTEGER);
+  BitWriter w(out);
+  w.put(static_cast<uint32_t>(shift), 5);
+  w.put(static_cast<uint32_t>(order), 3);
+  for (int i = 0; i < order; ++i) w.put(static_cast<uint32_t>(q[i]), 32);
+  std::vector<uint64_t> u(n);
+  for (int i = order; i < n; ++i) u[i] = zigzag(q[i] - predict(q.data(), i, order));
+  for (int p0 = 0; p0 < n; p0 += kPartition) {
+    const int a = std::max(p0, order), b = std::min(n, p0 + kPartition);
+    if (a >= b) continue;
+    uint64_t sum = 0;
+    for (int i = a; i < b; ++i) sum += u[i];
+    int k = 0;
+    while (k < 30 && (uint64_t(b - a) << (k + 1)) <= sum) ++k;
+    w.put(static_cast<uint32_t>(k), 5);
+    for (int i = a; i < b; ++i) {
+      const uint64_t hi = u[i] >> k;
+      if (hi < kEscape) {
+        w.unary(static_cast<uint32_t>(hi));
+        w.put(static_cast<uint32_t>(u[i]), k);
+      } else {
+        w.unary(kEscape);
+        w.put64(u[i]);
+      }
+    }
+  }
+  w.flush();
+}
+
+// mirror of encodeChannel, n samples to out[i * stride]. false if corrupt
+inline bool decodeChannel(const uint8_t *data, std::size_t size, int n,
+                          float *out, std::size_t stride,
+                          std::vector<int64_t> &q) {
+  if (size == 0) return false;
+  const float scale = 1.0f / (1 << kScaleBits);
+  const uint8_t type = data[0];
+  if (type == VERBATIM) {
+    if (size < 1 + 4 * static_cast<std::size_t>(n)) return false;
+    for (int i = 0; i < n; ++i)
+      std::memcpy(&out[i * stride], data + 1 + 4 * i, 4);
+    return true;
+  }
+  BitReader r(data + 1, size - 1);
+  if (type == CONSTANT) {
+    const float v = static_cast<int32_t>(r.get(32)) * scale;
+    for (int i = 0; i < n; ++i) out[i * stride] = v;
+    return true;
+  }
+  if (type != INTEGER) return false;
+  q.resize(n);
+  const int shift = static_cast<int>(r.get(5));
+  const int order = static_cast<int>(r.get(3));
+  if (order > kMaxOrder) return false;
+  for (int i = 0; i < order && i < n; ++i)
+    q[i] = static_cast<int32_t>(r.get(32));
+  for (int p0 = 0; p0 < n; p0 += kPartition) {
+    const int a = std::max(p0, order), b = std::min(n, p0 + kPartition);
+    if (a >= b) continue;
+    const int k = static_cast<int>(r.get(5));
+    for (int i = a; i < b; ++i) {
+      const uint32_t hi = r.unary();
+      const uint64_t u =
+          hi < kEscape ? (uint64_t(hi) << k) | r.get(k) : r.get64();
+      q[i] = unzigzag(u) + predict(q.data(), i, order);
+    }
+  }
+  for (int i = 0; i < n; ++i)
+    out[i * stride] = static_cast<float>(q[i] * (int64_t(1) << shift)) * scale;
+  return true;
+}
+
+inline void putLe(std::vector<uint8_t> &o, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; ++i) o.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+inline uint64_t getLe(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v |= uint64_t(p[i]) << (8 * i);
+  return v;
+}
+
+} // namespace alc
+
+class LosslessWriter {
+public:
+  ~LosslessWriter() { close(); }
+
+  // pool splits each block's channels across threads; nullptr encodes on
+  // the caller
+  bool open(const std::string &path, int numChannels, int rate,
+            int blockFrames = 4096, WorkerPool *pool = &WorkerPool::shared()) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    channels = numChannels;
+    sampleRate = rate;
+    block = blockFrames;
+    workers = pool;
+    frames = 0;
+    offsets.clear();
+    pending.clear();
+    return writeHeader();
+  }
+
+  // interleaved float frames
+  bool write(const float *interleaved, std::size_t n) {
+    if (!file) return false;
+    const std::size_t ch = channels;
+    std::size_t done = 0;
+    while (done < n) {
+      const std::size_t take =
+          std::min(n - done, static_cast<std::size_t>(block) - pending.size() / ch);
+      pending.insert(pending.end(), interleaved + done * ch,
+                     interleaved + (done + take) * ch);
+      done += take;
+      if (pending.size() == static_cast<std::size_t>(block) * ch &&
+          !flushBlock())
+        return false;
+    }
+    return true;
+  }
+
+  // writes the last partial block and the seek index
+  bool close() {
+    if (!file) return true;
+    bool ok = pending.empty() || flushBlock();
+    const uint64_t indexOffset = static_cast<uint64_t>(tell());
+    std::vector<uint8_t> index;
+    for (uint64_t o : offsets) alc::putLe(index, o, 8);
+    ok = ok && std::fwrite(index.data(), 1, index.size(), file) == index.size();
+    // patch frames, index offset and block count
+    std::vector<uint8_t> patch;
+    alc::putLe(patch, frames, 8);
+    alc::putLe(patch, indexOffset, 8);
+    alc::putLe(patch, offsets.size(), 4);
+    ok = ok && std::fseek(file, 16, SEEK_SET) == 0 &&
+         std::fwrite(patch.data(), 1, patch.size(), file) == patch.size();
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+  }
+
+  uint64_t framesWritten() const { return frames; }
+
+private:
+  bool writeHeader() {
+    std::vector<uint8_t> h(alc::kMagic, alc::kMagic + 4);
+    alc::putLe(h, channels, 2);
+    alc::putLe(h, 0, 2);
+    alc::putLe(h, sampleRate, 4);
+    alc::putLe(h, block, 4);
+    alc::putLe(h, 0, 8); // frames
+    alc::putLe(h, 0, 8); // index offset
+    alc::putLe(h, 0, 4); // blocks
+    alc::putLe(h, 0, 4);
+    return std::fwrite(h.data(), 1, h.size(), file) == h.size();
+  }
+
+  bool flushBlock() {
+    const int n = static_cast<int>(pending.size() / channels);
+    encoded.resize(channels);
+    auto encode = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t c = begin; c < end; ++c) {
+        encoded[c].clear();
+        alc::encodeChannel(pending.data() + c, channels, n, encoded[c]);
+      }
+    };
+    if (workers)
+      workers->parallelFor(channels, 1, encode);
+    else
+      encode(0, channels);
+    offsets.push_back(static_cast<uint64_t>(tell()));
+    std::vector<uint8_t> sizes;
+    for (const auto &e : encoded) alc::putLe(sizes, e.size(), 4);
+    bool ok = std::fwrite(sizes.data(), 1, sizes.size(), file) == sizes.size();
+    for (const auto &e : encoded)
+      ok = ok && std::fwrite(e.data(), 1, e.size(), file) == e.size();
+    frames += n;
+    pending.clear();
+    return ok;
+  }
+
+  int64_t tell() const {
+#if defined(_WIN32)
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+  }
+
+  std::FILE *file = nullptr;
+  int channels = 0, sampleRate = 0, block = 4096;
+  WorkerPool *workers = nullptr;
+  uint64_t frames = 0;
+  std::vector<uint64_t> offsets;
+  std::vector<float> pending;
+  std::vector<std::vector<uint8_t>> encoded;
+};
+
+// WavReader-shaped: open / seek / read interleaved floats
+class LosslessReader {
+public:
+  ~LosslessReader() { close(); }
+
+  bool open(const std::string &filePath) {
+    close();
+    path = filePath;
+    file = std::fopen(filePath.c_str(), "rb");
+    if (!file || !parseHeader()) {
+      close();
+      return false;
+    }
+    planar.assign(static_cast<std::size_t>(blockFrames) * channels, 0.0f);
+    scratch.resize(channels);
+    decoded = UINT64_MAX;
+    position = 0;
+    return true;
+  }
+
+  void close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+  }
+  bool isOpen() const { return file != nullptr; }
+
+  // channels of a block decode on this pool; nullptr decodes on the caller
+  // (when the caller is already one of many parallel readers)
+  void setWorkers(WorkerPool *pool) { workers = pool; }
+
+  bool seek(uint64_t frame) {
+    if (!file) return false;
+    position = std::min(frame, frames);
+    return true;
+  }
+
+  // reads up to n frames as interleaved floats, returns frames read
+  std::size_t read(float *dst, std::size_t n) {
+    if (!file) return 0;
+    std::size_t done = 0;
+    while (done < n && position < frames) {
+      const uint64_t b = position / blockFrames;
+      if (b != decoded && !decodeBlock(b)) break;
+      const uint64_t start = b * blockFrames;
+      const std::size_t inBlock = static_cast<std::size_t>(
+          std::min<uint64_t>(blockFrames, frames - start));
+      const std::size_t at = static_cast<std::size_t>(position - start);
+      const std::size_t take = std::min(n - done, inBlock - at);
+      for (std::size_t f = 0; f < take; ++f)
+        for (int c = 0; c < channels; ++c)
+          dst[(done + f) * channels + c] =
+              planar[static_cast<std::size_t>(c) * blockFrames + at + f];
+      done += take;
+      position += take;
+    }
+    return done;
+  }
+
+  std::string path;
+  int channels = 0;
+  int sampleRate = 0;
+  uint64_t frames = 0;
+  uint64_t position = 0;
+
+private:
+  bool parseHeader() {
+    uint8_t h[alc::kHeaderBytes];
+    if (std::fread(h, 1, sizeof h, file) != sizeof h ||
+        std::memcmp(h, alc::kMagic, 4))
+      return false;
+    channels = static_cast<int>(alc::getLe(h + 4, 2));
+    sampleRate = static_cast<int>(alc::getLe(h + 8, 4));
+    blockFrames = static_cast<int>(alc::getLe(h + 12, 4));
+    frames = alc::getLe(h + 16, 8);
+    const uint64_t indexOffset = alc::getLe(h + 24, 8);
+    const uint64_t blocks = alc::getLe(h + 32, 4);
+    if (channels <= 0 || blockFrames <= 0 || indexOffset == 0) return false;
+    std::vector<uint8_t> index(blocks * 8);
+    if (!seekByte(indexOffset) ||
+        std::fread(index.data(), 1, index.size(), file) != index.size())
+      return false;
+    offsets.resize(blocks + 1);
+    for (uint64_t b = 0; b < blocks; ++b)
+      offsets[b] = alc::getLe(index.data() + b * 8, 8);
+    offsets[blocks] = indexOffset;
+    return true;
+  }
+
+  bool decodeBlock(uint64_t b) {
+    if (b + 1 >= offsets.size()) return false;
+    const std::size_t bytes =
+        static_cast<std::size_t>(offsets[b + 1] - offsets[b]);
+    raw.resize(bytes);
+    if (!seekByte(offsets[b]) ||
+        std::fread(raw.data(), 1, bytes, file) != bytes)
+      return false;
+    const int n = static_cast<int>(
+        std::min<uint64_t>(blockFrames, frames - b * blockFrames));
+    // per-channel sizes, then the payloads back to back
+    std::vector<std::size_t> at(channels + 1);
+    at[0] = 4 * static_cast<std::size_t>(channels);
+    for (int c = 0; c < channels; ++c)
+      at[c + 1] = at[c] + alc::getLe(raw.data() + 4 * c, 4);
+    if (at[channels] > bytes) return false;
+    std::atomic<bool> ok{true};
+    auto decode = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t c = begin; c < end; ++c)
+        if (!alc::decodeChannel(raw.data() + at[c], at[c + 1] - at[c], n,
+                                &planar[c * blockFrames], 1, scratch[c]))
+          ok.store(false, std::memory_order_relaxed);
+    };
+    if (workers && channels > 1)
+      workers->parallelFor(channels, 1, decode);
+    else
+      decode(0, channels);
+    decoded = ok.load() ? b : UINT64_MAX;
+    return decoded == b;
+  }
+
+  bool seekByte(uint64_t byte) {
+#if defined(_WIN32)
+    return _fseeki64(file, static_cast<long long>(byte), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(byte), SEEK_SET) == 0;
+#endif
+  }
+
+  std::FILE *file = nullptr;
+  int blockFrames = 4096;
+  WorkerPool *workers = &WorkerPool::shared();
+  std::vector<uint64_t> offsets; // block starts, then the index offset
+  std::vector<uint8_t> raw;
+  std::vector<float> planar; // decoded block, channel-major
+  std::vector<std::vector<int64_t>> scratch;
+  uint64_t decoded = UINT64_MAX;
+};
+
+// a .wav or a .alc, by extension, with WavReader's fields
+class StemReader {
+public:
+  bool open(const std::string &filePath) {
+    const bool compressed =
+        filePath.size() > 4 && filePath.compare(filePath.size() - 4, 4, ".alc") == 0;
+    if (compressed) {
+      alcReader = std::make_unique<LosslessReader>();
+      if (!alcReader->open(filePath)) return false;
+      channels = alcReader->channels;
+      sampleRate = alcReader->sampleRate;
+      frames = alcReader->frames;
+    } else {
+      alcReader.reset();
+      if (!wav.open(filePath)) return false;
+      channels = wav.channels;
+      sampleRate = wav.sampleRate;
+      frames = wav.frames;
+    }
+    return true;
+  }
+  bool compressed() const { return alcReader != nullptr; }
+  void setWorkers(WorkerPool *pool) {
+    if (alcReader) alcReader->setWorkers(pool);
+  }
+  bool seek(uint64_t frame) {
+    return alcReader ? alcReader->seek(frame) : wav.seek(frame);
+  }
+  std::size_t read(float *dst, std::size_t n) {
+    return alcReader ? alcReader->read(dst, n) : wav.read(dst, n);
+  }
+
+  int channels = 0;
+  int sampleRate = 0;
+  uint64_t frames = 0;
+
+private:
+  WavReader wav;
+  std::unique_ptr<LosslessReader> alcReader;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+// vertex normals for deforming meshes with fixed topology.
+// build() walks the triangles once and stores vertex -> face adjacency as CSR,
+// update() then only does the arithmetic: face normals in one parallel pass,
+// then every vertex gathers its faces in a second pass (no atomics, no
+// allocation). use it where generateNormals() was called every frame after
+// a ripple.
+//
+// for lit meshes that don't need smooth normals, SHADER_DERIVATIVE skips the
+// cpu work entirely and the fragment shader rebuilds a flat normal from
+// dFdx / dFdy of the view position (see normalsDerivativeVert / Frag).
+// meshes drawn as points or lines end up there too.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "parallelFor.hpp"
+
+enum class NormalsMode { CPU_SMOOTH, SHADER_DERIVATIVE };
+
+class MeshNormals {
+public:
+  // work per parallel chunk, small meshes just run inline
+  static constexpr std::size_t kGrain = 8192;
+
+  // GL primitive values, as in al::Mesh::Primitive
+  static constexpr int kTriangles = 4;
+  static constexpr int kTriangleStrip = 5;
+  static constexpr int kTriangleFan = 6;
+
+  void setMode(NormalsMode m) { mode = m; }
+  NormalsMode getMode() const { return mode; }
+  bool built() const { return vertexCount > 0; }
+
+  // faces follow the mesh primitive: TRIANGLES, TRIANGLE_STRIP and
+  // TRIANGLE_FAN, over indices() if there are any, otherwise over the
+  // vertices in order. points and lines have no faces to average, so those
+  // meshes switch to SHADER_DERIVATIVE with a warning
+  template <class MeshT> void build(const MeshT &mesh) {
+    const auto &verts = mesh.vertices();
+    const auto &idx = mesh.indices();
+    vertexCount = verts.size();
+    tris.clear();
+    const int prim = static_cast<int>(mesh.primitive());
+    if (prim != kTriangles && prim != kTriangleStrip && prim != kTriangleFan) {
+      if (mode == NormalsMode::CPU_SMOOTH)
+        std::cout << "MeshNormals: primitive " << prim
+                  << " has no triangles, using SHADER_DERIVATIVE" << std::endl;
+      mode = NormalsMode::SHADER_DERIVATIVE;
+      faceStart.clear();
+      faceList.clear();
+      return;
+    }
+
+    const std::size_t n = idx.empty() ? vertexCount : idx.size();
+    auto at = [&](std::size_t i) -> uint32_t {
+      return idx.empty() ? static_cast<uint32_t>(i) : idx[i];
+    };
+    auto addFace = [&](uint32_t a, uint32_t b, uint32_t c) {
+      if (a >= vertexCount || b >= vertexCount || c >= vertexCount) return;
+      if (a == b || b == c || a == c) return; // strip restarts / degenerates
+      tris.push_back(a);
+      tris.push_back(b);
+      tris.push_back(c);
+    };
+    if (prim == kTriangles) {
+      tris.reserve(n - n % 3);
+      for (std::size_t i = 0; i + 2 < n; i += 3)
+        addFace(at(i), at(i + 1), at(i + 2));
+    } else if (prim == kTriangleStrip) {
+      // every other strip triangle is wound backwards, swap to keep the
+      // faces pointing the same way
+      tris.reserve(n > 2 ? (n - 2) * 3 : 0);
+      for (std::size_t i = 0; i + 2 < n; ++i)
+        if (i & 1)
+          addFace(at(i + 1), at(i), at(i + 2));
+        else
+          addFace(at(i), at(i + 1), at(i + 2));
+    } else {
+      tris.reserve(n > 2 ? (n - 2) * 3 : 0);
+      for (std::size_t i = 1; i + 1 < n; ++i)
+        addFace(at(0), at(i), at(i + 1));
+    }
+    const std::size_t faces = tris.size() / 3;
+
+    // vertex -> faces, compressed rows
+    faceStart.assign(vertexCount + 1, 0);
+    for (uint32_t v : tris) ++faceStart[v + 1];
+    for (std::size_t v = 0; v < vertexCount; ++v)
+      faceStart[v + 1] += faceStart[v];
+    faceList.resize(tris.size());
+    std::vector<uint32_t> fill(faceStart.begin(), faceStart.end() - 1);
+    for (std::size_t f = 0; f < faces; ++f)
+      for (int k = 0; k < 3; ++k)
+        faceList[fill[tris[f * 3 + k]]++] = static_cast<uint32_t>(f);
+
+    fnx.assign(faces, 0.0f);
+    fny.assign(faces, 0.0f);
+    fnz.assign(faces, 0.0f);
+  }
+
+  // recompute normals from the current positions. rebuilds first if the
+  // vertex count changed under us
+  template <class MeshT> void update(MeshT &mesh) {
+    if (mode == NormalsMode::SHADER_DERIVATIVE) return;
+    const auto &verts = mesh.vertices();
+    if (verts.size() != vertexCount) build(mesh);
+    if (mode == NormalsMode::SHADER_DERIVATIVE) return; // build gave up
+    auto &normals = mesh.normals();
+    if (normals.size() != vertexCount) normals.resize(vertexCount);
+
+    // pass 1: area weighted face normals (unnormalized cross product)
+    const std::size_t faces = tris.size() / 3;
+    parallelFor(faces, kGrain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t f = begin; f < end; ++f) {
+        const auto &a = verts[tris[f * 3]];
+        const auto &b = verts[tris[f * 3 + 1]];
+        const auto &c = verts[tris[f * 3 + 2]];
+        float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+        float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+        fnx[f] = uy * vz - uz * vy;
+        fny[f] = uz * vx - ux * vz;
+        fnz[f] = ux * vy - uy * vx;
+      }
+    });
+
+    // pass 2: each vertex sums its own faces, so threads never share writes
+    parallelFor(vertexCount, kGrain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t v = begin; v < end; ++v) {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        for (uint32_t k = faceStart[v]; k < faceStart[v + 1]; ++k) {
+          uint32_t f = faceList[k];
+          x += fnx[f];
+          y += fny[f];
+          z += fnz[f];
+        }
+        float m = x * x + y * y + z * z;
+        float inv = m > 1e-20f ? 1.0f / std::sqrt(m) : 0.0f;
+        normals[v].x = x * inv;
+        normals[v].y = y * inv;
+        normals[v].z = z * inv;
+      }
+    });
+  }
+
+private:
+  NormalsMode mode = NormalsMode::CPU_SMOOTH;
+  std::size_t vertexCount = 0;
+  std::vector<uint32_t> tris;
+  std::vector<uint32_t> faceStart, faceList;
+  std::vector<float> fnx, fny, fnz;
+};
+
+// flat shaded lighting with normals from screen space derivatives. the mesh
+// needs no normals or colors, `tint` is the color as with g.color(). on
+// lines both derivatives run along the line, so they're lit as if facing
+// the camera. matrix uniforms match allolib's default shader names
+inline const char *normalsDerivativeVert() {
+  return R"(#version 330
+uniform mat4 al_ModelViewMatrix;
+uniform mat4 al_ProjectionMatrix;
+layout (location = 0) in vec3 position;
+out vec3 viewPos;
+void main() {
+  vec4 p = al_ModelViewMatrix * vec4(position, 1.0);
+  viewPos = p.xyz;
+  gl_Position = al_ProjectionMatrix * p;
+}
+)";
+}
+
+inline const char *normalsDerivativeFrag() {
+  return R"(#version 330
+uniform vec4 tint;
+uniform vec3 lightDir;   // view space, pointing at the light
+uniform float ambient;
+in vec3 viewPos;
+out vec4 fragColor;
+void main() {
+  vec3 c = cross(dFdx(viewPos), dFdy(viewPos));
+  vec3 n = dot(c, c) > 1e-20 ? normalize(c) : -normalize(viewPos);
+  float diffuse = abs(dot(n, normalize(lightDir)));
+  fragColor = vec4(tint.rgb * (ambient + diffuse), tint.a);
+}
+)";
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+// the last stage before the device: a sparse routing matrix, bass
+// management into the sub(s), and per-output gain / delay trims. runs in
+// place on the device buffers after spatialization, so whatever the
+// spatializer wrote on channel N is input N here.
+//
+// the config is a text file, one entry per line, # starts a comment:
+//
+//   route 0 0            # input 0 -> output 0 at 0 dB
+//   route 3 3 -1.5       # with a gain in dB
+//   sub 47 0             # output 47 is a sub: lowpassed sum of the mains
+//   crossover 80         # Hz, 4th order Linkwitz-Riley, default 80
+//   mains highpass       # highpass the mains at the crossover (default
+//                        # fullrange: subs only extend them)
+//   trim 12 -0.5 1.25    # output 12: gain dB, delay ms
+//
+// with no route lines every channel that isn't a sub passes straight
+// through, so a config can be as short as "sub 47". setMains() narrows
+// which of those pass-through channels are speakers; with route lines the
+// mains are the outputs routes go to.
+//
+// a sub's feed is the sum of the mains scaled by 1 / sqrt(mains): the
+// spatializer pans at constant power, so a source spread over N mains is
+// x / sqrt(N) on each, sums to x * sqrt(N), and reaches the sub at x, the
+// source's own level (the mono signal before panning). that is
+// 10 log10(N) dB above any one main, ~17 dB for the sphere's 54. the dB
+// after "sub" (and trim) sets the sub's level from there.
+//
+// the filters run across channels, one simd vector of outputs per step on
+// a frame-interleaved block, so 60 channels of 4th order crossovers cost
+// about what one channel's would in a scalar loop.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "simdUtility.hpp"
+
+class OutputRouter {
+public:
+  // --- setup, not real-time safe ---
+
+  // false if the file can't be read or has a bad line (printed, then
+  // skipped; the rest still applies)
+  bool load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+      std::cout << "OutputRouter: couldnt open " << path << std::endl;
+      return false;
+    }
+    return parse(in, path);
+  }
+
+  bool parse(std::istream &in, const std::string &name = "config") {
+    bool ok = true;
+    std::string line;
+    for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+      const std::size_t hash = line.find('#');
+      if (hash != std::string::npos) line.erase(hash);
+      std::istringstream words(line);
+      std::string key;
+      if (!(words >> key)) continue;
+      bool good = true;
+      if (key == "route") {
+        int i = -1, o = -1;
+        float db = 0.0f;
+        good = static_cast<bool>(words >> i >> o) && i >= 0 && o >= 0;
+        words >> db;
+        if (good) addRoute(i, o, db);
+      } else if (key == "sub") {
+        int o = -1;
+        float db = 0.0f;
+        good = static_cast<bool>(words >> o) && o >= 0;
+        words >> db;
+        if (good) addSub(o, db);
+      } else if (key == "crossover") {
+        float hz = 0.0f;
+        good = static_cast<bool>(words >> hz) && hz > 0.0f;
+        if (good) setCrossover(hz);
+      } else if (key == "mains") {
+        std::string mode;
+        words >> mode;
+        good = mode == "highpass" || mode == "fullrange";
+        if (good) setHighpassMains(mode == "highpass");
+      } else if (key == "trim") {
+        int o = -1;
+        float db = 0.0f, ms = 0.0f;
+        good = static_cast<bool>(words >> o >> db) && o >= 0;
+        words >> ms;
+        if (good) setTrim(o, db, ms);
+      } else {
+        good = false;
+      }
+      if (!good) {
+        std::cout << "OutputRouter: " << name << ":" << lineNo
+                  << " not understood: " << line << std::endl;
+        ok = false;
+      }
+    }
+    return ok;
+  }
+
+  void clear() {
+    routes.clear();
+    mainOutputs.clear();
+    subs.clear();
+    trims.clear();
+  }
+  void addRoute(int in, int out, float gainDb = 0.0f) {
+    routes.push_back(Route{in, out, dbToGain(gainDb)});
+  }
+  void addSub(int out, float gainDb = 0.0f) {
+    subs.push_back(Route{-1, out, dbToGain(gainDb)});
+  }
+  // the outputs that are speakers when there are no route lines. empty
+  // (the default) means every channel that isn't a sub
+  void setMains(const std::vector<int> &outs) { mainOutputs = outs; }
+  void setCrossover(float hz) { crossoverHz = hz; }
+  void setHighpassMains(bool on) { highpassMains = on; }
+  void setTrim(int out, float gainDb, float delayMs) {
+    trims.push_back(Trim{out, dbToGain(gainDb), delayMs});
+  }
+
+  // sizes everything for the device. entries outside [0, channels) are
+  // dropped with a message (the old io.out(47) on a stereo laptop)
+  void prepare(int channels, int maxFrames, double sampleRate) {
+    numChannels = channels;
+    blockMax = maxFrames;
+    stride = simd::padded(static_cast<std::size_t>(channels));
+    const auto inRange = [&](int c) { return c >= 0 && c < channels; };
+
+    isSub.assign(stride, 0);
+    subGain.assign(stride, 0.0f);
+    for (const Route &s : subs) {
+      if (!inRange(s.out)) {
+        std::cout << "OutputRouter: no output " << s.out << " for sub"
+                  << std::endl;
+        continue;
+      }
+      isSub[s.out] = 1;
+      subGain[s.out] = s.gain;
+    }
+
+    active.clear();
+    if (routes.empty()) {
+      for (int c = 0; c < channels; ++c)
+        if (!isSub[c]) active.push_back(Route{c, c, 1.0f});
+    } else {
+      for (const Route &r : routes) {
+        if (inRange(r.in) && inRange(r.out))
+          active.push_back(r);
+        else
+          std::cout << "OutputRouter: route " << r.in << " -> " << r.out
+                    << " is outside " << channels << " channels" << std::endl;
+      }
+    }
+    hasSubs = std::find(isSub.begin(), isSub.end(), 1) != isSub.end();
+    // distinct outputs that are speakers, not routes or spare channels
+    isMain.assign(stride, 0);
+    if (routes.empty() && !mainOutputs.empty()) {
+      for (int c : mainOutputs)
+        if (inRange(c) && !isSub[c]) isMain[c] = 1;
+    } else {
+      for (const Route &r : active)
+        if (!isSub[r.out]) isMain[r.out] = 1;
+    }
+    const int mains = static_cast<int>(
+        std::count(isMain.begin(), isMain.end(), 1));
+    bassNorm = 1.0f / std::sqrt(static_cast<float>(std::max(1, mains)));
+
+    // LR4 = two identical butterworth biquads. mains get a highpass (or
+    // pass straight through), subs a lowpass
+    for (Stage &st : stages) {
+      st.b0.resize(stride);
+      st.b1.resize(stride);
+      st.b2.resize(stride);
+      st.a1.resize(stride);
+      st.a2.resize(stride);
+      st.z1.resize(stride);
+      st.z2.resize(stride);
+      st.z1.zero();
+      st.z2.zero();
+    }
+    const Biquad lp = butterworth(crossoverHz, sampleRate, false);
+    const Biquad hp = butterworth(crossoverHz, sampleRate, true);
+    const Biquad thru{1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    filtering = false;
+    for (std::size_t c = 0; c < stride; ++c) {
+      const bool used = static_cast<int>(c) < channels;
+      const Biquad &q = !used                    ? thru
+                        : isSub[c]               ? lp
+                        : hasSubs && highpassMains ? hp
+                                                   : thru;
+      if (&q != &thru) filtering = true;
+      for (Stage &st : stages) {
+        st.b0.data[c] = q.b0;
+        st.b1.data[c] = q.b1;
+        st.b2.data[c] = q.b2;
+        st.a1.data[c] = q.a1;
+        st.a2.data[c] = q.a2;
+      }
+    }
+
+    outGain.assign(channels, 1.0f);
+    outDelay.assign(channels, 0);
+    int maxDelay = 0;
+    for (const Trim &t : trims) {
+      if (!inRange(t.out)) continue;
+      outGain[t.out] = t.gain;
+      outDelay[t.out] =
+          std::max(0, static_cast<int>(std::lround(t.delayMs * 1e-3 * sampleRate)));
+      maxDelay = std::max(maxDelay, outDelay[t.out]);
+    }
+    delayLength = 1;
+    while (delayLength < maxDelay + maxFrames) delayLength <<= 1;
+    delayLines.assign(static_cast<std::size_t>(channels) * delayLength, 0.0f);
+    delayWrite = 0;
+
+    mix.resize(stride * kChunk);
+    bass.resize(kChunk);
+  }
+
+  int channels() const { return numChannels; }
+  int routeCount() const { return static_cast<int>(active.size()); }
+
+  // --- audio thread ---
+
+  template <class IO> void process(IO &io) {
+    float *bufs[kMaxChannels];
+    const int n = std::min<int>({static_cast<int>(io.channelsOut()),
+                                 numChannels, kMaxChannels});
+    for (int c = 0; c < n; ++c) bufs[c] = io.outBuffer(c);
+    process(bufs, n, io.framesPerBuffer());
+  }
+
+  // in place on bufs[0..channels)
+  void process(float *const *bufs, int channels, int frames) {
+    frames = std::min(frames, blockMax);
+    channels = std::min({channels, numChannels, kMaxChannels});
+    if (frames <= 0 || channels <= 0) return;
+    // chunks small enough that the interleaved block stays in L1
+    for (int f0 = 0; f0 < frames; f0 += kChunk) {
+      const int n = std::min(kChunk, frames - f0);
+      float *chunk[kMaxChannels];
+      for (int c = 0; c < channels; ++c) chunk[c] = bufs[c] + f0;
+      processChunk(chunk, channels, n);
+    }
+  }
+
+  static constexpr int kMaxChannels = 128;
+  static constexpr int kChunk = 64;
+
+private:
+  void processChunk(float *const *bufs, int channels, int frames) {
+    float *m = mix.data;
+    std::fill(m, m + stride * frames, 0.0f);
+    float *lows = bass.data;
+    if (hasSubs) std::fill(lows, lows + frames, 0.0f);
+
+    // matrix, into a frame-interleaved block. every route to a main also
+    // feeds the bass sum
+    const int vecFrames = frames / simd::width * simd::width;
+    for (const Route &r : active) {
+      if (r.in >= channels || r.out >= channels) continue;
+      const float *in = bufs[r.in];
+      float *col = m + r.out;
+      const float g = r.gain;
+      for (int f = 0; f < frames; ++f) col[f * stride] += g * in[f];
+      if (hasSubs && isMain[r.out]) {
+        const simd::floatv vg(g);
+        int f = 0;
+        for (; f < vecFrames; f += simd::width)
+          simd::fmadd(vg, simd::floatv::loadu(in + f),
+                      simd::floatv::load(lows + f))
+              .store(lows + f);
+        for (; f < frames; ++f) lows[f] += g * in[f];
+      }
+    }
+    if (hasSubs) {
+      for (int c = 0; c < channels; ++c) {
+        if (!isSub[c]) continue;
+        const float g = subGain[c] * bassNorm;
+        for (int f = 0; f < frames; ++f) m[f * stride + c] += g * lows[f];
+      }
+    }
+
+    // crossovers, one vector of channels at a time, transposed direct form II
+    if (filtering) {
+      const int used = static_cast<int>(simd::padded(channels));
+      for (Stage &st : stages) {
+        for (int c = 0; c < used; c += simd::width) {
+          const simd::floatv b0 = simd::floatv::load(st.b0.data + c);
+          const simd::floatv b1 = simd::floatv::load(st.b1.data + c);
+          const simd::floatv b2 = simd::floatv::load(st.b2.data + c);
+          const simd::floatv a1 = simd::floatv::load(st.a1.data + c);
+          const simd::floatv a2 = simd::floatv::load(st.a2.data + c);
+          simd::floatv z1 = simd::floatv::load(st.z1.data + c);
+          simd::floatv z2 = simd::floatv::load(st.z2.data + c);
+          float *p = m + c;
+          for (int f = 0; f < frames; ++f, p += stride) {
+            const simd::floatv x = simd::floatv::load(p);
+            const simd::floatv y = simd::fmadd(b0, x, z1);
+            z1 = simd::fmadd(b1, x, z2) - a1 * y;
+            z2 = b2 * x - a2 * y;
+            y.store(p);
+          }
+          // keep denormals out of the recursion once the input goes quiet
+          z1 = z1 + simd::floatv(kAntiDenormal) - simd::floatv(kAntiDenormal);
+          z2 = z2 + simd::floatv(kAntiDenormal) - simd::floatv(kAntiDenormal);
+          z1.store(st.z1.data + c);
+          z2.store(st.z2.data + c);
+        }
+      }
+    }
+
+    // trims, back out to the device
+    const int mask = delayLength - 1;
+    for (int c = 0; c < channels; ++c) {
+      float *out = bufs[c];
+      const float g = outGain[c];
+      const float *col = m + c;
+      const int d = outDelay[c];
+      if (d == 0) {
+        for (int f = 0; f < frames; ++f) out[f] = g * col[f * stride];
+        continue;
+      }
+      float *line = &delayLines[static_cast<std::size_t>(c) * delayLength];
+      for (int f = 0; f < frames; ++f) {
+        const int w = (delayWrite + f) & mask;
+        line[w] = g * col[f * stride];
+        out[f] = line[(w - d) & mask];
+      }
+    }
+    delayWrite = (delayWrite + frames) & mask;
+  }
+
+  struct Route {
+    int in, out;
+    float gain;
+  };
+  struct Trim {
+    int out;
+    float gain, delayMs;
+  };
+  struct Biquad {
+    float b0, b1, b2, a1, a2;
+  };
+  struct Stage {
+    simd::alignedBuffer b0, b1, b2, a1, a2, z1, z2;
+  };
+
+  static float dbToGain(float db) { return std::pow(10.0f, db / 20.0f); }
+
+  // RBJ cookbook, Q = 1/sqrt(2)
+  static Biquad butterworth(double hz, double rate, bool highpass) {
+    const double w = 2.0 * 3.14159265358979323846 *
+                     std::min(hz, rate * 0.45) / rate;
+    const double alpha = std::sin(w) / (2.0 * 0.70710678118654752);
+    const double cw = std::cos(w);
+    const double a0 = 1.0 + alpha;
+    const double b1 = highpass ? -(1.0 + cw) : 1.0 - cw;
+    const double b0 = highpass ? (1.0 + cw) / 2.0 : (1.0 - cw) / 2.0;
+    return Biquad{static_cast<float>(b0 / a0), static_cast<float>(b1 / a0),
+                  static_cast<float>(b0 / a0),
+                  static_cast<float>(-2.0 * cw / a0),
+                  static_cast<float>((1.0 - alpha) / a0)};
+  }
+
+  static constexpr float kAntiDenormal = 1e-20f;
+
+  // config
+  std::vector<Route> routes, subs;
+  std::vector<Trim> trims;
+  std::vector<int> mainOutputs;
+  float crossoverHz = 80.0f;
+  bool highpassMains = false;
+
+  // prepared
+  int numChannels = 0;
+  int blockMax = 0;
+  std::size_t stride = 0;
+  std::vector<Route> active;
+  std::vector<char> isSub, isMain;
+  std::vector<float> subGain, outGain;
+  std::vector<int> outDelay;
+  bool hasSubs = false;
+  float bassNorm = 1.0f; // 1 / sqrt(main outputs)
+  bool filtering = false;
+  Stage stages[2];
+  std::vector<float> delayLines;
+  int delayLength = 1;
+  int delayWrite = 0;
+  simd::alignedBuffer mix, bass;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+// tiny persistent worker pool for splitting big per-frame loops (vertex
+// clouds, agents, offline audio jobs) across cores. the calling thread works
+// too, and parallelFor() returns once every chunk is done.
+// not for the audio callback, that has its own spinning pool (audioWorkers.hpp).
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+  explicit WorkerPool(unsigned threads = 0) {
+    if (threads == 0) {
+      unsigned hw = std::thread::hardware_concurrency();
+      threads = hw > 1 ? hw - 1 : 0; // caller is the last worker
+    }
+    for (unsigned i = 0; i < threads; ++i)
+      workers.emplace_back([this] { workerLoop(); });
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    wake.notify_all();
+    for (auto &w : workers) w.join();
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // shared pool for the app, sized to the machine
+  static WorkerPool &shared() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+  // calls fn(begin, end) over [0, n) in chunks of at least `grain`
+  void parallelFor(std::size_t n, std::size_t grain,
+                   const std::function<void(std::size_t, std::size_t)> &fn) {
+    if (n == 0) return;
+    grain = std::max<std::size_t>(grain, 1);
+    std::size_t chunks = (n + grain - 1) / grain;
+    if (workers.empty() || chunks == 1) {
+      fn(0, n);
+      return;
+    }
+    // a few chunks per thread so uneven work still balances
+    chunks = std::min<std::size_t>(chunks, size() * 4);
+    std::size_t chunk = (n + chunks - 1) / chunks;
+
+    std::unique_lock<std::mutex> runLock(runMutex); // one job at a time
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &fn;
+      jobSize = n;
+      jobChunk = chunk;
+      nextChunk.store(0);
+      pending.store(chunks);
+      ++generation;
+    }
+    wake.notify_all();
+    runChunks();
+    // also wait for workers to leave runChunks so none of them can grab a
+    // chunk index of the next job with this job's fn
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending.load() == 0 && active == 0; });
+    job = nullptr;
+  }
+
+private:
+  void runChunks() {
+    const std::size_t chunks = (jobSize + jobChunk - 1) / jobChunk;
+    for (;;) {
+      std::size_t c = nextChunk.fetch_add(1);
+      if (c >= chunks) break;
+      std::size_t begin = c * jobChunk;
+      std::size_t end = std::min(jobSize, begin + jobChunk);
+      (*job)(begin, end);
+      if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+    }
+  }
+
+  void workerLoop() {
+    std::size_t seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return quit || (generation != seen && job); });
+        if (quit) return;
+        seen = generation;
+        ++active;
+      }
+      runChunks();
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--active == 0) done.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex, runMutex;
+  std::condition_variable wake, done;
+  const std::function<void(std::size_t, std::size_t)> *job = nullptr;
+  std::size_t jobSize = 0, jobChunk = 1, generation = 0;
+  unsigned active = 0;
+  std::atomic<std::size_t> nextChunk{0}, pending{0};
+  bool quit = false;
+};
+
+template <class F>
+inline void parallelFor(std::size_t n, std::size_t grain, F &&fn) {
+  WorkerPool::shared().parallelFor(n, grain, fn);
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+// long FIR filters on many channels at once (speaker correction, HRIRs),
+// as uniformly partitioned overlap-save FFT convolution.
+//
+// each filter is cut into partitions the length of the audio block B. every
+// block, each channel FFTs its last 2B input samples once into a
+// frequency-domain delay line, multiply-adds that line against the filter's
+// partition spectra, and inverse FFTs once. a 16k tap filter at B = 512 is 32
+// complex multiply-adds per bin instead of 16k per sample, and when the
+// device block is a multiple of B there is no latency beyond the device's.
+// channels are independent, so they run in parallel on AudioWorkers.
+//
+//   PartitionedConvolver conv;
+//   conv.prepare(60, 512);
+//   conv.loadWav("speakerCorrection.wav");   // channel c filters output c
+//   onSound: conv.process(io);
+//
+// setup calls (prepare, setFilter, loadWav) aren't real-time safe and must
+// not overlap process(). channels without a filter pass through untouched.
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audioWorkers.hpp"
+#include "fft.hpp"
+#include "simdUtility.hpp"
+#include "wavFile.hpp"
+
+// the frequency-domain pieces, shared with binauralRenderer.hpp. B is the
+// partition (block) size, spectra are B + 1 bins padded to `stride`
+namespace fdl {
+
+// a filter cut into B sample partitions, each zero padded to 2B and FFT'd
+struct Spectra {
+  int parts = 0;
+  simd::alignedBuffer re, im; // parts x stride
+};
+
+// not real-time safe. `scale` is folded into the spectra, normally the
+// inverse FFT's 1 / 2B times any gain
+inline void makeSpectra(RealFft &fft, int block, std::size_t stride,
+                        const float *ir, int taps, float scale, Spectra &out) {
+  out.parts = taps > 0 ? (taps + block - 1) / block : 0;
+  out.re.resize(out.parts * stride);
+  out.im.resize(out.parts * stride);
+  std::vector<float> padded(2 * block);
+  for (int p = 0; p < out.parts; ++p) {
+    std::fill(padded.begin(), padded.end(), 0.0f);
+    const int n = std::min(block, taps - p * block);
+    for (int i = 0; i < n; ++i) padded[i] = ir[p * block + i] * scale;
+    float *re = out.re.data + p * stride;
+    float *im = out.im.data + p * stride;
+    fft.forward(padded.data(), re, im);
+    std::fill(re + block + 1, re + stride, 0.0f);
+    std::fill(im + block + 1, im + stride, 0.0f);
+  }
+}
+
+// one input's last 2B samples and the spectra of its last `parts` blocks
+struct DelayLine {
+  int parts = 0;
+  int head = 0; // newest spectrum
+  simd::alignedBuffer window, re, im;
+
+  // not real-time safe
+  void prepare(int block, std::size_t stride, int partCount) {
+    parts = std::max(1, partCount);
+    head = 0;
+    window.resize(2 * block);
+    window.zero();
+    re.resize(parts * stride);
+    im.resize(parts * stride);
+    re.zero();
+    im.zero();
+  }
+
+  // slides in the next B samples and FFTs the 2B window into the line
+  void push(RealFft &fft, const float *in, int block, std::size_t stride) {
+    slide(in, block);
+    head = head + 1 == parts ? 0 : head + 1;
+    fft.forward(window.data, re.data + head * stride, im.data + head * stride);
+  }
+  // window only, for a line that isn't being heard right now
+  void slide(const float *in, int block) {
+    float *w = window.data;
+    std::copy(w + block, w + 2 * block, w);
+    std::copy(in, in + block, w + block);
+  }
+  // forget the spectra (not the window), real-time safe
+  void clearHistory() {
+    std::fill(re.data, re.data + re.size, 0.0f);
+    std::fill(im.data, im.data + im.size, 0.0f);
+  }
+};
+
+// acc += sum over p of X[now - p] * H[p], simd across bins
+inline void multiplyAdd(const DelayLine &x, const Spectra &h,
+                        std::size_t stride, float *accRe, float *accIm) {
+  const int parts = std::min(x.parts, h.parts);
+  int slot = x.head;
+  for (int p = 0; p < parts; ++p) {
+    const float *xr = x.re.data + slot * stride;
+    const float *xi = x.im.data + slot * stride;
+    const float *hr = h.re.data + p * stride;
+    const float *hi = h.im.data + p * stride;
+    for (std::size_t k = 0; k < stride; k += simd::width) {
+      const simd::floatv a = simd::floatv::load(xr + k);
+      const simd::floatv b = simd::floatv::load(xi + k);
+      const simd::floatv c = simd::floatv::load(hr + k);
+      const simd::floatv d = simd::floatv::load(hi + k);
+      simd::fmadd(a, c, simd::floatv::load(accRe + k) - b * d)
+          .store(accRe + k);
+      simd::fmadd(a, d, simd::fmadd(b, c, simd::floatv::load(accIm + k)))
+          .store(accIm + k);
+    }
+    slot = slot == 0 ? x.parts - 1 : slot - 1;
+  }
+}
+
+// inverse FFT of acc, the last B samples (overlap-save) to out.
+// time is 2B scratch
+inline void finish(RealFft &fft, const float *accRe, const float *accIm,
+                   float *time, int block, float *out) {
+  fft.inverse(accRe, accIm, time);
+  std::copy(time + block, time + 2 * block, out);
+}
+
+} // namespace fdl
+
+class PartitionedConvolver {
+public:
+  // not real-time safe. partitionSize B is a power of two, normally the
+  // device block
+  void prepare(int channelCount, int partitionSize) {
+    block = partitionSize;
+    binCount = block + 1;
+    binStride = simd::padded(static_cast<std::size_t>(binCount));
+    channels.clear();
+    channels.resize(channelCount);
+    for (auto &c : channels) c = std::make_unique<Channel>();
+  }
+
+  // optional, shared with other audio stages. nullptr runs on the caller
+  void setWorkers(AudioWorkers *w) { workers = w; }
+
+  int channelCount() const { return static_cast<int>(channels.size()); }
+  int partitionSize() const { return block; }
+  // samples between input and output when the device block isn't a
+  // multiple of the partition size, else 0
+  int latency(int deviceFrames) const {
+    return deviceFrames % block == 0 ? 0 : block;
+  }
+
+  // not real-time safe. taps samples of impulse response for channel ch,
+  // empty to bypass it
+  void setFilter(int ch, const float *ir, int taps) {
+    if (ch < 0 || ch >= channelCount()) return;
+    Channel &c = *channels[ch];
+    c.fft.setSize(2 * block);
+    fdl::makeSpectra(c.fft, block, binStride, ir, taps, 1.0f / (2 * block),
+                     c.filter);
+    c.parts = c.filter.parts;
+    if (c.parts == 0) return;
+    c.line.prepare(block, binStride, c.parts);
+    c.accRe.resize(binStride);
+    c.accIm.resize(binStride);
+    c.time.resize(2 * block);
+    c.inFifo.resize(block);
+    c.outFifo.resize(block);
+    c.inFifo.zero();
+    c.outFifo.zero();
+    c.fifoFill = 0;
+  }
+
+  // not real-time safe. one filter per file channel, channel c -> output c
+  bool loadWav(const std::string &path, int maxTaps = 1 << 16) {
+    WavReader r;
+    if (!r.open(path)) {
+      std::cout << "PartitionedConvolver: couldnt open " << path << std::endl;
+      return false;
+    }
+    const int taps = static_cast<int>(std::min<uint64_t>(r.frames, maxTaps));
+    const int nch = std::min(r.channels, channelCount());
+    std::vector<float> interleaved(static_cast<std::size_t>(taps) * r.channels);
+    const int got = static_cast<int>(r.read(interleaved.data(), taps));
+    std::vector<float> ir(got);
+    for (int c = 0; c < nch; ++c) {
+      for (int i = 0; i < got; ++i) ir[i] = interleaved[i * r.channels + c];
+      setFilter(c, ir.data(), got);
+    }
+    std::cout << "PartitionedConvolver: " << nch << " filters of " << got
+              << " taps from " << path << std::endl;
+    return got > 0;
+  }
+
+  // --- audio thread ---
+
+  template <class IO> void process(IO &io) {
+    float *bufs[kMaxChannels];
+    const int n = std::min<int>({static_cast<int>(io.channelsOut()),
+                                 channelCount(), kMaxChannels});
+    for (int c = 0; c < n; ++c) bufs[c] = io.outBuffer(c);
+    process(bufs, n, io.framesPerBuffer());
+  }
+
+  // in place on bufs[0..n)
+  void process(float *const *bufs, int n, int frames) {
+    n = std::min(n, channelCount());
+    auto one = [&](int ch) { processChannel(ch, bufs[ch], frames); };
+    if (workers)
+      workers->run(n, one);
+    else
+      for (int ch = 0; ch < n; ++ch) one(ch);
+  }
+
+  // one channel in place. channels are independent (an AudioGraph node)
+  void processChannel(int ch, float *x, int frames) {
+    if (ch < 0 || ch >= channelCount()) return;
+    Channel &c = *channels[ch];
+    if (c.parts == 0) return;
+    if (frames % block == 0) {
+      for (int f = 0; f < frames; f += block) runBlock(c, x + f, x + f);
+      return;
+    }
+    // device block isn't a multiple of B: go through a one-partition fifo
+    for (int f = 0; f < frames; ++f) {
+      c.inFifo.data[c.fifoFill] = x[f];
+      x[f] = c.outFifo.data[c.fifoFill];
+      if (++c.fifoFill == block) {
+        runBlock(c, c.inFifo.data, c.outFifo.data);
+        c.fifoFill = 0;
+      }
+    }
+  }
+
+  static constexpr int kMaxChannels = 128;
+
+private:
+  struct Channel {
+    int parts = 0;
+    int fifoFill = 0;
+    RealFft fft;
+    fdl::Spectra filter;
+    fdl::DelayLine line;
+    simd::alignedBuffer accRe, accIm, time, inFifo, outFifo;
+  };
+
+  // one partition: in[B] -> out[B], in may alias out
+  void runBlock(Channel &c, const float *in, float *out) {
+    c.line.push(c.fft, in, block, binStride);
+    std::fill(c.accRe.data, c.accRe.data + binStride, 0.0f);
+    std::fill(c.accIm.data, c.accIm.data + binStride, 0.0f);
+    fdl::multiplyAdd(c.line, c.filter, binStride, c.accRe.data, c.accIm.data);
+    fdl::finish(c.fft, c.accRe.data, c.accIm.data, c.time.data, block, out);
+  }
+
+  int block = 512;
+  int binCount = 513;
+  std::size_t binStride = 528;
+  std::vector<std::unique_ptr<Channel>> channels;
+  AudioWorkers *workers = nullptr;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+// one real-time sequencer for the whole show, in place of a SynthSequencer
+// per scene.
+//
+// - voices live in a fixed pool allocated up front. each cue owns a pool slot
+//   (configured once at setup, e.g. a SoundObject with its file loaded) and
+//   is re-triggered every time its scene plays, so nothing is created or
+//   freed while the show runs
+// - start / stop events sit in a binary min-heap keyed by frame, so finding
+//   the next event is O(1) and scheduling is O(log n) however long the show
+// - control threads only push small commands through an SPSC ring, the
+//   audio thread does all the scheduling and never allocates or locks
+// - starts land on their exact frame inside the block, and scenes can
+//   overlap: the old scene's voices are stopped a little after the new one
+//   starts, so a crossfade has both to work with
+// - a replay or a stop takes its slots' superseded events out of the
+//   heap, so each slot has at most one start and one stop pending however
+//   often a scene is replayed, and long cues never fill it up
+//
+//   ShowSequencer<SoundObject> show{64};
+//   show.add(1, 0.0, 44000.0).set(...);   // setup, before audio starts
+//   show.playScene(1);                    // any control thread
+//   onSound: show.advance(io.framesPerBuffer()); show.render(io, scene);
+//
+// Voice needs triggerOn(), triggerOff(), active() and onProcess(io), which
+// al::SynthVoice provides.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "spscRing.hpp"
+
+template <class Voice> class ShowSequencer {
+public:
+  explicit ShowSequencer(std::size_t capacity = 64, double sampleRate = 48000.0)
+      : pool(new Voice[capacity]), slots(capacity), poolSize(capacity) {
+    cues.reserve(capacity);
+    // every cue has at most a start and a stop pending, with room to spare
+    // for the commands of one block before they're pruned
+    heap.reserve(capacity * 4 + 16);
+    deferred.reserve(heap.capacity());
+    commands.reset(256);
+    setSampleRate(sampleRate);
+  }
+
+  // setup only, like add()
+  void setSampleRate(double rate) { framesPerSecond = rate > 0 ? rate : 48000.0; }
+  // how long the outgoing scene keeps playing once the next one starts
+  void setOverlap(double seconds) { overlapSeconds = std::max(0.0, seconds); }
+
+  // setup, not real-time: reserves a pool voice for a cue in `scene`
+  // starting `start` seconds into it. returns the voice to configure. the
+  // audio thread only sees the cue once this returns
+  Voice &add(int scene, double start, double duration) {
+    const std::size_t n = cueCount.load(std::memory_order_relaxed);
+    if (n >= poolSize) return spare; // pool full, configured but never played
+    cues.push_back(Cue{scene, start, duration});
+    slots[n].scene = scene;
+    cueCount.store(n + 1, std::memory_order_release);
+    return pool[n];
+  }
+
+  // any single control thread
+  void playScene(int scene) { pushCommand(Command::PLAY_SCENE, scene); }
+  void stopScene(int scene) { pushCommand(Command::STOP_SCENE, scene); }
+  void stopAll() { pushCommand(Command::STOP_SCENE, kAllScenes); }
+
+  std::size_t size() const { return cueCount.load(std::memory_order_acquire); }
+  std::size_t capacity() const { return poolSize; }
+  uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+  int64_t framePosition() const { return now; }
+
+  // audio thread, once per block before render(): takes commands and fires
+  // every event that falls inside the block
+  void advance(int frames) {
+    for (auto &s : slots) s.offset = 0;
+    Command c;
+    while (commands.read(&c, 1) == 1) apply(c);
+    if (pruneNeeded) prune();
+
+    const int64_t blockEnd = now + frames;
+    while (!heap.empty() && heap.front().frame < blockEnd) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      const Event e = heap.back();
+      heap.pop_back();
+      // stops go at the next block boundary, never early
+      if (!e.start && e.frame > now)
+        deferred.push_back(e);
+      else
+        fire(e, static_cast<int>(std::max<int64_t>(0, e.frame - now)));
+    }
+    for (const Event &e : deferred) {
+      heap.push_back(e);
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
+    deferred.clear();
+    now = blockEnd;
+  }
+
+  // audio thread: adds the playing voices of `scene` (or all of them) into io.
+  // may be called more than once per block, e.g. per side of a crossfade
+  template <class IO> void render(IO &io, int scene = kAllScenes) {
+    const std::size_t n = cueCount.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < n; ++i) {
+      Slot &s = slots[i];
+      if (!s.playing || (scene != kAllScenes && s.scene != scene)) continue;
+      Voice &v = pool[i];
+      io.frame(s.offset); // starts mid-block on its exact frame
+      v.onProcess(io);
+      if (!v.active()) s.playing = false;
+    }
+    io.frame(0);
+  }
+
+  static constexpr int kAllScenes = -1;
+
+private:
+  static constexpr int64_t kNever = std::numeric_limits<int64_t>::max();
+
+  struct Cue {
+    int scene;
+    double start, duration; // seconds from scene start
+  };
+  struct Slot {
+    int scene = 0;
+    bool playing = false;
+    uint32_t generation = 0; // bumped per start so stale stops are ignored
+    int offset = 0;          // first frame this block, set when started
+    int64_t stopAt = kNever; // earliest stop pending for this generation
+  };
+  struct Event {
+    int64_t frame;
+    uint32_t order; // fifo among events on the same frame
+    uint32_t generation;
+    uint32_t slot;
+    bool start;
+  };
+  struct Command {
+    enum Type : uint8_t { PLAY_SCENE, STOP_SCENE } type;
+    int scene;
+  };
+
+  // min-heap on (frame, order)
+  static bool later(const Event &a, const Event &b) {
+    return a.frame != b.frame ? a.frame > b.frame : a.order > b.order;
+  }
+
+  void pushCommand(typename Command::Type type, int scene) {
+    Command c{type, scene};
+    commands.write(&c, 1);
+  }
+
+  void schedule(int64_t frame, uint32_t slot, uint32_t generation, bool start) {
+    if (heap.size() == heap.capacity()) prune();
+    if (heap.size() == heap.capacity()) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    heap.push_back(Event{frame, nextOrder++, generation, slot, start});
+    std::push_heap(heap.begin(), heap.end(), later);
+    if (!start) {
+      Slot &s = slots[slot];
+      if (frame < s.stopAt) pruneNeeded = pruneNeeded || s.stopAt != kNever;
+      s.stopAt = std::min(s.stopAt, frame);
+    }
+  }
+
+  // a new generation voids a slot's pending events
+  void bump(Slot &s) {
+    ++s.generation;
+    s.stopAt = kNever;
+    pruneNeeded = true;
+  }
+
+  // drops events of old generations and stops behind an earlier one, then
+  // re-heapifies. O(pending), no allocation
+  void prune() {
+    pruneNeeded = false;
+    heap.erase(std::remove_if(heap.begin(), heap.end(),
+                              [&](const Event &e) {
+                                const Slot &s = slots[e.slot];
+                                return e.generation != s.generation ||
+                                       (!e.start && e.frame > s.stopAt);
+                              }),
+               heap.end());
+    std::make_heap(heap.begin(), heap.end(), later);
+  }
+
+  void apply(const Command &c) {
+    const std::size_t n = cueCount.load(std::memory_order_acquire);
+    if (c.type == Command::PLAY_SCENE) {
+      const int64_t overlap =
+          static_cast<int64_t>(overlapSeconds * framesPerSecond);
+      for (std::size_t i = 0; i < n; ++i) {
+        Slot &s = slots[i];
+        if (s.scene == c.scene) {
+          // fresh generation: pending events from an earlier play are void
+          bump(s);
+          const uint32_t g = s.generation;
+          const int64_t at =
+              now + static_cast<int64_t>(cues[i].start * framesPerSecond);
+          schedule(at, static_cast<uint32_t>(i), g, true);
+          schedule(at + static_cast<int64_t>(cues[i].duration * framesPerSecond),
+                   static_cast<uint32_t>(i), g, false);
+        } else if (s.playing && s.stopAt > now + overlap) {
+          // replaces the cue's own later stop
+          schedule(now + overlap, static_cast<uint32_t>(i), s.generation, false);
+        }
+      }
+    } else {
+      for (std::size_t i = 0; i < n; ++i) {
+        Slot &s = slots[i];
+        if (c.scene != kAllScenes && s.scene != c.scene) continue;
+        bump(s); // cancels whatever is still queued for it
+        if (s.playing) pool[i].triggerOff();
+      }
+    }
+  }
+
+  void fire(const Event &e, int offset) {
+    Slot &s = slots[e.slot];
+    if (e.generation != s.generation) return;
+    Voice &v = pool[e.slot];
+    if (e.start) {
+      v.triggerOn();
+      s.playing = true;
+      s.offset = offset;
+    } else if (s.playing) {
+      v.triggerOff();
+    }
+  }
+
+  std::unique_ptr<Voice[]> pool;
+  Voice spare;
+  std::vector<Slot> slots;
+  std::vector<Cue> cues;
+  std::size_t poolSize;
+  std::atomic<std::size_t> cueCount{0};
+
+  std::vector<Event> heap, deferred;
+  bool pruneNeeded = false;
+  uint32_t nextOrder = 0;
+  int64_t now = 0; // frames rendered, audio thread only
+  double framesPerSecond = 48000.0;
+  double overlapSeconds = 0.05;
+
+  SpscRing<Command> commands;
+  std::atomic<uint64_t> dropped{0};
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+// small float simd wrapper shared by the mesh fx and audio kernels.
+// the instruction set is picked at compile time (avx2 > sse2 > neon > scalar),
+// so the same kernel source builds everywhere and just gets wider lanes.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#else
+#define SIMD_SCALAR 1
+#endif
+
+namespace simd {
+
+#if defined(SIMD_AVX2)
+
+struct floatv {
+  static constexpr int width = 8;
+  __m256 v;
+  floatv() = default;
+  floatv(__m256 x) : v(x) {}
+  floatv(float x) : v(_mm256_set1_ps(x)) {}
+  static floatv load(const float *p) { return _mm256_load_ps(p); }
+  static floatv loadu(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_store_ps(p, v); }
+  void storeu(float *p) const { _mm256_storeu_ps(p, v); }
+};
+inline floatv operator+(floatv a, floatv b) { return _mm256_add_ps(a.v, b.v); }
+inline floatv operator-(floatv a, floatv b) { return _mm256_sub_ps(a.v, b.v); }
+inline floatv operator*(floatv a, floatv b) { return _mm256_mul_ps(a.v, b.v); }
+inline floatv operator/(floatv a, floatv b) { return _mm256_div_ps(a.v, b.v); }
+// a * b + c
+inline floatv fmadd(floatv a, floatv b, floatv c) {
+  return _mm256_fmadd_ps(a.v, b.v, c.v);
+}
+inline floatv min(floatv a, floatv b) { return _mm256_min_ps(a.v, b.v); }
+inline floatv max(floatv a, floatv b) { return _mm256_max_ps(a.v, b.v); }
+inline floatv sqrt(floatv a) { return _mm256_sqrt_ps(a.v); }
+inline floatv round(floatv a) {
+  return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+inline floatv abs(floatv a) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v);
+}
+// magnitude of a with the sign of b
+inline floatv copysign(floatv a, floatv b) {
+  const __m256 s = _mm256_set1_ps(-0.0f);
+  return _mm256_or_ps(_mm256_andnot_ps(s, a.v), _mm256_and_ps(s, b.v));
+}
+// mask ? a : b, mask from a comparison below
+inline floatv select(floatv mask, floatv a, floatv b) {
+  return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+inline floatv greater(floatv a, floatv b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ);
+}
+inline float hsum(floatv a) {
+  __m128 lo = _mm256_castps256_ps128(a.v);
+  __m128 hi = _mm256_extractf128_ps(a.v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  return _mm_cvtss_f32(lo);
+}
+inline float hmax(floatv a) {
+  __m128 lo = _mm256_castps256_ps128(a.v);
+  __m128 hi = _mm256_extractf128_ps(a.v, 1);
+  lo = _mm_max_ps(lo, hi);
+  lo = _mm_max_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_max_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  return _mm_cvtss_f32(lo);
+}
+inline const char *isaName() { return "avx2"; }
+
+#elif defined(SIMD_SSE2)
+
+struct floatv {
+  static constexpr int width = 4;
+  __m128 v;
+  floatv() = default;
+  floatv(__m128 x) : v(x) {}
+  floatv(float x) : v(_mm_set1_ps(x)) {}
+  static floatv load(const float *p) { return _mm_load_ps(p); }
+  static floatv loadu(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_store_ps(p, v); }
+  void storeu(float *p) const { _mm_storeu_ps(p, v); }
+};
+inline floatv operator+(floatv a, floatv b) { return _mm_add_ps(a.v, b.v); }
+inline floatv operator-(floatv a, floatv b) { return _mm_sub_ps(a.v, b.v); }
+inline floatv operator*(floatv a, floatv b) { return _mm_mul_ps(a.v, b.v); }
+inline floatv operator/(floatv a, floatv b) { return _mm_div_ps(a.v, b.v); }
+inline floatv fmadd(floatv a, floatv b, floatv c) {
+  return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+}
+inline floatv min(floatv a, floatv b) { return _mm_min_ps(a.v, b.v); }
+inline floatv max(floatv a, floatv b) { return _mm_max_ps(a.v, b.v); }
+inline floatv sqrt(floatv a) { return _mm_sqrt_ps(a.v); }
+// cvtps rounds to nearest with the default mxcsr, fine for |x| < 2^31
+inline floatv round(floatv a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+inline floatv abs(floatv a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline floatv copysign(floatv a, floatv b) {
+  const __m128 s = _mm_set1_ps(-0.0f);
+  return _mm_or_ps(_mm_andnot_ps(s, a.v), _mm_and_ps(s, b.v));
+}
+inline floatv select(floatv mask, floatv a, floatv b) {
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline floatv greater(floatv a, floatv b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline float hsum(floatv a) {
+  __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+inline float hmax(floatv a) {
+  __m128 s = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+  s = _mm_max_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+inline const char *isaName() { return "sse2"; }
+
+#elif defined(SIMD_NEON)
+
+struct floatv {
+  static constexpr int width = 4;
+  float32x4_t v;
+  floatv() = default;
+  floatv(float32x4_t x) : v(x) {}
+  floatv(float x) : v(vdupq_n_f32(x)) {}
+  static floatv load(const float *p) { return vld1q_f32(p); }
+  static floatv loadu(const float *p) { return vld1q_f32(p); }
+  void store(float *p) const { vst1q_f32(p, v); }
+  void storeu(float *p) const { vst1q_f32(p, v); }
+};
+inline floatv operator+(floatv a, floatv b) { return vaddq_f32(a.v, b.v); }
+inline floatv operator-(floatv a, floatv b) { return vsubq_f32(a.v, b.v); }
+inline floatv operator*(floatv a, floatv b) { return vmulq_f32(a.v, b.v); }
+inline floatv operator/(floatv a, floatv b) { return vdivq_f32(a.v, b.v); }
+inline floatv fmadd(floatv a, floatv b, floatv c) {
+  return vfmaq_f32(c.v, a.v, b.v);
+}
+inline floatv min(floatv a, floatv b) { return vminq_f32(a.v, b.v); }
+inline floatv max(floatv a, floatv b) { return vmaxq_f32(a.v, b.v); }
+inline floatv sqrt(floatv a) { return vsqrtq_f32(a.v); }
+inline floatv round(floatv a) { return vrndnq_f32(a.v); }
+inline floatv abs(floatv a) { return vabsq_f32(a.v); }
+inline floatv copysign(floatv a, floatv b) {
+  const uint32x4_t s = vdupq_n_u32(0x80000000u);
+  return vbslq_f32(s, b.v, a.v);
+}
+inline floatv select(floatv mask, floatv a, floatv b) {
+  return vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v);
+}
+inline floatv greater(floatv a, floatv b) {
+  return vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v));
+}
+inline float hsum(floatv a) { return vaddvq_f32(a.v); }
+inline float hmax(floatv a) { return vmaxvq_f32(a.v); }
+inline const char *isaName() { return "neon"; }
+
+#else
+
+struct floatv {
+  static constexpr int width = 1;
+  float v;
+  floatv() = default;
+  floatv(float x) : v(x) {}
+  static floatv load(const float *p) { return *p; }
+  static floatv loadu(const float *p) { return *p; }
+  void store(float *p) const { *p = v; }
+  void storeu(float *p) const { *p = v; }
+};
+inline floatv operator+(floatv a, floatv b) { return a.v + b.v; }
+inline floatv operator-(floatv a, floatv b) { return a.v - b.v; }
+inline floatv operator*(floatv a, floatv b) { return a.v * b.v; }
+inline floatv operator/(floatv a, floatv b) { return a.v / b.v; }
+inline floatv fmadd(floatv a, floatv b, floatv c) { return a.v * b.v + c.v; }
+inline floatv min(floatv a, floatv b) { return a.v < b.v ? a.v : b.v; }
+inline floatv max(floatv a, floatv b) { return a.v > b.v ? a.v : b.v; }
+inline floatv sqrt(floatv a) { return std::sqrt(a.v); }
+inline floatv round(floatv a) { return std::nearbyint(a.v); }
+inline floatv abs(floatv a) { return std::fabs(a.v); }
+inline floatv copysign(floatv a, floatv b) { return std::copysign(a.v, b.v); }
+// scalar masks are 0 / 1 instead of bit patterns
+inline floatv select(floatv mask, floatv a, floatv b) {
+  return mask.v != 0.0f ? a : b;
+}
+inline floatv greater(floatv a, floatv b) { return a.v > b.v ? 1.0f : 0.0f; }
+inline float hsum(floatv a) { return a.v; }
+inline float hmax(floatv a) { return a.v; }
+inline const char *isaName() { return "scalar"; }
+
+#endif
+
+constexpr int width = floatv::width;
+
+inline floatv operator-(floatv a) { return floatv(0.0f) - a; }
+inline floatv &operator+=(floatv &a, floatv b) { return a = a + b; }
+inline floatv &operator-=(floatv &a, floatv b) { return a = a - b; }
+inline floatv &operator*=(floatv &a, floatv b) { return a = a * b; }
+inline floatv clamp(floatv x, floatv lo, floatv hi) {
+  return min(max(x, lo), hi);
+}
+
+// sin(2pi * t) for any t. folds to a quarter period and uses a 9th order odd
+// polynomial, max error ~4e-6 which is plenty for vertex motion and gains
+inline floatv sin2pi(floatv t) {
+  floatv y = t - round(t); // [-0.5, 0.5]
+  floatv a = abs(y);
+  a = min(a, floatv(0.5f) - a); // sin(2pi a) == sin(2pi (0.5 - a))
+  floatv z = copysign(a, y) * floatv(6.28318530718f); // [-pi/2, pi/2]
+  floatv z2 = z * z;
+  floatv p = fmadd(z2, floatv(2.75573192e-6f), floatv(-1.98412698e-4f));
+  p = fmadd(z2, p, floatv(8.33333333e-3f));
+  p = fmadd(z2, p, floatv(-1.66666667e-1f));
+  p = fmadd(z2, p, floatv(1.0f));
+  return z * p;
+}
+
+inline floatv sin(floatv x) { return sin2pi(x * floatv(0.159154943092f)); }
+inline floatv cos(floatv x) {
+  return sin2pi(fmadd(x, floatv(0.159154943092f), floatv(0.25f)));
+}
+
+// arrays handed to the kernels are padded to a multiple of this many floats
+// so the loops never need a scalar tail
+constexpr std::size_t kPad = 16;
+constexpr std::size_t padded(std::size_t n) {
+  return (n + kPad - 1) / kPad * kPad;
+}
+
+// 64 byte aligned float buffer. sized once outside the hot path, never
+// reallocates unless resize() is asked for a bigger size
+struct alignedBuffer {
+  float *data = nullptr;
+  std::size_t size = 0;
+
+  alignedBuffer() = default;
+  explicit alignedBuffer(std::size_t n) { resize(n); }
+  alignedBuffer(const alignedBuffer &) = delete;
+  alignedBuffer &operator=(const alignedBuffer &) = delete;
+  alignedBuffer(alignedBuffer &&o) noexcept : data(o.data), size(o.size) {
+    o.data = nullptr;
+    o.size = 0;
+  }
+  alignedBuffer &operator=(alignedBuffer &&o) noexcept {
+    std::swap(data, o.data);
+    std::swap(size, o.size);
+    return *this;
+  }
+  ~alignedBuffer() { release(); }
+
+  void resize(std::size_t n) {
+    n = padded(n);
+    if (n <= size) return;
+    release();
+    data = static_cast<float *>(
+        ::operator new[](n * sizeof(float), std::align_val_t(64)));
+    size = n;
+    zero();
+  }
+  void zero() {
+    for (std::size_t i = 0; i < size; ++i) data[i] = 0.0f;
+  }
+  void release() {
+    if (data) ::operator delete[](data, std::align_val_t(64));
+    data = nullptr;
+    size = 0;
+  }
+  float &operator[](std::size_t i) { return data[i]; }
+  const float &operator[](std::size_t i) const { return data[i]; }
+};
+
+} // namespace simd
@@ -0,0 +1,238 @@
+#pragma once
+
+// hashed uniform grid for neighbor queries on agent swarms, plus the
+// separation / alignment / cohesion forces built on top of it.
+//
+// cells are `cellSize` wide and hashed into a table, so the world can be
+// unbounded (scene 2 releases blobs out to 800 units). the grid is stored
+// sorted by cell (counting sort, CSR), which keeps each cell's agents
+// contiguous for the 27-cell neighbor walk. update() reuses every buffer and
+// skips the re-sort entirely when no agent changed cell since last frame.
+// binning and the sorted copies run on the shared WorkerPool, only the
+// counting sort itself is serial.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "parallelFor.hpp"
+#include "simdUtility.hpp"
+
+class SpatialGrid {
+public:
+  static constexpr std::size_t kGrain = 4096;
+
+  void setCellSize(float s) {
+    float c = s > 1e-4f ? s : 1e-4f;
+    if (c != cellSize) {
+      cellSize = c;
+      cellKey.clear(); // force a full rebuild
+    }
+  }
+  float getCellSize() const { return cellSize; }
+
+  // bin n points. returns true when the grid was re-sorted
+  bool update(const float *x, const float *y, const float *z, std::size_t n) {
+    px = x;
+    py = y;
+    pz = z;
+    const float inv = 1.0f / cellSize;
+    bool changed = cellKey.size() != n;
+    if (changed) {
+      cellKey.assign(n, 0);
+      cellX.assign(n, 0);
+      cellY.assign(n, 0);
+      cellZ.assign(n, 0);
+      std::size_t tableSize = 64;
+      while (tableSize < n * 2) tableSize <<= 1;
+      cellStart.assign(tableSize + 1, 0);
+      sorted.assign(n, 0);
+    }
+    std::atomic<bool> moved{false};
+    parallelFor(n, kGrain, [&](std::size_t begin, std::size_t end) {
+      bool any = false;
+      for (std::size_t i = begin; i < end; ++i) {
+        cellX[i] = cell(x[i], inv);
+        cellY[i] = cell(y[i], inv);
+        cellZ[i] = cell(z[i], inv);
+        uint32_t k = hash(cellX[i], cellY[i], cellZ[i]);
+        if (k != cellKey[i]) {
+          cellKey[i] = k;
+          any = true;
+        }
+      }
+      if (any) moved.store(true, std::memory_order_relaxed);
+    });
+    changed = changed || moved.load(std::memory_order_relaxed);
+    if (!changed) {
+      refreshSorted(n);
+      return false;
+    }
+
+    // counting sort by hashed cell
+    const std::size_t tableSize = cellStart.size() - 1;
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (std::size_t i = 0; i < n; ++i) ++cellStart[cellKey[i] + 1];
+    for (std::size_t c = 0; c < tableSize; ++c)
+      cellStart[c + 1] += cellStart[c];
+    fill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (std::size_t i = 0; i < n; ++i)
+      sorted[fill[cellKey[i]]++] = static_cast<uint32_t>(i);
+    refreshSorted(n);
+    return true;
+  }
+
+  // calls fn(j, dx, dy, dz, d2) for every other point within radius of point
+  // i, with d = p[j] - p[i]. radius must be <= cellSize / 2, so the query
+  // sphere only reaches the 2x2x2 block of cells on its side of each cell
+  // midline (8 probes instead of 27)
+  template <class F> void forEachNeighbor(std::size_t i, float radius, F &&fn) const {
+    const float r2 = radius * radius;
+    const int cx = cellX[i], cy = cellY[i], cz = cellZ[i];
+    const float x = px[i], y = py[i], z = pz[i];
+    const float inv = 1.0f / cellSize;
+    const int sx = x * inv - cx < 0.5f ? -1 : 1;
+    const int sy = y * inv - cy < 0.5f ? -1 : 1;
+    const int sz = z * inv - cz < 0.5f ? -1 : 1;
+    for (int dz = 0; dz < 2; ++dz)
+      for (int dy = 0; dy < 2; ++dy)
+        for (int dx = 0; dx < 2; ++dx) {
+          const int nx = cx + dx * sx, ny = cy + dy * sy, nz = cz + dz * sz;
+          const uint32_t k = hash(nx, ny, nz);
+          for (uint32_t s = cellStart[k]; s < cellStart[k + 1]; ++s) {
+            const Entry &e = entries[s];
+            // hashed cells can collide: only take entries from the cell we
+            // meant so nobody is visited twice
+            if (e.cx != nx || e.cy != ny || e.cz != nz) continue;
+            const uint32_t j = e.index;
+            if (j == i) continue;
+            float ox = e.x - x, oy = e.y - y, oz = e.z - z;
+            float d2 = ox * ox + oy * oy + oz * oz;
+            if (d2 < r2) fn(j, ox, oy, oz, d2);
+          }
+        }
+  }
+
+private:
+  // everything a probe reads about one agent, in one 32 byte record: the
+  // probes land on random cells, so each should cost one cache line
+  struct Entry {
+    float x, y, z;
+    int cx, cy, cz;
+    uint32_t index, pad;
+  };
+
+  // positions and cells copied into cell order, so the neighbor walk reads
+  // contiguous memory. positions move every frame even when cells don't
+  void refreshSorted(std::size_t n) {
+    entries.resize(n);
+    parallelFor(n, kGrain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t s = begin; s < end; ++s) {
+        const uint32_t i = sorted[s];
+        entries[s] = Entry{px[i], py[i], pz[i], cellX[i], cellY[i], cellZ[i],
+                           i, 0};
+      }
+    });
+  }
+
+  static int cell(float v, float inv) {
+    return static_cast<int>(std::floor(v * inv));
+  }
+  uint32_t hash(int x, int y, int z) const {
+    uint32_t h = static_cast<uint32_t>(x) * 73856093u ^
+                 static_cast<uint32_t>(y) * 19349663u ^
+                 static_cast<uint32_t>(z) * 83492791u;
+    return h & static_cast<uint32_t>(cellStart.size() - 2);
+  }
+
+  float cellSize = 1.0f;
+  const float *px = nullptr, *py = nullptr, *pz = nullptr;
+  std::vector<uint32_t> cellKey, cellStart, fill, sorted;
+  std::vector<int> cellX, cellY, cellZ;
+  std::vector<Entry> entries;
+};
+
+struct FlockParams {
+  float separationRadius = 2.0f;
+  float neighborRadius = 4.0f; // alignment + cohesion
+  float separation = 1.0f;
+  float alignment = 0.0f;
+  float cohesion = 0.0f;
+};
+
+// per-agent steering forces from the grid neighbors. velocities feed
+// alignment and may be null when alignment is 0. the force arrays are padded
+// with zeros so AgentSwarm can read them in whole simd blocks
+class FlockForces {
+public:
+  static constexpr std::size_t kGrain = 1024;
+
+  void compute(const float *x, const float *y, const float *z,
+               const float *vx, const float *vy, const float *vz,
+               std::size_t n, const FlockParams &p) {
+    forceX.resize(simd::padded(n));
+    forceY.resize(simd::padded(n));
+    forceZ.resize(simd::padded(n));
+    const float radius = std::fmax(p.separationRadius, p.neighborRadius);
+    grid.setCellSize(2.0f * radius);
+    grid.update(x, y, z, n);
+    const float sep2 = p.separationRadius * p.separationRadius;
+    const bool useVel = vx && vy && vz && p.alignment != 0.0f;
+
+    parallelFor(n, kGrain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        float sx = 0, sy = 0, sz = 0; // separation
+        float ax = 0, ay = 0, az = 0; // alignment
+        float cx = 0, cy = 0, cz = 0; // cohesion
+        int neighbors = 0;
+        grid.forEachNeighbor(i, radius, [&](uint32_t j, float dx, float dy,
+                                            float dz, float d2) {
+          if (d2 < sep2 && d2 > 1e-12f) {
+            // push away, stronger when closer
+            float w = 1.0f / d2;
+            sx -= dx * w;
+            sy -= dy * w;
+            sz -= dz * w;
+          }
+          if (useVel) {
+            ax += vx[j];
+            ay += vy[j];
+            az += vz[j];
+          }
+          cx += dx;
+          cy += dy;
+          cz += dz;
+          ++neighbors;
+        });
+        float fx = sx * p.separation, fy = sy * p.separation,
+              fz = sz * p.separation;
+        if (neighbors) {
+          float inv = 1.0f / neighbors;
+          if (useVel) {
+            fx += (ax * inv - vx[i]) * p.alignment;
+            fy += (ay * inv - vy[i]) * p.alignment;
+            fz += (az * inv - vz[i]) * p.alignment;
+          }
+          fx += cx * inv * p.cohesion;
+          fy += cy * inv * p.cohesion;
+          fz += cz * inv * p.cohesion;
+        }
+        forceX[i] = fx;
+        forceY[i] = fy;
+        forceZ[i] = fz;
+      }
+    });
+  }
+
+  const float *x() const { return forceX.data(); }
+  const float *y() const { return forceY.data(); }
+  const float *z() const { return forceZ.data(); }
+  const SpatialGrid &getGrid() const { return grid; }
+
+private:
+  SpatialGrid grid;
+  std::vector<float> forceX, forceY, forceZ;
+};
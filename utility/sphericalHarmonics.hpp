@@ -0,0 +1,69 @@
+#pragma once
+
+// real spherical harmonics for ambisonics, ACN channel order, N3D
+// normalization, no Condon-Shortley phase (the AmbiX convention, minus SN3D).
+// directions are allolib vectors: +y up, -z forward, +x right. they don't
+// need to be unit length.
+
+#include <cmath>
+
+namespace sh {
+
+constexpr int channelsForOrder(int order) { return (order + 1) * (order + 1); }
+constexpr int kMaxOrder = 7;
+
+// writes channelsForOrder(order) coefficients into out
+inline void evaluate(int order, float x, float y, float z, float *out) {
+  const double len = std::sqrt(double(x) * x + double(y) * y + double(z) * z);
+  if (len < 1e-12) {
+    // no direction: omni only
+    out[0] = 1.0f;
+    for (int i = 1; i < channelsForOrder(order); ++i) out[i] = 0.0f;
+    return;
+  }
+  const double ct = y / len;                 // cos(elevation from the pole)
+  const double st = std::sqrt(std::fmax(0.0, 1.0 - ct * ct));
+  const double phi = std::atan2(-double(x), -double(z)); // 0 ahead, + left
+
+  // associated legendre P_l^m(ct), no CS phase, built per column m
+  double p[kMaxOrder + 1][kMaxOrder + 1];
+  double pmm = 1.0;
+  for (int m = 0; m <= order; ++m) {
+    if (m > 0) pmm *= (2 * m - 1) * st;
+    p[m][m] = pmm;
+    if (m < order) p[m + 1][m] = ct * (2 * m + 1) * pmm;
+    for (int l = m + 2; l <= order; ++l)
+      p[l][m] = ((2 * l - 1) * ct * p[l - 1][m] - (l + m - 1) * p[l - 2][m]) /
+                (l - m);
+  }
+
+  for (int l = 0; l <= order; ++l) {
+    for (int m = -l; m <= l; ++m) {
+      const int am = m < 0 ? -m : m;
+      // sqrt((2l+1) (2 - d_m0) (l-|m|)! / (l+|m|)!)
+      double ratio = 1.0;
+      for (int k = l - am + 1; k <= l + am; ++k) ratio /= k;
+      const double norm = std::sqrt((2 * l + 1) * (am == 0 ? 1.0 : 2.0) * ratio);
+      const double trig = m > 0 ? std::cos(m * phi)
+                          : m < 0 ? std::sin(am * phi)
+                                  : 1.0;
+      out[l * l + l + m] = static_cast<float>(norm * p[l][am] * trig);
+    }
+  }
+}
+
+// max-rE weight for each order l <= order, narrows the decoded lobe
+inline void maxReWeights(int order, float *w) {
+  const double x = std::cos(2.4068 / (order + 1.51)); // 137.9 deg / (N+1.51)
+  double p0 = 1.0, p1 = x;
+  w[0] = 1.0f;
+  if (order >= 1) w[1] = static_cast<float>(x);
+  for (int l = 2; l <= order; ++l) {
+    const double pl = ((2 * l - 1) * x * p1 - (l - 1) * p0) / l;
+    w[l] = static_cast<float>(pl);
+    p0 = p1;
+    p1 = pl;
+  }
+}
+
+} // namespace sh
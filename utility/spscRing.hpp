@@ -0,0 +1,118 @@
+#pragma once
+
+// single producer / single consumer lock-free ring. one side writes, the
+// other reads, neither ever blocks or allocates after construction, so it is
+// safe to use from the audio callback on either end.
+//
+// read and write positions are monotonic 64 bit counters (they never wrap in
+// practice), which lets callers talk about absolute stream positions, e.g.
+// the producer can publish "everything before position P is stale" and the
+// consumer can skipTo(P).
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template <class T> class SpscRing {
+public:
+  SpscRing() = default;
+  explicit SpscRing(std::size_t minCapacity) { reset(minCapacity); }
+
+  // not thread safe, call before either side starts
+  void reset(std::size_t minCapacity) {
+    std::size_t cap = 1;
+    while (cap < minCapacity) cap <<= 1;
+    buffer.assign(cap, T());
+    mask = cap - 1;
+    writePos.store(0, std::memory_order_relaxed);
+    readPos.store(0, std::memory_order_relaxed);
+  }
+
+  std::size_t capacity() const { return buffer.size(); }
+
+  // producer side
+  std::size_t writeAvailable() const {
+    return capacity() - static_cast<std::size_t>(
+                            writePos.load(std::memory_order_relaxed) -
+                            readPos.load(std::memory_order_acquire));
+  }
+  // copies up to n items, returns how many fit
+  std::size_t write(const T *src, std::size_t n) {
+    const uint64_t w = writePos.load(std::memory_order_relaxed);
+    n = std::min(n, writeAvailable());
+    const std::size_t start = static_cast<std::size_t>(w) & mask;
+    const std::size_t first = std::min(n, capacity() - start);
+    std::copy(src, src + first, buffer.data() + start);
+    std::copy(src + first, src + n, buffer.data());
+    writePos.store(w + n, std::memory_order_release);
+    return n;
+  }
+  // zero copy producer access: up to two contiguous spans, then commit()
+  std::size_t writeRegions(T *&a, std::size_t &na, T *&b, std::size_t &nb) {
+    const uint64_t w = writePos.load(std::memory_order_relaxed);
+    const std::size_t n = writeAvailable();
+    const std::size_t start = static_cast<std::size_t>(w) & mask;
+    a = buffer.data() + start;
+    na = std::min(n, capacity() - start);
+    b = buffer.data();
+    nb = n - na;
+    return n;
+  }
+  void commit(std::size_t n) {
+    writePos.store(writePos.load(std::memory_order_relaxed) + n,
+                   std::memory_order_release);
+  }
+  uint64_t writePosition() const {
+    return writePos.load(std::memory_order_relaxed);
+  }
+
+  // consumer side
+  std::size_t readAvailable() const {
+    return static_cast<std::size_t>(writePos.load(std::memory_order_acquire) -
+                                    readPos.load(std::memory_order_relaxed));
+  }
+  std::size_t read(T *dst, std::size_t n) {
+    const uint64_t r = readPos.load(std::memory_order_relaxed);
+    n = std::min(n, readAvailable());
+    const std::size_t start = static_cast<std::size_t>(r) & mask;
+    const std::size_t first = std::min(n, capacity() - start);
+    std::copy(buffer.data() + start, buffer.data() + start + first, dst);
+    std::copy(buffer.data(), buffer.data() + (n - first), dst + first);
+    readPos.store(r + n, std::memory_order_release);
+    return n;
+  }
+  // zero copy consumer access, then consume()
+  std::size_t readRegions(const T *&a, std::size_t &na, const T *&b,
+                          std::size_t &nb) const {
+    const uint64_t r = readPos.load(std::memory_order_relaxed);
+    const std::size_t n = readAvailable();
+    const std::size_t start = static_cast<std::size_t>(r) & mask;
+    a = buffer.data() + start;
+    na = std::min(n, capacity() - start);
+    b = buffer.data();
+    nb = n - na;
+    return n;
+  }
+  void consume(std::size_t n) {
+    readPos.store(readPos.load(std::memory_order_relaxed) + n,
+                  std::memory_order_release);
+  }
+  // drop everything before absolute position p (no-op if already past it)
+  void skipTo(uint64_t p) {
+    const uint64_t r = readPos.load(std::memory_order_relaxed);
+    const uint64_t w = writePos.load(std::memory_order_acquire);
+    if (p > r) readPos.store(std::min(p, w), std::memory_order_release);
+  }
+  uint64_t readPosition() const {
+    return readPos.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<T> buffer;
+  std::size_t mask = 0;
+  // separate cache lines so the two threads don't false share
+  alignas(64) std::atomic<uint64_t> writePos{0};
+  alignas(64) std::atomic<uint64_t> readPos{0};
+};
@@ -0,0 +1,420 @@
+#pragma once
+
+// offline sample rate conversion with an on-disk cache, so a file is only
+// resampled in real time until its conversion exists (AdmStreamer plays the
+// original through its varispeed meanwhile; resolve() callers wait instead).
+// files whose rate differs from the device get converted once (high quality
+// windowed sinc, multithreaded) and written to
+// <cacheDir>/<content hash>_<rate>.wav; later runs just find the file.
+//
+//   SrcCache cache("srcCache");
+//   cache.request(songPath, deviceRate);        // queued for the background
+//   ...
+//   songPath = cache.resolve(songPath, deviceRate); // waits for that one file
+//   p = cache.ready(songPath, deviceRate);     // or "" while it's running
+//
+// jobs go through one queue served by kMaxConversions threads (each job can
+// hold a few hundred MB of pass buffers), so 54 stems requested together
+// costs a couple of passes of memory and threads, not 54.
+//
+// cancel(), and the destructor, stop the running conversions at their next
+// pass and drop the queued ones; their resolve() gets the original path and
+// the half-written files are removed, so quitting on a cold cache is quick.
+//
+// the key is a hash of the file contents, so renamed or copied assets share
+// an entry and an edited asset gets a new one. hashing a big stem is not free,
+// so hashes are remembered in <cacheDir>/index.txt against path, size and
+// mtime and only recomputed when those change.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallelFor.hpp"
+#include "simdUtility.hpp"
+#include "wavFile.hpp"
+
+class SrcCache {
+public:
+  explicit SrcCache(std::string directory = "srcCache")
+      : dir(std::move(directory)) {}
+  ~SrcCache() {
+    cancel();
+    for (auto &t : threads) t.join();
+  }
+
+  SrcCache(const SrcCache &) = delete;
+  SrcCache &operator=(const SrcCache &) = delete;
+
+  // conversion threads. each conversion already spreads across workerPool()
+  static constexpr int kMaxConversions = 2;
+
+  // queue path for conversion to targetRate (no-op when it was requested
+  // before; a file already at targetRate finishes as soon as it's probed)
+  void request(const std::string &path, int targetRate) {
+    if (path.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    const Key k{path, targetRate};
+    if (jobs.count(k)) return;
+    Job job{k, std::promise<std::string>()};
+    jobs[k] = job.result.get_future().share();
+    if (cancelled.load()) {
+      job.result.set_value(path);
+      return;
+    }
+    queue.push_back(std::move(job));
+    if (threads.size() < static_cast<std::size_t>(kMaxConversions))
+      threads.emplace_back([this] { serve(); });
+    else
+      queued.notify_one();
+  }
+
+  // stops running conversions at their next pass and drops queued ones,
+  // which all finish with their original path. request() after this only
+  // hands back originals
+  void cancel() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      cancelled.store(true);
+      for (Job &j : queue) j.result.set_value(j.key.first);
+      queue.clear();
+    }
+    queued.notify_all();
+  }
+
+  // path to load for playback at targetRate: the cached conversion, or the
+  // original when no conversion is needed or it failed. blocks until this
+  // file is ready, so call it at load time, not from the audio thread
+  std::string resolve(const std::string &path, int targetRate) {
+    if (path.empty()) return path;
+    request(path, targetRate);
+    std::shared_future<std::string> f;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      f = jobs[Key{path, targetRate}];
+    }
+    return f.get();
+  }
+
+  // non-blocking: the path to play if the job for (path, targetRate) has
+  // finished, "" if it is still queued or running or was never requested
+  std::string ready(const std::string &path, int targetRate) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(Key{path, targetRate});
+    if (it == jobs.end() || it->second.wait_for(std::chrono::seconds(0)) !=
+                                std::future_status::ready)
+      return {};
+    return it->second.get();
+  }
+
+  bool busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &j : jobs)
+      if (j.second.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready)
+        return true;
+    return false;
+  }
+
+  void wait() {
+    std::vector<std::shared_future<std::string>> all;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &j : jobs) all.push_back(j.second);
+    }
+    for (auto &f : all) f.wait();
+  }
+
+  // converts src into a float32 wav at targetRate. usable on its own.
+  // false, with dst partly written, if `stop` goes true between passes
+  static bool convert(const std::string &src, const std::string &dst,
+                      int targetRate, WorkerPool &workers,
+                      const std::atomic<bool> *stop = nullptr) {
+    WavReader in;
+    if (!in.open(src) || in.sampleRate <= 0 || targetRate <= 0) return false;
+    WavWriter out;
+    if (!out.open(dst, in.channels, targetRate)) return false;
+    Kernel k(in.sampleRate, targetRate);
+
+    const int ch = in.channels;
+    const uint64_t outFrames =
+        (in.frames * k.up + k.down - 1) / k.down; // ceil(frames * L / M)
+    // memory bound: ~64 MB of output per pass no matter the channel count,
+    // plus the input span in planar and interleaved form. per job: the
+    // cache runs at most kMaxConversions of these at once
+    const std::size_t passFrames = std::max<std::size_t>(
+        4096, (64u << 20) / (sizeof(float) * static_cast<std::size_t>(ch)));
+    std::vector<std::vector<float>> planar(ch);
+    std::vector<float> interleaved, readBuf;
+
+    for (uint64_t o0 = 0; o0 < outFrames; o0 += passFrames) {
+      if (stop && stop->load(std::memory_order_relaxed)) return false;
+      const std::size_t n =
+          static_cast<std::size_t>(std::min<uint64_t>(passFrames, outFrames - o0));
+      // input span this pass touches, with the kernel's reach on both sides
+      const int64_t first = static_cast<int64_t>(o0 * k.down / k.up) - k.half;
+      const int64_t last =
+          static_cast<int64_t>((o0 + n - 1) * k.down / k.up) + k.half + 1;
+      const std::size_t span = static_cast<std::size_t>(last - first + 1);
+      for (auto &p : planar) p.assign(span + simd::kPad, 0.0f);
+      readBuf.resize(span * ch);
+      const int64_t readFrom = std::max<int64_t>(first, 0);
+      in.seek(static_cast<uint64_t>(readFrom));
+      const std::size_t got =
+          in.read(readBuf.data(), static_cast<std::size_t>(last + 1 - readFrom));
+      const std::size_t offset = static_cast<std::size_t>(readFrom - first);
+      for (std::size_t f = 0; f < got; ++f)
+        for (int c = 0; c < ch; ++c)
+          planar[c][offset + f] = readBuf[f * ch + c];
+
+      interleaved.assign(n * ch, 0.0f);
+      const std::size_t sub = 4096;
+      const std::size_t subs = (n + sub - 1) / sub;
+      workers.parallelFor(subs * ch, 1, [&](std::size_t b, std::size_t e) {
+        for (std::size_t job = b; job < e; ++job) {
+          const int c = static_cast<int>(job % ch);
+          const std::size_t s0 = (job / ch) * sub;
+          const std::size_t s1 = std::min(n, s0 + sub);
+          const float *x = planar[c].data();
+          for (std::size_t j = s0; j < s1; ++j) {
+            const uint64_t num = (o0 + j) * k.down;
+            const int64_t i = static_cast<int64_t>(num / k.up);
+            const uint64_t rem = num % k.up;
+            interleaved[j * ch + c] =
+                k.apply(x + (i - k.half + 1 - first), rem);
+          }
+        }
+      });
+      if (!out.write(interleaved.data(), n)) return false;
+    }
+    return out.close();
+  }
+
+  // 64 bit FNV-1a of the whole file. 0 if it can't be read or `stop` goes
+  // true part way
+  static uint64_t hashFile(const std::string &path,
+                           const std::atomic<bool> *stop = nullptr) {
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return 0;
+    uint64_t h = 1469598103934665603ull;
+    std::vector<unsigned char> buf(1 << 20);
+    std::size_t got;
+    while ((got = std::fread(buf.data(), 1, buf.size(), f)) > 0) {
+      if (stop && stop->load(std::memory_order_relaxed)) {
+        std::fclose(f);
+        return 0;
+      }
+      for (std::size_t i = 0; i < got; ++i) {
+        h ^= buf[i];
+        h *= 1099511628211ull;
+      }
+    }
+    std::fclose(f);
+    return h;
+  }
+
+private:
+  // rational polyphase windowed sinc. output j reads input position
+  // j * down / up, so the fractional part is exactly rem / up and every phase
+  // has its own precomputed row. very large `up` (odd rate pairs) falls back
+  // to kMaxPhases rows with linear interpolation
+  struct Kernel {
+    static constexpr int kZeroCrossings = 24;
+    static constexpr int kMaxPhases = 4096;
+
+    uint64_t up = 1, down = 1;
+    int half = 0, taps = 0, phases = 0;
+    std::vector<float, std::allocator<float>> table;
+
+    Kernel(int from, int to) {
+      const int g = std::gcd(from, to);
+      up = static_cast<uint64_t>(to / g);
+      down = static_cast<uint64_t>(from / g);
+      // cutoff in cycles per input sample, a little under the lower nyquist
+      const double fc = 0.5 * std::min(1.0, double(to) / from) * 0.95;
+      half = static_cast<int>(std::ceil(kZeroCrossings / (2.0 * fc)));
+      taps = static_cast<int>(simd::padded(2 * half));
+      phases = static_cast<int>(std::min<uint64_t>(up, kMaxPhases));
+      table.assign(static_cast<std::size_t>(phases + 1) * taps, 0.0f);
+      const double pi = 3.14159265358979323846;
+      const double beta = 9.5;
+      const double i0b = besselI0(beta);
+      for (int p = 0; p <= phases; ++p) {
+        const double frac = double(p) / phases;
+        float *row = &table[static_cast<std::size_t>(p) * taps];
+        double sum = 0.0;
+        for (int t = 0; t < 2 * half; ++t) {
+          const double x = (t - half + 1) - frac;
+          const double sinc =
+              x == 0.0 ? 2.0 * fc : std::sin(2.0 * pi * fc * x) / (pi * x);
+          const double r = x / half;
+          const double w =
+              r * r < 1.0 ? besselI0(beta * std::sqrt(1.0 - r * r)) / i0b : 0.0;
+          row[t] = static_cast<float>(sinc * w);
+          sum += row[t];
+        }
+        for (int t = 0; t < 2 * half; ++t)
+          row[t] = static_cast<float>(row[t] / sum);
+      }
+    }
+
+    // x points at input sample i - half + 1, rem is the phase numerator
+    float apply(const float *x, uint64_t rem) const {
+      if (static_cast<uint64_t>(phases) == up)
+        return dot(x, &table[static_cast<std::size_t>(rem) * taps]);
+      const double ph = double(rem) * phases / double(up);
+      const int p = static_cast<int>(ph);
+      const float f = static_cast<float>(ph - p);
+      const float a = dot(x, &table[static_cast<std::size_t>(p) * taps]);
+      const float b = dot(x, &table[static_cast<std::size_t>(p + 1) * taps]);
+      return a + f * (b - a);
+    }
+
+    float dot(const float *x, const float *c) const {
+      simd::floatv acc(0.0f);
+      for (int t = 0; t < taps; t += simd::width)
+        acc = simd::fmadd(simd::floatv::loadu(x + t), simd::floatv::loadu(c + t),
+                          acc);
+      return simd::hsum(acc);
+    }
+
+    static double besselI0(double x) {
+      double sum = 1.0, term = 1.0;
+      for (int k = 1; k < 40; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+      }
+      return sum;
+    }
+  };
+
+  using Key = std::pair<std::string, int>;
+  struct Job {
+    Key key;
+    std::promise<std::string> result;
+  };
+
+  // a conversion thread: takes jobs in request order until cancelled
+  void serve() {
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        queued.wait(lock, [&] { return cancelled.load() || !queue.empty(); });
+        if (queue.empty()) return; // cancelled, queue already answered
+        job = std::move(queue.front());
+        queue.pop_front();
+      }
+      job.result.set_value(lookupOrConvert(job.key.first, job.key.second));
+    }
+  }
+
+  std::string lookupOrConvert(const std::string &path, int targetRate) {
+    WavReader probe;
+    if (!probe.open(path)) {
+      std::cout << "SrcCache: couldnt open " << path << std::endl;
+      return path;
+    }
+    if (probe.sampleRate == targetRate) return path;
+    const int fromRate = probe.sampleRate;
+    probe.close();
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    const uint64_t hash = contentHash(path);
+    if (cancelled.load()) return path;
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%d.wav",
+                  static_cast<unsigned long long>(hash), targetRate);
+    const std::string cached = (std::filesystem::path(dir) / name).string();
+    if (std::filesystem::exists(cached, ec)) return cached;
+
+    std::cout << "SrcCache: converting " << path << " " << fromRate << " -> "
+              << targetRate << " Hz" << std::endl;
+    // write under a temp name and rename, so a crash never leaves a
+    // truncated file that looks like a finished one
+    const std::string tmp = cached + ".part";
+    if (!convert(path, tmp, targetRate, workerPool(), &cancelled)) {
+      std::filesystem::remove(tmp, ec);
+      std::cout << "SrcCache: conversion " << (cancelled.load() ? "cancelled" : "failed")
+                << ", using " << path << std::endl;
+      return path;
+    }
+    std::filesystem::rename(tmp, cached, ec);
+    return ec ? path : cached;
+  }
+
+  uint64_t contentHash(const std::string &path) {
+    std::error_code ec;
+    const std::string abs = std::filesystem::absolute(path, ec).string();
+    const auto size = std::filesystem::file_size(path, ec);
+    const auto mtime = static_cast<long long>(
+        std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    std::ostringstream stamp;
+    stamp << size << " " << mtime;
+    {
+      std::lock_guard<std::mutex> lock(indexMutex);
+      if (!indexLoaded) loadIndex();
+      auto it = hashIndex.find(abs);
+      if (it != hashIndex.end() && it->second.first == stamp.str())
+        return it->second.second;
+    }
+    // the read happens unlocked, other jobs keep finding their hashes
+    const uint64_t h = hashFile(path, &cancelled);
+    if (h == 0) return 0;
+    std::lock_guard<std::mutex> lock(indexMutex);
+    hashIndex[abs] = {stamp.str(), h};
+    std::ofstream idx(std::filesystem::path(dir) / "index.txt", std::ios::app);
+    idx << std::hex << h << std::dec << " " << stamp.str() << " " << abs
+        << "\n";
+    return h;
+  }
+
+  // lines of "hash size mtime path", later lines win
+  void loadIndex() {
+    indexLoaded = true;
+    std::ifstream idx(std::filesystem::path(dir) / "index.txt");
+    std::string line;
+    while (std::getline(idx, line)) {
+      std::istringstream in(line);
+      uint64_t h;
+      std::string size, mtime, p;
+      if (!(in >> std::hex >> h >> std::dec >> size >> mtime)) continue;
+      std::getline(in >> std::ws, p);
+      if (!p.empty()) hashIndex[p] = {size + " " + mtime, h};
+    }
+  }
+
+  // conversions get their own pool so a long job never holds up the shared
+  // pool the per-frame mesh work runs on
+  static WorkerPool &workerPool() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  std::string dir;
+  mutable std::mutex mutex;
+  std::map<Key, std::shared_future<std::string>> jobs;
+  std::deque<Job> queue;
+  std::condition_variable queued;
+  std::vector<std::thread> threads;
+  std::atomic<bool> cancelled{false};
+  std::mutex indexMutex;
+  bool indexLoaded = false;
+  std::map<std::string, std::pair<std::string, uint64_t>> hashIndex;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+// multichannel variable rate resampler (windowed sinc, polyphase table) for
+// playing the ADM stems at PLAYBACK_SPEED.
+//
+// input comes in as interleaved frames with the channel stride padded to
+// simd::kPad, so the inner loop vectorizes across channels: each output frame
+// is kTaps broadcast-coefficient fmas over the whole 55 channel frame. the tap
+// coefficients are interpolated between table phases once per frame and
+// shared by every channel, so the cost is ~kTaps * stride fmas per frame.
+//
+// for speeds above 1 the kernel cutoff is lowered (one table per speed band)
+// so fast playback doesn't alias. speed changes are smoothed per block and
+// ramped linearly inside it, so there are no zipper steps.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "simdUtility.hpp"
+
+class Varispeed {
+public:
+  static constexpr int kTaps = 32;
+  static constexpr int kHalf = kTaps / 2;
+  static constexpr int kPhases = 256;
+  static constexpr float kMinSpeed = 0.25f;
+  static constexpr float kMaxSpeed = 4.0f;
+  static constexpr int kMaxChannels = 128;
+
+  // not real-time safe. maxFrames is the largest block render() will be
+  // asked for
+  void prepare(int numChannels, int maxFrames, double sampleRate) {
+    channels = std::min(numChannels, kMaxChannels);
+    stride = static_cast<int>(simd::padded(channels));
+    blockMax = maxFrames;
+    rate = sampleRate;
+    const int maxIn = static_cast<int>(std::ceil(maxFrames * kMaxSpeed)) + 2;
+    capacityFrames = kTaps + maxIn + 1;
+    history.resize(static_cast<std::size_t>(capacityFrames) * stride);
+    frameOut.resize(stride);
+    buildTables();
+    reset();
+  }
+
+  // drop buffered audio, e.g. after a seek
+  void reset() {
+    history.zero();
+    buffered = kHalf - 1; // zero lead-in so the first frame has left taps
+    position = kHalf - 1;
+    speed = target;
+  }
+
+  void setSpeed(float s) { target = std::clamp(s, kMinSpeed, kMaxSpeed); }
+  float getSpeed() const { return speed; }
+  // time constant of the speed smoothing, seconds
+  void setSmoothing(float seconds) { smoothing = std::max(seconds, 0.0f); }
+
+  // source frames already pulled but not yet played, for position reporting
+  double pendingFrames() const { return buffered - position; }
+
+  // renders `frames` frames into non-interleaved outputs (zeroing channels
+  // past channels()). pull(float *dst, int stride, int n) must write up to n
+  // interleaved frames at dst with the given stride and return how many it
+  // wrote; the rest is treated as silence
+  template <class Pull>
+  void render(float *const *out, int outChannels, int frames, Pull &&pull) {
+    outChannels = std::min(outChannels, kMaxChannels);
+    float *chunk[kMaxChannels];
+    for (int done = 0; done < frames; done += blockMax) {
+      for (int ch = 0; ch < outChannels; ++ch) chunk[ch] = out[ch] + done;
+      renderBlock(chunk, outChannels, std::min(blockMax, frames - done), pull);
+    }
+  }
+
+  int numChannels() const { return channels; }
+
+private:
+  template <class Pull>
+  void renderBlock(float *const *out, int outChannels, int frames, Pull &pull) {
+    const float a =
+        smoothing > 0.0f
+            ? 1.0f - std::exp(-frames / static_cast<float>(smoothing * rate))
+            : 1.0f;
+    const float endSpeed = speed + (target - speed) * a;
+    const double inc = (endSpeed - speed) / frames;
+
+    // pull what this block will read, plus the right half of the kernel
+    const double advance = frames * 0.5 * (speed + endSpeed);
+    const int need = static_cast<int>(std::ceil(position + advance)) + kHalf + 1;
+    if (need > buffered) {
+      const int n = std::min(need, capacityFrames) - buffered;
+      float *dst = history.data + static_cast<std::size_t>(buffered) * stride;
+      const int got = std::max(0, pull(dst, stride, n));
+      if (got < n)
+        std::memset(dst + static_cast<std::size_t>(got) * stride, 0,
+                    sizeof(float) * (n - got) * stride);
+      buffered += n;
+    }
+
+    const float *table = tables.data() + bandFor(std::max(speed, endSpeed)) *
+                                             (kPhases + 1) * kTaps;
+    const int used = std::min(outChannels, channels);
+    const int vecs = stride / simd::width;
+    alignas(64) float coef[kTaps];
+    double s = speed;
+    for (int k = 0; k < frames; ++k) {
+      const int i = static_cast<int>(position);
+      const float ph = static_cast<float>(position - i) * kPhases;
+      const int p = static_cast<int>(ph);
+      const float f = ph - p;
+      const float *c0 = table + p * kTaps;
+      const float *c1 = c0 + kTaps;
+      for (int t = 0; t < kTaps; ++t) coef[t] = c0[t] + f * (c1[t] - c0[t]);
+
+      const float *src =
+          history.data + static_cast<std::size_t>(i - kHalf + 1) * stride;
+      // stride is a multiple of kPad, so vecs is always even. two
+      // accumulators per pass keeps the fma chains independent
+      for (int v = 0; v < vecs; v += 2) {
+        const int o0 = v * simd::width;
+        const int o1 = o0 + simd::width;
+        simd::floatv acc0(0.0f), acc1(0.0f);
+        const float *row = src;
+        for (int t = 0; t < kTaps; ++t, row += stride) {
+          const simd::floatv c(coef[t]);
+          acc0 = simd::fmadd(c, simd::floatv::load(row + o0), acc0);
+          acc1 = simd::fmadd(c, simd::floatv::load(row + o1), acc1);
+        }
+        acc0.store(frameOut.data + o0);
+        acc1.store(frameOut.data + o1);
+      }
+      for (int ch = 0; ch < used; ++ch) out[ch][k] = frameOut.data[ch];
+
+      s += inc;
+      position += s;
+    }
+    for (int ch = used; ch < outChannels; ++ch)
+      std::memset(out[ch], 0, sizeof(float) * frames);
+    speed = endSpeed;
+
+    // slide the history down so the next block's left taps sit at the front
+    const int drop = static_cast<int>(position) - (kHalf - 1);
+    if (drop > 0) {
+      const int keep = buffered - drop;
+      std::memmove(history.data,
+                   history.data + static_cast<std::size_t>(drop) * stride,
+                   sizeof(float) * keep * stride);
+      buffered = keep;
+      position -= drop;
+    }
+  }
+
+  // speed bands, each with its own anti-alias cutoff
+  static constexpr int kBands = 5;
+  static constexpr float kBandSpeed[kBands] = {1.0f, 1.5f, 2.0f, 3.0f, 4.0f};
+
+  static int bandFor(float s) {
+    for (int b = 0; b < kBands; ++b)
+      if (s <= kBandSpeed[b] * 1.0001f) return b;
+    return kBands - 1;
+  }
+
+  static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  // table[band][phase][tap], phase kPhases duplicates phase 0 shifted by one
+  // tap so the interpolation never reads past the end
+  void buildTables() {
+    tables.assign(static_cast<std::size_t>(kBands) * (kPhases + 1) * kTaps, 0.0f);
+    const double pi = 3.14159265358979323846;
+    const double beta = 8.0;
+    const double i0b = besselI0(beta);
+    for (int b = 0; b < kBands; ++b) {
+      const double fc = 0.46 / kBandSpeed[b]; // cycles per sample
+      for (int p = 0; p <= kPhases; ++p) {
+        const double frac = static_cast<double>(p) / kPhases;
+        float *row = tables.data() + (b * (kPhases + 1) + p) * kTaps;
+        double sum = 0.0;
+        for (int t = 0; t < kTaps; ++t) {
+          // tap t reads sample i - kHalf + 1 + t, output sits at i + frac
+          const double x = (t - kHalf + 1) - frac;
+          const double sinc =
+              x == 0.0 ? 2.0 * fc
+                       : std::sin(2.0 * pi * fc * x) / (pi * x);
+          const double r = x / kHalf;
+          const double w =
+              r * r < 1.0 ? besselI0(beta * std::sqrt(1.0 - r * r)) / i0b : 0.0;
+          row[t] = static_cast<float>(sinc * w);
+          sum += row[t];
+        }
+        // unity dc gain at every phase
+        for (int t = 0; t < kTaps; ++t)
+          row[t] = static_cast<float>(row[t] / sum);
+      }
+    }
+  }
+
+  int channels = 0;
+  int stride = simd::kPad;
+  int blockMax = 0;
+  int capacityFrames = 0;
+  double rate = 48000.0;
+  float smoothing = 0.05f;
+
+  float target = 1.0f;
+  float speed = 1.0f;
+  double position = 0.0; // read head in history frames
+  int buffered = 0;      // valid frames in history
+
+  simd::alignedBuffer history; // interleaved, stride floats per frame
+  simd::alignedBuffer frameOut;
+  std::vector<float> tables;
+};
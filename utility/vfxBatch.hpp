@@ -0,0 +1,256 @@
+#pragma once
+
+// batch backend for the vertex effects (ripple / scatter / pulse).
+// positions live as SoA float blocks instead of al::Vec3f arrays so the
+// kernels run on whole simd lanes, and a chain walks the block in L1 sized
+// tiles, running every effect on a tile before moving on. three chained
+// ripples are one pass over memory instead of three.
+//
+// usage mirrors VertexEffectChain:
+//   BatchEffectChain chain;  BatchRippleEffect ripple;
+//   ripple.setParams(4, 0.2, 4.0, 'y');
+//   chain.pushBack(&ripple);
+//   chain.process(mesh, sceneTime); // mesh is anything with vertices()
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "simdUtility.hpp"
+
+// SoA copy of a vertex array, padded for the simd loops
+struct VertexBlock {
+  simd::alignedBuffer x, y, z;
+  std::size_t count = 0;
+
+  void resize(std::size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    count = n;
+  }
+
+  template <class Vec3Vector> void gather(const Vec3Vector &verts) {
+    if (verts.size() != count) resize(verts.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      x[i] = verts[i].x;
+      y[i] = verts[i].y;
+      z[i] = verts[i].z;
+    }
+  }
+
+  template <class Vec3Vector> void scatter(Vec3Vector &verts) const {
+    std::size_t n = verts.size() < count ? verts.size() : count;
+    for (std::size_t i = 0; i < n; ++i) {
+      verts[i].x = x[i];
+      verts[i].y = y[i];
+      verts[i].z = z[i];
+    }
+  }
+
+  float *axis(char a) { return a == 'x' ? x.data : (a == 'y' ? y.data : z.data); }
+  const float *axis(char a) const {
+    return a == 'x' ? x.data : (a == 'y' ? y.data : z.data);
+  }
+};
+
+class BatchVertexEffect {
+public:
+  virtual ~BatchVertexEffect() = default;
+  // once per frame before any tiles run
+  virtual void prepare(float /*t*/) {}
+  // deform [begin, end) of pos in place. base is the undeformed mesh.
+  // begin / end are always multiples of simd::width
+  virtual void processTile(VertexBlock &pos, const VertexBlock &base,
+                           std::size_t begin, std::size_t end, float t) = 0;
+  bool enabled = true;
+};
+
+// pos[axis] += amplitude * sin(2pi * (frequency * (other two base coords) +
+// speed * t))
+class BatchRippleEffect : public BatchVertexEffect {
+public:
+  float amplitude = 0.0f;
+  float frequency = 1.0f;
+  float speed = 1.0f;
+  char axis = 'y';
+
+  void setParams(float amp, float freq, float spd, char ax) {
+    amplitude = amp;
+    frequency = freq;
+    speed = spd;
+    axis = ax;
+  }
+
+  void processTile(VertexBlock &pos, const VertexBlock &base, std::size_t begin,
+                   std::size_t end, float t) override {
+    using simd::floatv;
+    const char a0 = axis == 'x' ? 'y' : 'x';
+    const char a1 = axis == 'z' ? 'y' : 'z';
+    const float *u = base.axis(a0);
+    const float *v = base.axis(a1);
+    float *out = pos.axis(axis);
+    const floatv amp(amplitude), freq(frequency), phase(speed * t);
+    for (std::size_t i = begin; i < end; i += simd::width) {
+      floatv arg = simd::fmadd(floatv::load(u + i) + floatv::load(v + i), freq,
+                               phase);
+      floatv o = simd::fmadd(amp, simd::sin2pi(arg), floatv::load(out + i));
+      o.store(out + i);
+    }
+  }
+};
+
+// pushes each vertex out along a fixed random direction. triggerOut / triggerIn
+// ramp the spread up or down at `speed` per second. only worth it inside a
+// chain that is already batched: on its own it's memory bound and the SoA
+// copies cost what the simd saves (about 1x in vfxBatchBench)
+class BatchScatterEffect : public BatchVertexEffect {
+public:
+  float speed = 1.0f;
+  float spread = 1.0f;
+
+  void setParams(float spd, float spr) {
+    speed = spd;
+    spread = spr;
+  }
+
+  // one random unit direction per vertex of the mesh
+  template <class MeshT> void setScatterVector(const MeshT &mesh,
+                                               unsigned seed = 1) {
+    std::size_t n = mesh.vertices().size();
+    dir.resize(n);
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> nd(0.0f, 1.0f);
+    for (std::size_t i = 0; i < n; ++i) {
+      float a = nd(rng), b = nd(rng), c = nd(rng);
+      float m = std::sqrt(a * a + b * b + c * c);
+      if (m < 1e-6f) m = 1.0f;
+      dir.x[i] = a / m;
+      dir.y[i] = b / m;
+      dir.z[i] = c / m;
+    }
+  }
+
+  void triggerOut(bool on) { direction = on ? 1 : direction; }
+  void triggerIn(bool on) { direction = on ? -1 : direction; }
+  float progress() const { return amount; }
+
+  void prepare(float t) override {
+    float dt = hasTime ? t - lastTime : 0.0f;
+    if (dt < 0.0f || dt > 0.5f) dt = 0.0f; // scene jumps, not motion
+    lastTime = t;
+    hasTime = true;
+    amount += direction * speed * dt;
+    if (amount > 1.0f) amount = 1.0f;
+    if (amount < 0.0f) amount = 0.0f;
+  }
+
+  void processTile(VertexBlock &pos, const VertexBlock & /*base*/,
+                   std::size_t begin, std::size_t end, float /*t*/) override {
+    using simd::floatv;
+    if (dir.x.size < end) return; // setScatterVector not called for this mesh
+    const floatv k(amount * spread);
+    for (std::size_t i = begin; i < end; i += simd::width) {
+      simd::fmadd(floatv::load(dir.x.data + i), k, floatv::load(pos.x.data + i))
+          .store(pos.x.data + i);
+      simd::fmadd(floatv::load(dir.y.data + i), k, floatv::load(pos.y.data + i))
+          .store(pos.y.data + i);
+      simd::fmadd(floatv::load(dir.z.data + i), k, floatv::load(pos.z.data + i))
+          .store(pos.z.data + i);
+    }
+  }
+
+private:
+  VertexBlock dir;
+  float amount = 0.0f;
+  int direction = 0;
+  float lastTime = 0.0f;
+  bool hasTime = false;
+};
+
+// breathing scale around the origin. mode 0 pulses the whole mesh at once,
+// mode 1 sends the pulse down the mesh along y (jelly bell)
+class BatchAutoPulseEffect : public BatchVertexEffect {
+public:
+  float speed = 1.0f;
+  float amount = 0.1f;
+  int mode = 0;
+
+  void setParams(float spd, float amt, int md) {
+    speed = spd;
+    amount = amt;
+    mode = md;
+  }
+
+  void processTile(VertexBlock &pos, const VertexBlock &base, std::size_t begin,
+                   std::size_t end, float t) override {
+    using simd::floatv;
+    const floatv amt(amount), phase(speed * t);
+    const floatv travel(mode == 1 ? 0.25f : 0.0f);
+    for (std::size_t i = begin; i < end; i += simd::width) {
+      floatv by = floatv::load(base.y.data + i);
+      floatv k = amt * simd::sin2pi(simd::fmadd(by, travel, phase));
+      simd::fmadd(floatv::load(base.x.data + i), k, floatv::load(pos.x.data + i))
+          .store(pos.x.data + i);
+      simd::fmadd(by, k, floatv::load(pos.y.data + i)).store(pos.y.data + i);
+      simd::fmadd(floatv::load(base.z.data + i), k, floatv::load(pos.z.data + i))
+          .store(pos.z.data + i);
+    }
+  }
+};
+
+class BatchEffectChain {
+public:
+  // vertices per tile. 3 axes x 2 blocks x 512 floats = 12k, sits in L1
+  static constexpr std::size_t kTile = 512;
+
+  void pushBack(BatchVertexEffect *effect) { effects.push_back(effect); }
+  void clear() { effects.clear(); }
+  std::size_t size() const { return effects.size(); }
+
+  // snapshot the undeformed mesh. process() does this on first use or when
+  // the vertex count changes
+  template <class Vec3Vector> void setBaseMesh(const Vec3Vector &verts) {
+    base.gather(verts);
+    pos.resize(base.count);
+    hasBase = true;
+  }
+
+  // runs every effect over the SoA block, tile by tile, starting from base
+  void processBlock(float t) {
+    for (auto *e : effects)
+      if (e->enabled) e->prepare(t);
+    const std::size_t n = simd::padded(base.count);
+    for (std::size_t begin = 0; begin < n; begin += kTile) {
+      const std::size_t end = begin + kTile < n ? begin + kTile : n;
+      copyTile(begin, end);
+      for (auto *e : effects)
+        if (e->enabled) e->processTile(pos, base, begin, end, t);
+    }
+  }
+
+  template <class MeshT> void process(MeshT &mesh, double t) {
+    auto &verts = mesh.vertices();
+    if (!hasBase || verts.size() != base.count) setBaseMesh(verts);
+    processBlock(static_cast<float>(t));
+    pos.scatter(verts);
+  }
+
+  // deformed positions from the last processBlock(), for callers that want to
+  // skip the AoS scatter (state arrays, GPU upload)
+  const VertexBlock &positions() const { return pos; }
+  const VertexBlock &basePositions() const { return base; }
+
+private:
+  void copyTile(std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i += simd::width) {
+      simd::floatv::load(base.x.data + i).store(pos.x.data + i);
+      simd::floatv::load(base.y.data + i).store(pos.y.data + i);
+      simd::floatv::load(base.z.data + i).store(pos.z.data + i);
+    }
+  }
+
+  std::vector<BatchVertexEffect *> effects;
+  VertexBlock base, pos;
+  bool hasBase = false;
+};
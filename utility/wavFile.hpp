@@ -0,0 +1,277 @@
+#pragma once
+
+// minimal streaming wav reader: pcm 16 / 24 / 32 bit int and 32 / 64 bit
+// float, plain or WAVE_FORMAT_EXTENSIBLE. reads straight from a FILE* in
+// chunks, so it never holds more than the caller's block in memory (unlike
+// al::SoundFile, which loads the whole file).
+// WavWriter is the matching float32 writer for offline jobs.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+class WavReader {
+public:
+  WavReader() = default;
+  WavReader(const WavReader &) = delete;
+  WavReader &operator=(const WavReader &) = delete;
+  WavReader(WavReader &&o) noexcept { *this = std::move(o); }
+  WavReader &operator=(WavReader &&o) noexcept {
+    if (this != &o) {
+      close();
+      file = o.file;
+      o.file = nullptr;
+      path = std::move(o.path);
+      channels = o.channels;
+      sampleRate = o.sampleRate;
+      bitsPerSample = o.bitsPerSample;
+      isFloat = o.isFloat;
+      dataOffset = o.dataOffset;
+      frames = o.frames;
+      position = o.position;
+      raw = std::move(o.raw);
+    }
+    return *this;
+  }
+  ~WavReader() { close(); }
+
+  bool open(const std::string &filePath) {
+    close();
+    path = filePath;
+    file = std::fopen(filePath.c_str(), "rb");
+    if (!file) return false;
+    if (!parseHeader()) {
+      close();
+      return false;
+    }
+#if defined(__linux__)
+    // we only ever read forward in big blocks, let the kernel read ahead
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return seek(0);
+  }
+
+  void close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+  }
+
+  bool isOpen() const { return file != nullptr; }
+
+  bool seek(uint64_t frame) {
+    if (!file) return false;
+    if (frame > frames) frame = frames;
+    position = frame;
+    const uint64_t byte = dataOffset + frame * frameBytes();
+#if defined(_WIN32)
+    return _fseeki64(file, static_cast<long long>(byte), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(byte), SEEK_SET) == 0;
+#endif
+  }
+
+  // reads up to n frames as interleaved floats, returns frames read
+  std::size_t read(float *dst, std::size_t n) {
+    if (!file || position >= frames) return 0;
+    if (n > frames - position) n = static_cast<std::size_t>(frames - position);
+    const std::size_t bytes = n * frameBytes();
+    raw.resize(bytes);
+    std::size_t got = std::fread(raw.data(), 1, bytes, file) / frameBytes();
+    convert(raw.data(), dst, got * channels);
+    position += got;
+    return got;
+  }
+
+  std::string path;
+  int channels = 0;
+  int sampleRate = 0;
+  int bitsPerSample = 0;
+  bool isFloat = false;
+  uint64_t frames = 0;
+  uint64_t position = 0;
+
+private:
+  std::size_t frameBytes() const {
+    return static_cast<std::size_t>(channels) * (bitsPerSample / 8);
+  }
+
+  // 64 bit tell, multichannel stems go past 2 GB
+  int64_t tell() const {
+#if defined(_WIN32)
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+  }
+
+  static uint32_t le32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+  }
+  static uint16_t le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+  bool parseHeader() {
+    unsigned char h[12];
+    if (std::fread(h, 1, 12, file) != 12) return false;
+    if (std::memcmp(h, "RIFF", 4) || std::memcmp(h + 8, "WAVE", 4))
+      return false;
+    bool haveFmt = false;
+    unsigned char c[8];
+    while (std::fread(c, 1, 8, file) == 8) {
+      uint32_t size = le32(c + 4);
+      if (!std::memcmp(c, "fmt ", 4)) {
+        std::vector<unsigned char> fmt(size);
+        if (std::fread(fmt.data(), 1, size, file) != size || size < 16)
+          return false;
+        uint16_t tag = le16(fmt.data());
+        channels = le16(fmt.data() + 2);
+        sampleRate = static_cast<int>(le32(fmt.data() + 4));
+        bitsPerSample = le16(fmt.data() + 14);
+        if (tag == 0xFFFE && size >= 26) tag = le16(fmt.data() + 24);
+        isFloat = tag == 3;
+        // anything convert() can't decode, 8 bit pcm included
+        const bool pcm = tag == 1 && (bitsPerSample == 16 ||
+                                      bitsPerSample == 24 || bitsPerSample == 32);
+        const bool ieee = tag == 3 && (bitsPerSample == 32 || bitsPerSample == 64);
+        if (!pcm && !ieee) return false;
+        haveFmt = true;
+      } else if (!std::memcmp(c, "data", 4)) {
+        if (!haveFmt || channels <= 0) return false;
+        int64_t here = tell();
+        if (here < 0) return false;
+        dataOffset = static_cast<uint64_t>(here);
+        frames = size / frameBytes();
+        // some writers leave 0 / 0xFFFFFFFF for streamed files
+        if (size == 0 || size == 0xFFFFFFFFu) {
+          std::fseek(file, 0, SEEK_END);
+          frames = (static_cast<uint64_t>(tell()) - dataOffset) / frameBytes();
+        }
+        return true;
+      } else {
+        std::fseek(file, size + (size & 1), SEEK_CUR);
+      }
+    }
+    return false;
+  }
+
+  void convert(const unsigned char *src, float *dst, std::size_t n) const {
+    switch (bitsPerSample) {
+    case 16:
+      for (std::size_t i = 0; i < n; ++i)
+        dst[i] = int16_t(le16(src + i * 2)) * (1.0f / 32768.0f);
+      break;
+    case 24:
+      for (std::size_t i = 0; i < n; ++i) {
+        const unsigned char *p = src + i * 3;
+        int32_t v = (p[0] << 8) | (p[1] << 16) | (uint32_t(p[2]) << 24);
+        dst[i] = (v >> 8) * (1.0f / 8388608.0f);
+      }
+      break;
+    case 32:
+      if (isFloat)
+        std::memcpy(dst, src, n * 4); // little endian hosts only
+      else
+        for (std::size_t i = 0; i < n; ++i)
+          dst[i] = int32_t(le32(src + i * 4)) * (1.0f / 2147483648.0f);
+      break;
+    case 64:
+      for (std::size_t i = 0; i < n; ++i) {
+        double d;
+        std::memcpy(&d, src + i * 8, 8);
+        dst[i] = static_cast<float>(d);
+      }
+      break;
+    default:
+      std::memset(dst, 0, n * sizeof(float));
+    }
+  }
+
+  std::FILE *file = nullptr;
+  uint64_t dataOffset = 0;
+  std::vector<unsigned char> raw;
+};
+
+// streaming 32 bit float wav writer. sizes are patched on close(); files
+// past 4 GB get 0xFFFFFFFF sizes, which WavReader (and most readers) treat
+// as "until end of file"
+class WavWriter {
+public:
+  WavWriter() = default;
+  WavWriter(const WavWriter &) = delete;
+  WavWriter &operator=(const WavWriter &) = delete;
+  ~WavWriter() { close(); }
+
+  bool open(const std::string &filePath, int numChannels, int rate) {
+    close();
+    file = std::fopen(filePath.c_str(), "wb");
+    if (!file) return false;
+    channels = numChannels;
+    sampleRate = rate;
+    frames = 0;
+    return writeHeader(0);
+  }
+
+  bool write(const float *interleaved, std::size_t n) {
+    if (!file) return false;
+    const std::size_t count = n * channels;
+    if (std::fwrite(interleaved, sizeof(float), count, file) != count)
+      return false; // little endian hosts only, like the reader
+    frames += n;
+    return true;
+  }
+
+  bool close() {
+    if (!file) return true;
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 &&
+              writeHeader(frames * channels * sizeof(float));
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+  }
+
+  uint64_t framesWritten() const { return frames; }
+
+private:
+  static void put32(unsigned char *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+  }
+  static void put16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+  }
+
+  bool writeHeader(uint64_t dataBytes) {
+    const uint32_t data = dataBytes + 36 > 0xFFFFFFFFull
+                              ? 0xFFFFFFFFu
+                              : static_cast<uint32_t>(dataBytes);
+    const uint32_t riff = data == 0xFFFFFFFFu ? data : data + 36;
+    unsigned char h[44];
+    std::memcpy(h, "RIFF", 4);
+    put32(h + 4, riff);
+    std::memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, 3); // ieee float
+    put16(h + 22, static_cast<uint16_t>(channels));
+    put32(h + 24, static_cast<uint32_t>(sampleRate));
+    put32(h + 28, static_cast<uint32_t>(sampleRate * channels * 4));
+    put16(h + 32, static_cast<uint16_t>(channels * 4));
+    put16(h + 34, 32);
+    std::memcpy(h + 36, "data", 4);
+    put32(h + 40, data);
+    return std::fwrite(h, 1, 44, file) == 44;
+  }
+
+  std::FILE *file = nullptr;
+  int channels = 0;
+  int sampleRate = 0;
+  uint64_t frames = 0;
+};